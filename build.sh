@@ -6,6 +6,6 @@ DEBUG="-DDEBUG=1"
 
 pushd build
 
-clang -Weverything $WIGNORE -g -O0 --std=c++14 $DEBUG ../src/main.cpp -isystem ../libs/glad/include -isystem ../libs -L/usr/local/lib -L../libs/glad -L../libs -ldl -lm -lGL -lglfw -lglad -lstdc++ -o main -Wl,-rpath,\$ORIGIN/../build
+clang -Weverything $WIGNORE -g -O0 --std=c++14 $DEBUG ../src/main.cpp -isystem ../libs/glad/include -isystem ../libs -L/usr/local/lib -L../libs/glad -L../libs -ldl -lm -lGL -lglfw -lglad -lpthread -lstdc++ -o main -Wl,-rpath,\$ORIGIN/../build
 
 popd
\ No newline at end of file
@@ -0,0 +1,464 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+// Hulls of many small point sets at once, built for throughput rather than the
+// latency of a single hull. The items are spread over the threads with
+// parallelForStealing, so a thread that drew cheap items keeps taking work from
+// the others instead of idling. Every thread keeps one context per algorithm and
+// reuses it for all of its items and across calls, so once the buffers have
+// grown to the item sizes of the workload a batch hardly allocates.
+
+// An item of the batch, the points [first, first + count) of the batch input
+struct BatchRange
+{
+    int first;
+    int count;
+};
+
+template <typename S>
+struct BatchHull
+{
+    // algorithm that built the hull
+    HullType hullType;
+    // fewer than 4 points, or both algorithms tried gave up
+    bool failed;
+    // indices into the item's points, not the whole batch input
+    HullResult<S> result;
+};
+
+struct BatchOptions
+{
+    // <= 0 means one thread per hardware thread
+    int threadCount;
+    // items a thread takes at once
+    int grain;
+    // algorithm by item size: incremental below incrementalBelow points,
+    // else divide and conquer below dacBelow points, else QuickHull
+    int incrementalBelow;
+    int dacBelow;
+    // insertion order of the incremental hull
+    unsigned long long seed;
+    // what goes into the results besides the indices, see HullResultFlags
+    int resultFlags;
+};
+
+static BatchOptions batchDefaultOptions()
+{
+    BatchOptions options = {};
+    options.threadCount = 0;
+    options.grain = 4;
+    // the size thresholds of the Auto hull type, batch items aren't sampled
+    auto thresholds = defaultAutoSelectConfig();
+    options.incrementalBelow = thresholds.incrementalBelow;
+    options.dacBelow = thresholds.dacBelow;
+    options.seed = 0;
+    options.resultFlags = 0;
+    return options;
+}
+
+template <typename S>
+struct BatchWorker
+{
+    QhContext<S> qhContext;
+    IncContext<S> incContext;
+    DacContext<S> dacContext;
+
+    // items hulled by each algorithm, summed over all calls
+    int hullsByType[3];
+};
+
+// Keep this around between batches, the contexts in it are what makes
+// later batches cheap. batchFreeContext gives the memory back.
+template <typename S>
+struct BatchContext
+{
+    std::vector<BatchWorker<S>> workers;
+
+    // batchParallelHull: the chunks and their hulls, the union of the chunk
+    // hulls' vertices with the input index of each, and the hull of the union
+    List<BatchRange> chunkRanges;
+    List<BatchHull<S>> chunkHulls;
+    List<Vertex> mergePoints;
+    List<int> mergeInputIndices;
+    HullResult<S> mergeResult;
+};
+
+static HullType batchSelectHullType(const BatchOptions &options, int count)
+{
+    if (count < options.incrementalBelow)
+    {
+        return Inc;
+    }
+    if (count < options.dacBelow)
+    {
+        return Dac;
+    }
+    return QH;
+}
+
+// Builds the hull of one item with the given algorithm. Returns false if it failed.
+template <typename S>
+static bool batchRunHull(BatchWorker<S> &worker, HullType hullType, Vertex *points, int count, const BatchOptions &options, HullResult<S> &result)
+{
+    switch (hullType)
+    {
+        case QH:
+        {
+            auto &qhContext = worker.qhContext;
+            qhInitializeContext(qhContext, points, count);
+            qhFullHull(qhContext);
+            qhContext.initialized = false;
+            if (qhContext.qHull.failed)
+            {
+                return false;
+            }
+            qhExtractResult(qhContext, result, options.resultFlags);
+        }
+        break;
+        case Inc:
+        {
+            auto &incContext = worker.incContext;
+            incInitializeContext(incContext, points, count, options.seed);
+            incConstructFullHull(incContext);
+            incContext.initialized = false;
+            if (incContext.failed)
+            {
+                return false;
+            }
+            incExtractResult(incContext, result, options.resultFlags);
+        }
+        break;
+        case Dac:
+        {
+            auto &dacContext = worker.dacContext;
+            dacInitializeContext(dacContext, points, count);
+            if (!dacHasDistinctX(dacContext))
+            {
+                dacContext.initialized = false;
+                return false;
+            }
+            dacConstructFullHull(dacContext);
+            dacContext.initialized = false;
+            dacExtractResult(dacContext, result, options.resultFlags);
+        }
+        break;
+        default:
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+template <typename S>
+static void batchHullItem(BatchWorker<S> &worker, const BatchOptions &options, Vertex *points, BatchRange range, BatchHull<S> &hull)
+{
+    hull.failed = false;
+    if (range.count < 4)
+    {
+        hullResultBegin(hull.result, options.resultFlags, 0, 0);
+        hull.failed = true;
+        return;
+    }
+
+    hull.hullType = batchSelectHullType(options, range.count);
+    if (!batchRunHull(worker, hull.hullType, points + range.first, range.count, options, hull.result))
+    {
+        // the algorithms give up in different places, QuickHull takes over
+        // from the others and the incremental hull from QuickHull
+        hull.hullType = hull.hullType == QH ? Inc : QH;
+        if (!batchRunHull(worker, hull.hullType, points + range.first, range.count, options, hull.result))
+        {
+            hullResultBegin(hull.result, options.resultFlags, 0, 0);
+            hull.failed = true;
+            return;
+        }
+    }
+    worker.hullsByType[hull.hullType]++;
+}
+
+// Hulls every range of points. hulls gets one entry per range, in the same
+// order. Entries already in hulls are overwritten and keep their result buffers.
+template <typename S>
+static void batchHulls(BatchContext<S> &context, const BatchOptions &options, Vertex *points, const BatchRange *ranges, int rangeCount, List<BatchHull<S>> &hulls)
+{
+    auto threadCount = options.threadCount > 0 ? options.threadCount : hardwareThreadCount();
+    if (context.workers.size() < (size_t)threadCount)
+    {
+        context.workers.resize((size_t)threadCount, BatchWorker<S>{});
+    }
+
+    reserve(hulls, (size_t)rangeCount);
+    for (size_t i = hulls.size; i < (size_t)rangeCount; i++)
+    {
+        hulls.data()[i] = {};
+    }
+    for (size_t i = (size_t)rangeCount; i < hulls.size; i++)
+    {
+        hullResultFree(hulls[i].result);
+    }
+    hulls.size = (size_t)rangeCount;
+
+    parallelForStealing(rangeCount, threadCount, options.grain, [&](int thread, int begin, int end)
+    {
+        auto &worker = context.workers[thread];
+        for (int i = begin; i < end; i++)
+        {
+            batchHullItem(worker, options, points, ranges[i], hulls[i]);
+        }
+    });
+}
+
+// One large hull over all threads. The input is cut into chunkCount ranges
+// (<= 0 for one per thread) that batchHulls hulls in parallel, then the
+// vertices of the chunk hulls are hulled again. Every hull vertex is a vertex
+// of the hull of its chunk, so the second hull is the hull of all points. With
+// few points on the hull, like points in a ball or a cube, the second stage is
+// tiny and the time is the time of a chunk. The algorithms are picked from the
+// options by size, for the chunks and for the union alike. Returns false if
+// the final hull failed.
+template <typename S>
+static bool batchParallelHull(BatchContext<S> &context, const BatchOptions &options, Vertex *points, int count, int chunkCount, HullResult<S> &result)
+{
+    auto threadCount = options.threadCount > 0 ? options.threadCount : hardwareThreadCount();
+    chunkCount = chunkCount > 0 ? chunkCount : threadCount;
+    chunkCount = Max(1, Min(chunkCount, count / 4));
+
+    // the input order is taken as random, ranges of it are random chunks
+    context.chunkRanges.size = 0;
+    reserve(context.chunkRanges, (size_t)chunkCount);
+    for (int chunk = 0; chunk < chunkCount; chunk++)
+    {
+        BatchRange range = {};
+        range.first = (int)((long long)count * chunk / chunkCount);
+        range.count = (int)((long long)count * (chunk + 1) / chunkCount) - range.first;
+        addToList(context.chunkRanges, range);
+    }
+
+    auto chunkOptions = options;
+    chunkOptions.threadCount = threadCount;
+    chunkOptions.grain = 1;
+    chunkOptions.resultFlags = HullResult_Compact;
+    batchHulls(context, chunkOptions, points, context.chunkRanges.data(), chunkCount, context.chunkHulls);
+
+    context.mergePoints.size = 0;
+    context.mergeInputIndices.size = 0;
+    for (int chunk = 0; chunk < chunkCount; chunk++)
+    {
+        auto &range = context.chunkRanges[chunk];
+        auto &chunkHull = context.chunkHulls[chunk];
+        if (chunkHull.failed)
+        {
+            // flat or tiny chunks go into the union whole
+            for (int i = 0; i < range.count; i++)
+            {
+                addToList(context.mergePoints, points[range.first + i]);
+                addToList(context.mergeInputIndices, range.first + i);
+            }
+            continue;
+        }
+        for (auto inputIndex : chunkHull.result.inputIndices)
+        {
+            addToList(context.mergePoints, points[range.first + inputIndex]);
+            addToList(context.mergeInputIndices, range.first + inputIndex);
+        }
+    }
+
+    auto mergeCount = (int)context.mergePoints.size;
+    auto &worker = context.workers[0];
+    auto mergeOptions = options;
+    mergeOptions.resultFlags = HullResult_Compact;
+    auto hullType = batchSelectHullType(mergeOptions, mergeCount);
+    if (mergeCount < 4 ||
+        (!batchRunHull(worker, hullType, context.mergePoints.data(), mergeCount, mergeOptions, context.mergeResult) &&
+         !batchRunHull(worker, hullType == QH ? Inc : QH, context.mergePoints.data(), mergeCount, mergeOptions, context.mergeResult)))
+    {
+        hullResultBegin(result, options.resultFlags, 0, 0);
+        return false;
+    }
+
+    // back to indices into the whole input
+    auto &merged = context.mergeResult;
+    hullResultBegin(result, options.resultFlags, count, hullResultFaceCount(merged));
+    for (size_t face = 0; face < hullResultFaceCount(merged); face++)
+    {
+        int inputIndex[3];
+        const position_t<S> *position[3];
+        for (int i = 0; i < 3; i++)
+        {
+            auto vertex = merged.indices[face * 3 + i];
+            inputIndex[i] = context.mergeInputIndices[merged.inputIndices[vertex]];
+            position[i] = &merged.vertices[vertex];
+        }
+        hullResultAddFace(result, inputIndex, position);
+    }
+    return true;
+}
+
+template <typename S>
+static void batchFreeHulls(List<BatchHull<S>> &hulls)
+{
+    for (auto &hull : hulls)
+    {
+        hullResultFree(hull.result);
+    }
+    clear(hulls);
+}
+
+template <typename S>
+static void batchFreeContext(BatchContext<S> &context)
+{
+    for (auto &worker : context.workers)
+    {
+        qhFreeContext(worker.qhContext);
+        incFreeContext(worker.incContext);
+        dacFreeContext(worker.dacContext);
+    }
+    std::vector<BatchWorker<S>>().swap(context.workers);
+    clear(context.chunkRanges);
+    batchFreeHulls(context.chunkHulls);
+    clear(context.mergePoints);
+    clear(context.mergeInputIndices);
+    hullResultFree(context.mergeResult);
+}
+
+// Hulls a batch shaped like one frame of many small clouds, a few hundred to a
+// few thousand points each, and logs the throughput with one thread and with
+// every hardware thread.
+template <typename S>
+static void RunBatchBenchmark(glm::vec3 offset, unsigned long long seed, const char *scalarName)
+{
+    const int itemCount = 2000;
+    const int minPoints = 200;
+    const int maxPoints = 3000;
+    const int repetitions = 3;
+    
+    std::mt19937_64 gen{seed};
+    List<BatchRange> ranges = {};
+    init(ranges, itemCount);
+    auto totalPoints = 0;
+    for (int i = 0; i < itemCount; i++)
+    {
+        BatchRange range = {};
+        range.first = totalPoints;
+        range.count = minPoints + (int)(gen() % (unsigned long long)(maxPoints - minPoints + 1));
+        addToList(ranges, range);
+        totalPoints += range.count;
+    }
+    
+    auto points = (Vertex *)malloc(sizeof(Vertex) * totalPoints);
+    for (int i = 0; i < itemCount; i++)
+    {
+        PointGenerator generator = {};
+        generator.seed = seed + (unsigned long long)i;
+        initPointGenerator(generator, (GeneratorType)(i % 5), ranges[i].count, 0.0, 200.0);
+        auto cloud = generate(generator, offset);
+        memcpy(points + ranges[i].first, cloud, sizeof(Vertex) * ranges[i].count);
+        free(cloud);
+    }
+    
+    BatchContext<S> context = {};
+    List<BatchHull<S>> hulls = {};
+    int threadCounts[2] = {1, hardwareThreadCount()};
+    auto runs = threadCounts[1] > 1 ? 2 : 1;
+    for (int run = 0; run < runs; run++)
+    {
+        auto threadCount = threadCounts[run];
+        auto options = batchDefaultOptions();
+        options.threadCount = threadCount;
+        options.seed = seed;
+        
+        // the first batch grows the per-thread buffers, the rest reuse them
+        batchHulls(context, options, points, ranges.data(), itemCount, hulls);
+        time_long best = ~0ull;
+        for (int r = 0; r < repetitions; r++)
+        {
+            auto start = currentTimeNano();
+            batchHulls(context, options, points, ranges.data(), itemCount, hulls);
+            best = Min(best, currentTimeNano() - start);
+        }
+        
+        int byType[3] = {};
+        auto failed = 0;
+        for (auto &hull : hulls)
+        {
+            if (hull.failed)
+            {
+                failed++;
+            }
+            else
+            {
+                byType[hull.hullType]++;
+            }
+        }
+        log_a("Batch (%s): %d hulls, %d points, %d threads: %.2f ms, %.0f hulls/s (QH %d, incremental %d, D&C %d, failed %d)\n",
+              scalarName, itemCount, totalPoints, threadCount, best / 1e6, itemCount / (best / 1e9), byType[QH], byType[Inc], byType[Dac], failed);
+    }
+    
+    batchFreeHulls(hulls);
+    batchFreeContext(context);
+    clear(ranges);
+    free(points);
+}
+
+// One large hull per generator built by batchParallelHull, against the
+// engine the options pick for the whole input on one thread
+template <typename S>
+static void RunParallelHullBenchmark(glm::vec3 offset, unsigned long long seed, const char *scalarName)
+{
+    const int pointCount = 2000000;
+    const int repetitions = 3;
+    GeneratorType genTypes[] = {InSphere, InCube, ManyInternal};
+
+    for (auto genType : genTypes)
+    {
+        PointGenerator generator = {};
+        generator.seed = seed;
+        initPointGenerator(generator, genType, pointCount, 0.0, 200.0);
+        auto points = generate(generator, offset);
+
+        BatchContext<S> context = {};
+        HullResult<S> result = {};
+        auto options = batchDefaultOptions();
+        options.seed = seed;
+        options.threadCount = 1;
+
+        context.workers.resize(1, BatchWorker<S>{});
+        auto hullType = batchSelectHullType(options, pointCount);
+        time_long single = ~0ull;
+        auto singleOk = true;
+        for (int r = 0; r < repetitions; r++)
+        {
+            auto start = currentTimeNano();
+            singleOk = batchRunHull(context.workers[0], hullType, points, pointCount, options, result) && singleOk;
+            single = Min(single, currentTimeNano() - start);
+        }
+        auto singleFaces = hullResultFaceCount(result);
+
+        int threadCounts[2] = {1, hardwareThreadCount()};
+        auto runs = threadCounts[1] > 1 ? 2 : 1;
+        for (int run = 0; run < runs; run++)
+        {
+            options.threadCount = threadCounts[run];
+            // the one thread run still cuts the input, to show what the cut costs
+            auto chunkCount = Max(8, threadCounts[run]);
+            time_long best = ~0ull;
+            auto ok = true;
+            for (int r = 0; r < repetitions; r++)
+            {
+                auto start = currentTimeNano();
+                ok = batchParallelHull(context, options, points, pointCount, chunkCount, result) && ok;
+                best = Min(best, currentTimeNano() - start);
+            }
+            log_a("Parallel hull (%s) %s: %d points, %d chunks, %d threads: %.2f ms, one hull %.2f ms, %d merged points, %zu faces (one hull %zu%s)%s\n",
+                  scalarName, GetGeneratorTypeString(genType), pointCount, chunkCount, options.threadCount, best / 1e6, single / 1e6,
+                  (int)context.mergePoints.size, hullResultFaceCount(result), singleFaces, singleOk ? "" : ", failed", ok ? "" : ", failed");
+        }
+
+        hullResultFree(result);
+        batchFreeContext(context);
+        free(points);
+    }
+}
+
+#endif
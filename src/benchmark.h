@@ -0,0 +1,220 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+// Give up on a test size if the generated inputs keep making the hull fail
+#define MAX_FAILED_RUNS_PER_RUN 10
+
+struct BenchStats
+{
+    double min;
+    double median;
+    double p95;
+    double mean;
+    double stddev;
+};
+
+// One measured hull run. Times are in nanoseconds.
+struct HullRunSample
+{
+    time_long setupTime;
+    time_long hullTime;
+
+    int addedFaces;
+    int facesOnHull;
+    int pointsProcessed;
+    int verticesOnHull;
+    unsigned long long distanceQueries;
+    unsigned long long sidednessQueries;
+    // orientation tests the floating-point filter could not decide
+    unsigned long long exactPredicates;
+
+    // Per phase times of the engine that produced the sample, see qhPhaseNames etc.
+    PhaseTimes phases;
+    time_long mergeLevelTimes[DAC_MAX_MERGE_LEVELS];
+    int mergeLevels;
+
+    // Hardware counters around the hull construction, only read if the test set asks for them
+    PerfSample perf;
+
+    // Tracked allocations of setup and hull construction, see memory.h
+    MemoryStats memory;
+};
+
+struct HullBenchResult
+{
+    int vertexCount;
+    GeneratorType genType;
+    unsigned long long seed;
+
+    int warmupRuns;
+    int failedRuns;
+    // coordinate type the engine was instantiated with
+    const char *scalarName;
+    // curve the points were sorted along first
+    SpatialOrderCurve spatialOrder;
+    // MemoryPolicyFlags of the large buffers
+    int memoryPolicy;
+
+    const char **phaseNames;
+    int phaseCount;
+    bool hasMergeLevels;
+
+    List<HullRunSample> samples;
+};
+
+// Nearest-rank percentile of already sorted values
+static double percentile(std::vector<double> &sorted, double p)
+{
+    if(sorted.empty())
+    {
+        return 0.0;
+    }
+
+    auto rank = (size_t)ceil(p * (double)sorted.size());
+    rank = Max(rank, (size_t)1);
+    return sorted[Min(rank, sorted.size()) - 1];
+}
+
+static BenchStats computeBenchStats(std::vector<double> values)
+{
+    BenchStats stats = {};
+    if(values.empty())
+    {
+        return stats;
+    }
+
+    std::sort(values.begin(), values.end());
+
+    auto sum = 0.0;
+    for(auto v : values)
+    {
+        sum += v;
+    }
+
+    stats.min = values[0];
+    stats.mean = sum / (double)values.size();
+    stats.median = values.size() % 2 == 0 ? (values[values.size() / 2 - 1] + values[values.size() / 2]) / 2.0 : values[values.size() / 2];
+    stats.p95 = percentile(values, 0.95);
+
+    auto squares = 0.0;
+    for(auto v : values)
+    {
+        squares += (v - stats.mean) * (v - stats.mean);
+    }
+    stats.stddev = values.size() > 1 ? sqrt(squares / (double)(values.size() - 1)) : 0.0;
+
+    return stats;
+}
+
+static BenchStats hullTimeStats(HullBenchResult &result)
+{
+    std::vector<double> values;
+    values.reserve(result.samples.size);
+    for(auto &s : result.samples)
+    {
+        values.push_back((double)s.hullTime);
+    }
+    return computeBenchStats(values);
+}
+
+static BenchStats setupTimeStats(HullBenchResult &result)
+{
+    std::vector<double> values;
+    values.reserve(result.samples.size);
+    for(auto &s : result.samples)
+    {
+        values.push_back((double)s.setupTime);
+    }
+    return computeBenchStats(values);
+}
+
+// Mean of one counter over all samples, e.g. sampleMean(result, &HullRunSample::addedFaces)
+template<typename T>
+static double sampleMean(HullBenchResult &result, T HullRunSample::*counter)
+{
+    if(result.samples.size == 0)
+    {
+        return 0.0;
+    }
+
+    auto sum = 0.0;
+    for(auto &s : result.samples)
+    {
+        sum += (double)(s.*counter);
+    }
+    return sum / (double)result.samples.size;
+}
+
+static double phaseMean(HullBenchResult &result, int phase)
+{
+    if(result.samples.size == 0)
+    {
+        return 0.0;
+    }
+
+    auto sum = 0.0;
+    for(auto &s : result.samples)
+    {
+        sum += (double)s.phases.times[phase];
+    }
+    return sum / (double)result.samples.size;
+}
+
+template<typename T>
+static double memoryMean(HullBenchResult &result, T MemoryStats::*counter)
+{
+    if(result.samples.size == 0)
+    {
+        return 0.0;
+    }
+
+    auto sum = 0.0;
+    for(auto &s : result.samples)
+    {
+        sum += (double)(s.memory.*counter);
+    }
+    return sum / (double)result.samples.size;
+}
+
+static long long maxPeakLiveBytes(HullBenchResult &result)
+{
+    long long peak = 0;
+    for(auto &s : result.samples)
+    {
+        peak = Max(peak, s.memory.peakLiveBytes);
+    }
+    return peak;
+}
+
+// Mean of a hardware counter over all samples, -1 if it could not be read in any of them
+static double perfCounterMean(HullBenchResult &result, int counter)
+{
+    auto sum = 0.0;
+    auto count = 0;
+    for(auto &s : result.samples)
+    {
+        if(s.perf.values[counter] >= 0)
+        {
+            sum += (double)s.perf.values[counter];
+            count++;
+        }
+    }
+    return count > 0 ? sum / (double)count : -1.0;
+}
+
+static double mergeLevelMean(HullBenchResult &result, int level)
+{
+    if(result.samples.size == 0)
+    {
+        return 0.0;
+    }
+
+    auto sum = 0.0;
+    for(auto &s : result.samples)
+    {
+        sum += (double)s.mergeLevelTimes[level];
+    }
+    return sum / (double)result.samples.size;
+}
+
+#endif
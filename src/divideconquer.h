@@ -1,12 +1,13 @@
 #ifndef DIVIDE_H
 #define DIVIDE_H
 
+template <typename S>
 struct DacVertex
 {
-    glm::vec3 position;
+    position_t<S> position;
     int vIndex;
-    DacVertex *next;
-    DacVertex *prev;
+    DacVertex<S> *next;
+    DacVertex<S> *prev;
     void act()
     {
         //insert
@@ -23,25 +24,39 @@ struct DacVertex
     }
 };
 
+template <typename S>
 struct DacFace
 {
-    DacVertex vertex[3];
-    glm::vec3 normal;
-    glm::vec3 centerPoint;
+    DacVertex<S> vertex[3];
 };
 
+// Phases timed by the benchmark harness. Sort runs while initializing the context.
+enum DacPhase
+{
+    DacPhase_Sort,
+    DacPhase_Merge,
+    DacPhase_FaceEmission,
+    DacPhase_Count
+};
+
+static const char *dacPhaseNames[DacPhase_Count] = {"sort", "merge", "face emission"};
+
+// Merge time is also split per level of the bottom up merge, level i merges hulls of 2^i points
+#define DAC_MAX_MERGE_LEVELS 32
+
+template <typename S>
 struct DacContext
 {
     bool initialized;
     bool done;
-    DacVertex *vertices;
+    DacVertex<S> *vertices;
     int numberOfPoints;
-    std::vector<DacFace> faces;
+    std::vector<DacFace<S>> faces;
     Mesh *m;
-    DacVertex *sortedP;
-    DacVertex *sortedUpperP;
-    DacVertex **A;
-    DacVertex **B;
+    DacVertex<S> *sortedP;
+    DacVertex<S> *sortedUpperP;
+    DacVertex<S> **A;
+    DacVertex<S> **B;
     bool lower;
     
     struct
@@ -52,6 +67,9 @@ struct DacContext
         int facesOnHull;
         int verticesOnHull;
         unsigned long long timeSpent;
+        PhaseTimes phases;
+        time_long mergeLevelTimes[DAC_MAX_MERGE_LEVELS];
+        int mergeLevels;
     } processingState;
     
     struct
@@ -66,11 +84,19 @@ struct DacContext
 
 //no need for such a big inf
 const coord_t INF = 1e30f;
-static DacVertex nil = {glm::vec3(INF, INF, INF), 0, nullptr, nullptr};
-DacVertex *NIL = &nil;
+
+//sentinel vertex ending every list, one per coordinate type and thread.
+//the merge writes to it, so a context must be built on the thread that initialized it
+template <typename S>
+static DacVertex<S> *dacNil()
+{
+    static thread_local DacVertex<S> nil = {position_t<S>(INF, INF, INF), 0, nullptr, nullptr};
+    return &nil;
+}
 
 //bottom up merge sort
-void merge(DacVertex *A, DacVertex *B, int size, int left, int mid)
+template <typename S>
+void merge(DacVertex<S> *A, DacVertex<S> *B, int size, int left, int mid)
 {
     int right = mid + mid - left;
     if (right > size)
@@ -93,26 +119,28 @@ void merge(DacVertex *A, DacVertex *B, int size, int left, int mid)
         A[i] = B[i];
 }
 
-void sort(DacVertex A[], int n)
+template <typename S>
+void sort(DacVertex<S> A[], int n)
 {
     int subsize, left, mid;
-    DacVertex *B = new DacVertex[n];
+    DacVertex<S> *B = (DacVertex<S> *)memAllocLarge(n * sizeof(DacVertex<S>));
     for (subsize = 1; subsize < n; subsize *= 2)
         for (left = 0, mid = subsize; mid < n; left = mid + subsize, mid = left + subsize)
         merge(A, B, n, left, mid);
-    delete[] B;
+    memFreeLarge(B);
 }
 
-glm::vec3 dacComputeFaceNormal(DacFace f)
+template <typename S>
+position_t<S> dacComputeFaceNormal(const DacFace<S> &f)
 {
     // Newell's Method
     // https://www.khronos.org/opengl/wiki/Calculating_a_Surface_Normal
-    glm::vec3 normal = glm::vec3(0.0);
+    position_t<S> normal = position_t<S>(0);
     
     for (int i = 0; i < 3; i++)
     {
-        glm::vec3 current = f.vertex[i].position;
-        glm::vec3 next = f.vertex[(i + 1) % 3].position;
+        position_t<S> current = f.vertex[i].position;
+        position_t<S> next = f.vertex[(i + 1) % 3].position;
         
         normal.x = normal.x + (current.y - next.y) * (current.z + next.z);
         normal.y = normal.y + (current.z - next.z) * (current.x + next.x);
@@ -122,58 +150,65 @@ glm::vec3 dacComputeFaceNormal(DacFace f)
     return glm::normalize(normal);
 }
 
-static bool dacIsPointOnPositiveSide(DacFace f, DacVertex v, coord_t epsilon = 0.0)
+//exact, the face normal points to the side orient3d calls below
+template <typename S>
+static bool dacIsPointOnPositiveSide(DacFace<S> &f, DacVertex<S> &v)
 {
-    auto d = glm::dot(f.normal, v.position - f.centerPoint);
-    return d > epsilon;
+    return orient3d(f.vertex[0].position, f.vertex[1].position, f.vertex[2].position, v.position) < 0.0;
 }
 
-DacFace dacCreateFaceFromPoints(DacVertex *u, DacVertex *v, DacVertex *w)
+template <typename S>
+DacFace<S> dacCreateFaceFromPoints(DacVertex<S> *u, DacVertex<S> *v, DacVertex<S> *w)
 {
-    DacFace f = {};
-    DacVertex v1 = {};
+    DacFace<S> f = {};
+    DacVertex<S> v1 = {};
     v1.position = u->position;
     v1.vIndex = u->vIndex;
-    DacVertex v2 = {};
+    DacVertex<S> v2 = {};
     v2.position = v->position;
     v2.vIndex = v->vIndex;
-    DacVertex v3 = {};
+    DacVertex<S> v3 = {};
     v3.position = w->position;
     v3.vIndex = w->vIndex;
     f.vertex[0] = v1;
     f.vertex[1] = v2;
     f.vertex[2] = v3;
-    f.centerPoint = (u->position + v->position + w->position) / 3.0f;
-    f.normal = dacComputeFaceNormal(f);
     return f;
 }
 
-static void dacCopyVertices(DacContext &dac, Vertex *vertices, int numberOfPoints)
+template <typename S, typename P>
+static void dacCopyVertices(DacContext<S> &dac, P *vertices, int numberOfPoints)
 {
-    dac.vertices = (DacVertex *)malloc(sizeof(DacVertex) * numberOfPoints);
+    auto NIL = dacNil<S>();
+    dac.vertices = (DacVertex<S> *)memAllocLarge(sizeof(DacVertex<S>) * numberOfPoints);
     for (int i = 0; i < numberOfPoints; i++)
     {
         dac.vertices[i].vIndex = i;
-        dac.vertices[i].position = vertices[i].position;
+        dac.vertices[i].position = position_t<S>(vertices[i].position);
         dac.vertices[i].prev = dac.vertices[i].next = NIL;
     }
 }
 
-void createFaces(DacContext &dacContext, DacVertex **events)
+template <typename S>
+void createFaces(DacContext<S> &dacContext, DacVertex<S> **events)
 {
+    auto NIL = dacNil<S>();
     int i;
     for (i = 0; events[i] != NIL; i++)
     {
         if(events[i]->prev == NIL || events[i] == NIL || events[i]->next == NIL)
             continue;
-        DacFace newFace = dacCreateFaceFromPoints(events[i]->prev, events[i], events[i]->next);
+        DacFace<S> newFace = dacCreateFaceFromPoints(events[i]->prev, events[i], events[i]->next);
         dacContext.faces.push_back(newFace);
         events[i]->act();
     }    
 }
 
-double orient(DacVertex *p, DacVertex *q, DacVertex *r)
+template <typename S>
+double orient(DacVertex<S> *p, DacVertex<S> *q, DacVertex<S> *r)
 {
+    auto NIL = dacNil<S>();
+    
     //orient(p,q,r)=det(1  p_x  p_y)
     //                 (1  q_x  q_y)
     //                 (1  r_x  r_y)
@@ -184,12 +219,15 @@ double orient(DacVertex *p, DacVertex *q, DacVertex *r)
     {
         return 1.0;
     }
-    return (q->position.x - p->position.x) * (r->position.y - p->position.y) - (r->position.x - p->position.x) * (q->position.y - p->position.y);
+    //exact sign, the value is only approximate
+    return orient2d(p->position.x, p->position.y, q->position.x, q->position.y, r->position.x, r->position.y);
 }
 
 //by dividing with orient, we can determine the time when three points switch from cw to ccw (or the other way)
-double time(DacVertex *p, DacVertex *q, DacVertex *r)
+template <typename S>
+double time(DacVertex<S> *p, DacVertex<S> *q, DacVertex<S> *r)
 {
+    auto NIL = dacNil<S>();
     if (p == NIL || q == NIL || r == NIL)
     {
         return INF;
@@ -198,8 +236,10 @@ double time(DacVertex *p, DacVertex *q, DacVertex *r)
     return ((q->position.x - p->position.x) * (r->position.z - p->position.z) - (r->position.x - p->position.x) * (q->position.z - p->position.z)) / orient(p, q, r);
 }
 
-void dacHull(DacContext &dacContext, DacVertex *list, DacVertex **A, DacVertex **B, int offset, int mergeIteration, bool lower)
+template <typename S>
+void dacHull(DacContext<S> &dacContext, DacVertex<S> *list, DacVertex<S> **A, DacVertex<S> **B, int offset, int mergeIteration, bool lower)
 {
+    auto NIL = dacNil<S>();
     int leftSideIndex = mergeIteration * offset;
     int rightSideIndex = (leftSideIndex + ((mergeIteration + 1) * offset)) / 2;
     int eventOffset = leftSideIndex * 2;
@@ -211,7 +251,20 @@ void dacHull(DacContext &dacContext, DacVertex *list, DacVertex **A, DacVertex *
         return;
     }
     
-    DacVertex *u, *v, *mid;
+    //if n is not a power of two, the last block of a level can lack its right half.
+    //its hull is the left one unchanged
+    if (rightSideIndex >= dacContext.numberOfPoints)
+    {
+        int e;
+        for (e = eventOffset; B[e] != NIL; e++)
+        {
+            A[e] = B[e];
+        }
+        A[e] = NIL;
+        return;
+    }
+    
+    DacVertex<S> *u, *v, *mid;
     int i, j, k, l, minl;
     
     // find last u in L
@@ -335,7 +388,7 @@ void dacHull(DacContext &dacContext, DacVertex *list, DacVertex **A, DacVertex *
     u->next = v;
     v->prev = u;
     
-    dacContext.processingState.createdFaces += k;
+    dacContext.processingState.createdFaces += k - eventOffset;
     // now go back in time to update pointers
     // during insertion of q between p and r, we cannot store p and r in the prev and next fields, as they are still in use in L and R
     for (k--; k >= eventOffset; k--)
@@ -370,44 +423,57 @@ void dacHull(DacContext &dacContext, DacVertex *list, DacVertex **A, DacVertex *
     }
 }
 
-void dacConstructFullHull(DacContext &dacContext)
+template <typename S>
+void dacConstructFullHull(DacContext<S> &dacContext)
 {
     int n = dacContext.numberOfPoints;
-    DacVertex *P = dacContext.sortedP;
+    DacVertex<S> *P = dacContext.sortedP;
     
     int i;
     bool swap;
-    int offset, mergesLeft;
+    int offset, mergesLeft, level;
+    auto &processingState = dacContext.processingState;
     
     for (int m = 0; m < 2; m++)
     {
-        dacContext.A = (DacVertex **)malloc(2 * n * sizeof(DacVertex));
-        dacContext.B = (DacVertex **)malloc(2 * n * sizeof(DacVertex));
+        dacContext.A = (DacVertex<S> **)memAllocLarge(2 * n * sizeof(DacVertex<S> *));
+        dacContext.B = (DacVertex<S> **)memAllocLarge(2 * n * sizeof(DacVertex<S> *));
         
         offset = 1;
         swap = true;
         mergesLeft = n;
-        while (mergesLeft > 0)
+        level = 0;
         {
-            for (i = 0; i < mergesLeft; i++)
+            TIME_PHASE(processingState.phases, DacPhase_Merge);
+            while (mergesLeft > 0)
             {
-                if (swap)
-                {
-                    dacHull(dacContext, P, dacContext.A, dacContext.B, offset, i, dacContext.lower);
-                }
-                else
+                TIME_SLOT(processingState.mergeLevelTimes[Min(level, DAC_MAX_MERGE_LEVELS - 1)], mergeLevel);
+                for (i = 0; i < mergesLeft; i++)
                 {
-                    dacHull(dacContext, P, dacContext.B, dacContext.A, offset, i, dacContext.lower);
+                    if (swap)
+                    {
+                        dacHull(dacContext, P, dacContext.A, dacContext.B, offset, i, dacContext.lower);
+                    }
+                    else
+                    {
+                        dacHull(dacContext, P, dacContext.B, dacContext.A, offset, i, dacContext.lower);
+                    }
                 }
+                swap = !swap;
+                offset *= 2;
+                //round up, a partial last block still needs merging
+                mergesLeft = mergesLeft > 1 ? (mergesLeft + 1) / 2 : 0;
+                level++;
             }
-            swap = !swap;
-            offset *= 2;
-            mergesLeft /= 2;
         }
+        processingState.mergeLevels = Max(processingState.mergeLevels, level);
         
-        swap ? createFaces(dacContext, dacContext.B) : createFaces(dacContext, dacContext.A);
-        free(dacContext.A);
-        free(dacContext.B);
+        {
+            TIME_PHASE(processingState.phases, DacPhase_FaceEmission);
+            swap ? createFaces(dacContext, dacContext.B) : createFaces(dacContext, dacContext.A);
+        }
+        memFreeLarge(dacContext.A);
+        memFreeLarge(dacContext.B);
         
         P = dacContext.sortedUpperP;
         dacContext.lower = false;
@@ -416,7 +482,8 @@ void dacConstructFullHull(DacContext &dacContext)
     dacContext.processingState.facesOnHull = (int)dacContext.faces.size();
 }
 
-void dacHullStep(DacContext &dacContext)
+template <typename S>
+void dacHullStep(DacContext<S> &dacContext)
 {
     if (!dacContext.initialized || dacContext.done)
     {
@@ -426,15 +493,15 @@ void dacHullStep(DacContext &dacContext)
     int i, m;
     int n = dacContext.numberOfPoints;
 
-    DacVertex *tempP = (DacVertex *)malloc(n * sizeof(DacVertex));
-    memcpy(tempP, dacContext.sortedP, sizeof(DacVertex) * n);
-    DacVertex *tempUpperP = (DacVertex *)malloc(n * sizeof(DacVertex));
-    memcpy(tempUpperP, dacContext.sortedUpperP, sizeof(DacVertex) * n);
+    DacVertex<S> *tempP = (DacVertex<S> *)memAllocLarge(n * sizeof(DacVertex<S>));
+    memcpy(tempP, dacContext.sortedP, sizeof(DacVertex<S>) * n);
+    DacVertex<S> *tempUpperP = (DacVertex<S> *)memAllocLarge(n * sizeof(DacVertex<S>));
+    memcpy(tempUpperP, dacContext.sortedUpperP, sizeof(DacVertex<S>) * n);
 
-    DacVertex** A = (DacVertex **)malloc(2 * n * sizeof(DacVertex));
-    DacVertex** B = (DacVertex **)malloc(2 * n * sizeof(DacVertex));
-    DacVertex** C = (DacVertex **)malloc(2 * n * sizeof(DacVertex));
-    DacVertex** D = (DacVertex **)malloc(2 * n * sizeof(DacVertex));
+    DacVertex<S>** A = (DacVertex<S> **)memAllocLarge(2 * n * sizeof(DacVertex<S> *));
+    DacVertex<S>** B = (DacVertex<S> **)memAllocLarge(2 * n * sizeof(DacVertex<S> *));
+    DacVertex<S>** C = (DacVertex<S> **)memAllocLarge(2 * n * sizeof(DacVertex<S> *));
+    DacVertex<S>** D = (DacVertex<S> **)memAllocLarge(2 * n * sizeof(DacVertex<S> *));
 
     if (dacContext.stepInfo.initAB)
     {
@@ -466,7 +533,7 @@ void dacHullStep(DacContext &dacContext)
         }
         swap = !swap;
         offset *= 2;
-        mergesLeft /= 2;
+        mergesLeft = mergesLeft > 1 ? (mergesLeft + 1) / 2 : 0;
     }
 
     int start, end;
@@ -490,14 +557,14 @@ void dacHullStep(DacContext &dacContext)
             createFaces(dacContext, D + (start * 2));
         }
     }
-    mergesLeft /= 2;
+    mergesLeft = mergesLeft > 1 ? (mergesLeft + 1) / 2 : 0;
 
-    free(A);
-    free(B);
-    free(C);
-    free(D);
-    free(tempP);
-    free(tempUpperP);
+    memFreeLarge(A);
+    memFreeLarge(B);
+    memFreeLarge(C);
+    memFreeLarge(D);
+    memFreeLarge(tempP);
+    memFreeLarge(tempUpperP);
 
     if (mergesLeft < 1)
     {
@@ -506,42 +573,94 @@ void dacHullStep(DacContext &dacContext)
     }
 }
 
-void dacInitializeContext(DacContext &dacContext, Vertex *vertices, int n)
+// Frees the vertex buffers of the last run
+template <typename S>
+void dacFreeContext(DacContext<S> &dacContext)
 {
-    if (dacContext.vertices)
-    {
-        free(dacContext.vertices);
-    }
-    if (dacContext.sortedP)
-    {
-        free(dacContext.sortedP);
-    }
-    if (dacContext.sortedUpperP)
-    {
-        free(dacContext.sortedUpperP);
-    }
+    memFreeLarge(dacContext.vertices);
+    memFreeLarge(dacContext.sortedP);
+    memFreeLarge(dacContext.sortedUpperP);
+    dacContext.vertices = nullptr;
+    dacContext.sortedP = nullptr;
+    dacContext.sortedUpperP = nullptr;
     dacContext.faces.clear();
+    dacContext.initialized = false;
+}
+
+template <typename S, typename P>
+void dacInitializeContext(DacContext<S> &dacContext, P *vertices, int n)
+{
+    dacFreeContext(dacContext);
     dacContext.done = false;
+    dacContext.processingState = {};
 
     dacContext.numberOfPoints = n;
     dacContext.initialized = true;
-    nil.position = glm::vec3(INF, INF, INF);
+    auto &nil = *dacNil<S>();
+    nil.position = position_t<S>(INF, INF, INF);
     nil.vIndex = 0;
     nil.next = nullptr;
     nil.prev = nullptr;
     dacCopyVertices(dacContext, vertices, n);
     
-    dacContext.sortedP = (DacVertex *)malloc(sizeof(DacVertex) * n);
-    memcpy(dacContext.sortedP, dacContext.vertices, sizeof(DacVertex) * n);
+    dacContext.sortedP = (DacVertex<S> *)memAllocLarge(sizeof(DacVertex<S>) * n);
+    memcpy(dacContext.sortedP, dacContext.vertices, sizeof(DacVertex<S>) * n);
     
-    sort(dacContext.sortedP, n);
-    dacContext.sortedUpperP = (DacVertex *)malloc(sizeof(DacVertex) * n);
-    memcpy(dacContext.sortedUpperP, dacContext.sortedP, sizeof(DacVertex) * n);
+    {
+        TIME_PHASE(dacContext.processingState.phases, DacPhase_Sort);
+        sort(dacContext.sortedP, n);
+    }
+    dacContext.sortedUpperP = (DacVertex<S> *)memAllocLarge(sizeof(DacVertex<S>) * n);
+    memcpy(dacContext.sortedUpperP, dacContext.sortedP, sizeof(DacVertex<S>) * n);
     dacContext.lower = true;
     dacContext.stepInfo.initAB = true;
 }
 
-Mesh &dacConvertToMesh(DacContext &context, RenderContext &renderContext)
+//the kinetic merge assumes no two points share an x coordinate, which float
+//input of a few thousand points already breaks now and then
+template <typename S>
+bool dacHasDistinctX(DacContext<S> &dacContext)
+{
+    for (int i = 1; i < dacContext.numberOfPoints; i++)
+    {
+        if (dacContext.sortedP[i].position.x == dacContext.sortedP[i - 1].position.x)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Writes the finished hull to result, see HullResultFlags for flags. The merge
+// emits faces in either orientation, they are turned to face away from the
+// mean of their vertices, which lies inside the hull.
+template <typename S>
+void dacExtractResult(DacContext<S> &context, HullResult<S> &result, int flags)
+{
+    hullResultBegin(result, flags, context.numberOfPoints, context.faces.size());
+    if (context.faces.empty())
+    {
+        return;
+    }
+    
+    position_t<S> inside = position_t<S>(0);
+    for (const auto &f : context.faces)
+    {
+        inside += f.vertex[0].position + f.vertex[1].position + f.vertex[2].position;
+    }
+    inside /= (S)(context.faces.size() * 3);
+    
+    for (const auto &f : context.faces)
+    {
+        auto flip = orient3d(f.vertex[0].position, f.vertex[1].position, f.vertex[2].position, inside) < 0.0;
+        int inputIndex[3] = {f.vertex[0].vIndex, f.vertex[flip ? 2 : 1].vIndex, f.vertex[flip ? 1 : 2].vIndex};
+        const position_t<S> *position[3] = {&f.vertex[0].position, &f.vertex[flip ? 2 : 1].position, &f.vertex[flip ? 1 : 2].position};
+        hullResultAddFace(result, inputIndex, position);
+    }
+}
+
+template <typename S>
+Mesh &dacConvertToMesh(DacContext<S> &context, RenderContext &renderContext)
 {
     if (!context.m)
     {
@@ -556,20 +675,19 @@ Mesh &dacConvertToMesh(DacContext &context, RenderContext &renderContext)
     //dirty normal check
     for (size_t j = 0; j != context.faces.size(); ++j)
     {
-        DacFace& face = context.faces[j];
-        DacFace& otherFace = context.faces[(j + 199) % context.faces.size()];
+        DacFace<S>& face = context.faces[j];
+        DacFace<S>& otherFace = context.faces[(j + 199) % context.faces.size()];
         for (int i = 0; i < 3; ++i)
         {
-            DacVertex& v = otherFace.vertex[i];
+            DacVertex<S>& v = otherFace.vertex[i];
             if (v.vIndex != face.vertex[0].vIndex || v.vIndex != face.vertex[1].vIndex || v.vIndex != face.vertex[2].vIndex)
             {
                 if (dacIsPointOnPositiveSide(face, v))
                 {
-                    DacVertex u = face.vertex[0];
-                    DacVertex w = face.vertex[2];
+                    DacVertex<S> u = face.vertex[0];
+                    DacVertex<S> w = face.vertex[2];
                     face.vertex[0] = w;
                     face.vertex[2] = u;
-                    face.normal = dacComputeFaceNormal(face);
                     break;
                 }
             }
@@ -583,14 +701,15 @@ Mesh &dacConvertToMesh(DacContext &context, RenderContext &renderContext)
         for (int i = 0; i < 3; i++)
         {
             Vertex newVertex = {};
-            newVertex.position = f.vertex[i].position;
+            newVertex.position = glm::vec3(f.vertex[i].position);
             newVertex.vertexIndex = f.vertex[i].vIndex;
             addToList(newFace.vertices, newVertex);
         }
         newFace.faceColor = rgb(251, 255, 135);
         newFace.faceColor.w = 0.5f;
-        newFace.faceNormal = f.normal;
-        newFace.centerPoint = f.centerPoint;
+        //only drawing needs these, so they aren't kept on the faces
+        newFace.faceNormal = glm::vec3(dacComputeFaceNormal(f));
+        newFace.centerPoint = glm::vec3((f.vertex[0].position + f.vertex[1].position + f.vertex[2].position) / (S)3);
         context.m->faces.push_back(newFace);
     }
     if(!context.done)
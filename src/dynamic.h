@@ -0,0 +1,490 @@
+#ifndef DYNAMIC_H
+#define DYNAMIC_H
+
+// Hulls of point sets that change over time. Instead of building the hull of
+// the whole set again after every change, the hull of the last state is kept
+// and only the change is applied to it.
+
+// A hull under insertions and removals, for point sets like a sliding window
+// over a sensor stream. Every point gets an id, the slot it is kept in. The ids
+// of removed points are handed out again, so the slots grow with the most
+// points live at once rather than with the stream. The hull is kept by the
+// incremental engine: insertions go through incInsertPoints. Removing a point
+// inside the hull only marks it. Removing a hull vertex patches the hole with
+// incRemoveHullVertex, then puts the points that were hidden under the vertex
+// back with incInsertPoints. A uniform grid over the live points finds those.
+// Hulls too small to patch are built again from the live points.
+template <typename S>
+struct DynamicHull
+{
+    IncContext<S> incContext;
+    
+    // the points by id. Removed points keep their slot until it is reused.
+    List<position_t<S>> points;
+    List<bool> alive;
+    int aliveCount;
+    // ids of removed points, reused before points grows
+    List<int> freeIds;
+    
+    // grid cell of side cellSize -> ids of the live points in it, only the
+    // cells that have some
+    S cellSize;
+    std::unordered_map<unsigned long long, List<int>> cells;
+    // where each live point is in its cell's list
+    List<int> slotInCell;
+    
+    unsigned long long seed;
+    // how often the hull was built from scratch
+    int rebuilds;
+};
+
+template <typename S>
+static glm::ivec3 dynamicCellOf(DynamicHull<S> &hull, const position_t<S> &p)
+{
+    return glm::ivec3(glm::floor(p / hull.cellSize));
+}
+
+static unsigned long long dynamicCellKey(glm::ivec3 cell)
+{
+    auto bits = [](int c) { return (unsigned long long)(c + (1 << 20)) & 0x1fffffull; };
+    return bits(cell.x) | (bits(cell.y) << 21) | (bits(cell.z) << 42);
+}
+
+template <typename S>
+static void dynamicAddToGrid(DynamicHull<S> &hull, int id)
+{
+    auto &cell = hull.cells[dynamicCellKey(dynamicCellOf(hull, hull.points[id]))];
+    hull.slotInCell[id] = (int)cell.size;
+    addToList(cell, id);
+}
+
+template <typename S>
+static void dynamicRemoveFromGrid(DynamicHull<S> &hull, int id)
+{
+    auto found = hull.cells.find(dynamicCellKey(dynamicCellOf(hull, hull.points[id])));
+    auto &cell = found->second;
+    auto slot = hull.slotInCell[id];
+    auto last = cell[cell.size - 1];
+    cell[slot] = last;
+    hull.slotInCell[last] = slot;
+    cell.size--;
+    // a window drifting through space would otherwise leave a trail of them
+    if (cell.size == 0)
+    {
+        clear(cell);
+        hull.cells.erase(found);
+    }
+}
+
+// Appends the ids of the live points in the box [min, max] to ids
+template <typename S>
+static void dynamicPointsInBox(DynamicHull<S> &hull, const position_t<S> &min, const position_t<S> &max, std::vector<int> &ids)
+{
+    auto first = dynamicCellOf(hull, min);
+    auto last = dynamicCellOf(hull, max);
+    auto cellCount = (double)(last.x - first.x + 1) * (double)(last.y - first.y + 1) * (double)(last.z - first.z + 1);
+    if (cellCount > (double)hull.cells.size())
+    {
+        // mostly empty cells, faster to look at every live point
+        for (auto &cell : hull.cells)
+        {
+            for (auto id : cell.second)
+            {
+                auto &p = hull.points[id];
+                if (glm::all(glm::greaterThanEqual(p, min)) && glm::all(glm::lessThanEqual(p, max)))
+                {
+                    ids.push_back(id);
+                }
+            }
+        }
+        return;
+    }
+    
+    for (int z = first.z; z <= last.z; z++)
+    {
+        for (int y = first.y; y <= last.y; y++)
+        {
+            for (int x = first.x; x <= last.x; x++)
+            {
+                auto cell = hull.cells.find(dynamicCellKey(glm::ivec3(x, y, z)));
+                if (cell != hull.cells.end())
+                {
+                    ids.insert(ids.end(), cell->second.begin(), cell->second.end());
+                }
+            }
+        }
+    }
+}
+
+// Builds the hull of the live points from scratch
+template <typename S>
+static void dynamicRebuild(DynamicHull<S> &hull)
+{
+    incFreeContext(hull.incContext);
+    hull.rebuilds++;
+    if (hull.aliveCount < 4)
+    {
+        return;
+    }
+    
+    // the grid holds exactly the live points. They are sorted by id so the
+    // hull doesn't depend on the order of the cells.
+    auto ids = (int *)memAlloc(sizeof(int) * hull.aliveCount);
+    auto n = 0;
+    for (auto &cell : hull.cells)
+    {
+        for (auto id : cell.second)
+        {
+            ids[n++] = id;
+        }
+    }
+    std::sort(ids, ids + n);
+    
+    // the points came in as Vertex, so they convert back without rounding
+    auto vertices = (Vertex *)memAlloc(sizeof(Vertex) * n);
+    for (int i = 0; i < n; i++)
+    {
+        vertices[i] = {};
+        vertices[i].position = glm::vec3(hull.points[ids[i]]);
+    }
+    
+    incInitializeContext(hull.incContext, vertices, n, hull.seed);
+    incConstructFullHull(hull.incContext);
+    auto *v = hull.incContext.vertices;
+    do
+    {
+        v->vIndex = ids[v->vIndex];
+        v = v->next;
+    } while (v != hull.incContext.vertices);
+    hull.incContext.numberOfPoints = (int)hull.points.size;
+    
+    memFree(vertices);
+    memFree(ids);
+}
+
+// Adds count points and writes the id each of them got to ids
+template <typename S>
+static void dynamicInsert(DynamicHull<S> &hull, Vertex *points, int count, int *ids)
+{
+    std::vector<position_t<S>> positions((size_t)count);
+    for (int i = 0; i < count; i++)
+    {
+        positions[i] = position_t<S>(points[i].position);
+        if (hull.freeIds.size > 0)
+        {
+            ids[i] = hull.freeIds[hull.freeIds.size - 1];
+            hull.freeIds.size--;
+            hull.points[ids[i]] = positions[i];
+            hull.alive[ids[i]] = true;
+        }
+        else
+        {
+            ids[i] = (int)hull.points.size;
+            addToList(hull.points, positions[i]);
+            addToList(hull.alive, true);
+            addToList(hull.slotInCell, 0);
+        }
+        dynamicAddToGrid(hull, ids[i]);
+    }
+    hull.aliveCount += count;
+    
+    if (!hull.incContext.faces || hull.incContext.failed)
+    {
+        dynamicRebuild(hull);
+    }
+    else
+    {
+        incInsertPoints(hull.incContext, positions.data(), ids, count);
+        hull.incContext.numberOfPoints = (int)hull.points.size;
+    }
+}
+
+// Starts a hull of count points, with the ids 0 to count - 1
+template <typename S>
+static void dynamicInitialize(DynamicHull<S> &hull, Vertex *points, int count, unsigned long long seed)
+{
+    hull.seed = seed;
+    hull.rebuilds = 0;
+    
+    // about four points per cell
+    glm::vec3 min = count > 0 ? points[0].position : glm::vec3(0.0f);
+    glm::vec3 max = min;
+    for (int i = 1; i < count; i++)
+    {
+        min = glm::min(min, points[i].position);
+        max = glm::max(max, points[i].position);
+    }
+    auto extent = position_t<S>(max - min);
+    auto volume = Max(extent.x, (S)1e-6) * Max(extent.y, (S)1e-6) * Max(extent.z, (S)1e-6);
+    hull.cellSize = Max((S)std::cbrt(volume * 4 / Max(count, 1)), (S)1e-6);
+    
+    std::vector<int> ids((size_t)count);
+    dynamicInsert(hull, points, count, ids.data());
+}
+
+// Removes the points with the given ids. Ids of points already removed are
+// skipped, as long as no insertion has handed them out again since.
+template <typename S>
+static void dynamicRemove(DynamicHull<S> &hull, const int *ids, int count)
+{
+    auto &incContext = hull.incContext;
+    std::vector<IncFace<S> *> patch;
+    std::vector<int> uncovered;
+    std::vector<int> nearby;
+    bool rebuild = !incContext.faces || incContext.failed;
+    
+    // each walk to a hull vertex starts at the patch of the previous removal,
+    // so the removals go in Z-order
+    std::vector<unsigned long long> order;
+    position_t<S> min = count > 0 ? hull.points[ids[0]] : position_t<S>(0);
+    position_t<S> max = min;
+    for (int i = 0; i < count; i++)
+    {
+        min = glm::min(min, hull.points[ids[i]]);
+        max = glm::max(max, hull.points[ids[i]]);
+    }
+    for (int i = 0; i < count; i++)
+    {
+        if (hull.alive[ids[i]])
+        {
+            order.push_back(((unsigned long long)mortonCode(hull.points[ids[i]], min, max) << 32) | (unsigned int)ids[i]);
+        }
+    }
+    std::sort(order.begin(), order.end());
+    
+    for (auto key : order)
+    {
+        auto id = (int)(key & 0xffffffffull);
+        if (!hull.alive[id])
+        {
+            continue;
+        }
+        hull.alive[id] = false;
+        hull.aliveCount--;
+        dynamicRemoveFromGrid(hull, id);
+        // nothing of the hull refers to it once this call is done: a hull
+        // vertex is cut out below or by the rebuild, the engine doesn't keep
+        // points inside the hull
+        addToList(hull.freeIds, id);
+        if (rebuild)
+        {
+            continue;
+        }
+        
+        auto &position = hull.points[id];
+        int corner;
+        IncFace<S> *face = incFindHullVertex(incContext, position, id, corner);
+        if (!face)
+        {
+            continue;
+        }
+        // removing a vertex from a tetrahedron leaves a flat hull
+        if (incContext.processingState.verticesOnHull <= 4)
+        {
+            rebuild = true;
+            continue;
+        }
+        
+        patch.clear();
+        incRemoveHullVertex(incContext, face, corner, patch);
+        if (incContext.failed)
+        {
+            rebuild = true;
+            continue;
+        }
+        
+        // what the vertex hid lies inside the box around it and its neighbours,
+        // and in front of one of the faces that replaced its star
+        auto boxMin = position;
+        auto boxMax = position;
+        for (IncFace<S> *f : patch)
+        {
+            for (int k = 0; k < 3; k++)
+            {
+                boxMin = glm::min(boxMin, f->vertex[k]->position);
+                boxMax = glm::max(boxMax, f->vertex[k]->position);
+            }
+        }
+        nearby.clear();
+        dynamicPointsInBox(hull, boxMin, boxMax, nearby);
+        for (auto candidate : nearby)
+        {
+            auto &p = hull.points[candidate];
+            for (IncFace<S> *f : patch)
+            {
+                if (orient3d(f->vertex[0]->position, f->vertex[1]->position, f->vertex[2]->position, p) < 0.0)
+                {
+                    uncovered.push_back(candidate);
+                    break;
+                }
+            }
+        }
+    }
+    
+    if (rebuild)
+    {
+        dynamicRebuild(hull);
+        return;
+    }
+    
+    // a point can be uncovered by several removals and removed after that
+    std::sort(uncovered.begin(), uncovered.end());
+    uncovered.erase(std::unique(uncovered.begin(), uncovered.end()), uncovered.end());
+    std::vector<position_t<S>> positions;
+    std::vector<int> insertIds;
+    for (auto id : uncovered)
+    {
+        if (hull.alive[id])
+        {
+            positions.push_back(hull.points[id]);
+            insertIds.push_back(id);
+        }
+    }
+    incInsertPoints(incContext, positions.data(), insertIds.data(), (int)insertIds.size());
+    if (incContext.failed)
+    {
+        dynamicRebuild(hull);
+    }
+}
+
+// Writes the current hull to result, ids as input indices. Empty with fewer than four live points.
+template <typename S>
+static void dynamicExtract(DynamicHull<S> &hull, HullResult<S> &result, int flags)
+{
+    if (!hull.incContext.faces)
+    {
+        hullResultBegin(result, flags, 0, 0);
+        return;
+    }
+    incExtractResult(hull.incContext, result, flags);
+}
+
+template <typename S>
+static void dynamicFree(DynamicHull<S> &hull)
+{
+    incFreeContext(hull.incContext);
+    clear(hull.points);
+    clear(hull.alive);
+    clear(hull.freeIds);
+    clear(hull.slotInCell);
+    for (auto &cell : hull.cells)
+    {
+        clear(cell.second);
+    }
+    hull.cells.clear();
+    hull.aliveCount = 0;
+}
+
+// Builds the hull of baseCount points, then inserts insertCount more in batches
+// of each size in batchSizes and compares that with building the hull of all
+// the points from scratch.
+template <typename S>
+static void RunInsertionBenchmark(glm::vec3 offset, unsigned long long seed, const char *scalarName)
+{
+    const int baseCount = 50000;
+    const int insertCount = 5000;
+    const int batchSizes[] = {1, 64, 1024, insertCount};
+    GeneratorType genTypes[] = {InSphere, OnSphere};
+    
+    for (auto genType : genTypes)
+    {
+        // points are drawn per index, so the first baseCount are the base cloud
+        // and the rest arrive later from the same distribution
+        PointGenerator generator = {};
+        generator.seed = seed;
+        initPointGenerator(generator, genType, baseCount + insertCount, 0.0, 200.0);
+        auto points = generate(generator, offset);
+        
+        IncContext<S> incContext = {};
+        incInitializeContext(incContext, points, baseCount + insertCount, seed);
+        auto rebuildStart = currentTimeNano();
+        incConstructFullHull(incContext);
+        auto rebuildTime = currentTimeNano() - rebuildStart;
+        auto rebuildFaces = incContext.processingState.facesOnHull;
+        
+        for (auto batchSize : batchSizes)
+        {
+            incInitializeContext(incContext, points, baseCount, seed);
+            incConstructFullHull(incContext);
+            
+            time_long insertTime = 0;
+            for (int first = baseCount; first < baseCount + insertCount && !incContext.failed; first += batchSize)
+            {
+                auto count = Min(batchSize, baseCount + insertCount - first);
+                auto start = currentTimeNano();
+                incInsertPoints(incContext, points + first, count);
+                insertTime += currentTimeNano() - start;
+            }
+            
+            log_a("Insertion (%s) %s: %d points onto %d in batches of %d: %.2f ms, %.2f us per point, %d faces (rebuild %.2f ms, %d faces)%s\n",
+                  scalarName, GetGeneratorTypeString(genType), insertCount, baseCount, batchSize, insertTime / 1e6, insertTime / 1e3 / insertCount,
+                  incContext.processingState.facesOnHull, rebuildTime / 1e6, rebuildFaces, incContext.failed ? ", failed" : "");
+        }
+        
+        incFreeContext(incContext);
+        free(points);
+    }
+}
+
+// Slides a window of windowSize points over a stream: every step removes the
+// oldest points and adds as many new ones. Compares the time per step with
+// building the hull of the window from scratch.
+template <typename S>
+static void RunSlidingWindowBenchmark(glm::vec3 offset, unsigned long long seed, const char *scalarName)
+{
+    const int windowSize = 20000;
+    const int streamed = 8192;
+    const int stepSizes[] = {16, 256, 2048};
+    GeneratorType genTypes[] = {InSphere, OnSphere, Clusters};
+    
+    for (auto genType : genTypes)
+    {
+        PointGenerator generator = {};
+        generator.seed = seed;
+        initPointGenerator(generator, genType, windowSize + streamed, 0.0, 200.0);
+        auto points = generate(generator, offset);
+        
+        IncContext<S> incContext = {};
+        incInitializeContext(incContext, points, windowSize, seed);
+        auto rebuildStart = currentTimeNano();
+        incConstructFullHull(incContext);
+        auto rebuildTime = currentTimeNano() - rebuildStart;
+        incFreeContext(incContext);
+        
+        for (auto stepSize : stepSizes)
+        {
+            DynamicHull<S> hull = {};
+            dynamicInitialize(hull, points, windowSize, seed);
+            // the ids of the window, oldest first
+            std::deque<int> window;
+            for (int i = 0; i < windowSize; i++)
+            {
+                window.push_back(i);
+            }
+            std::vector<int> ids((size_t)stepSize);
+            
+            auto steps = streamed / stepSize;
+            auto start = currentTimeNano();
+            for (int step = 0; step < steps; step++)
+            {
+                for (int i = 0; i < stepSize; i++)
+                {
+                    ids[i] = window.front();
+                    window.pop_front();
+                }
+                dynamicRemove(hull, ids.data(), stepSize);
+                dynamicInsert(hull, points + windowSize + step * stepSize, stepSize, ids.data());
+                window.insert(window.end(), ids.begin(), ids.end());
+            }
+            auto stepTime = (currentTimeNano() - start) / (double)steps;
+            
+            log_a("Sliding window (%s) %s: %d points, steps of %d: %.3f ms per step, rebuild %.2f ms, %d faces, %d rebuilds%s\n",
+                  scalarName, GetGeneratorTypeString(genType), windowSize, stepSize, stepTime / 1e6, rebuildTime / 1e6,
+                  hull.incContext.processingState.facesOnHull, hull.rebuilds - 1, hull.incContext.failed ? ", failed" : "");
+            dynamicFree(hull);
+        }
+        free(points);
+    }
+}
+
+#endif
@@ -5,9 +5,13 @@ enum HullType
 {
     QH,
     Inc,
-    Dac
+    Dac,
+    // one of the above, picked from a sample of the input, see SelectHullType
+    Auto
 };
 
+static const char *hullTypeNames[] = {"QuickHull", "incremental", "D&C", "auto"};
+
 struct Vertex;
 
 struct Timer
@@ -17,34 +21,157 @@ struct Timer
     bool running;
 };
 
+// What the Auto hull type knows about a point set. Measured on a small sample,
+// so it costs about as much as hulling that sample.
+struct InputFeatures
+{
+    int numberOfPoints;
+    // share of the sample that is a vertex of the sample's hull
+    float hullFraction;
+    // no two points share an x coordinate, which D&C needs. Only checked once
+    // D&C is picked, as it takes sorting all points
+    bool distinctX;
+};
+
+#define AUTO_SAMPLE_SIZE 256
+// how far a calibrated hull fraction threshold stays from the measured ones
+#define AUTO_FRACTION_MARGIN 0.1f
+
+// Buffers reused by MeasureInputFeatures
+struct FeatureContext
+{
+    DacContext<double> dacContext;
+    QhContext<double> qhContext;
+};
+
+// The interactive hulls are rendered, so they stay in float like the meshes
 struct Hull
 {
     Vertex *vertices;
     int numberOfPoints;
     
-    QhContext qhContext;
-    QhContext stepQhContext;
-    QhContext timedStepQhContext;
+    QhContext<float> qhContext;
+    QhContext<float> stepQhContext;
+    QhContext<float> timedStepQhContext;
     
     Timer qhTimer;
     
-    IncContext incContext;
-    IncContext stepIncContext;
-    IncContext timedStepIncContext;
+    IncContext<float> incContext;
+    IncContext<float> stepIncContext;
+    IncContext<float> timedStepIncContext;
     
     Timer incTimer;
     
-    DacContext dacContext;
-    DacContext stepDacContext;
-    DacContext timedStepDacContext;
+    DacContext<float> dacContext;
+    DacContext<float> stepDacContext;
+    DacContext<float> timedStepDacContext;
     
     Timer dacTimer;
     
     HullType currentHullType;
     
+    // what Auto resolved to for the current points
+    AutoSelectConfig autoSelect;
+    FeatureContext featureContext;
+    HullType autoHullType;
+    bool autoResolved;
+    
     PointGenerator pointGenerator;
 };
 
+static InputFeatures MeasureInputFeatures(FeatureContext &context, Vertex *vertices, int numberOfPoints, unsigned long long seed)
+{
+    InputFeatures features = {};
+    features.numberOfPoints = numberOfPoints;
+    features.distinctX = true;
+    auto m = Min(numberOfPoints, AUTO_SAMPLE_SIZE);
+    if (m < 4)
+    {
+        return features;
+    }
+    
+    // evenly spaced from a random start, so the picks are distinct and cover sorted input too
+    Vertex sample[AUTO_SAMPLE_SIZE];
+    std::mt19937_64 gen{seed};
+    auto start = gen() % (unsigned long long)numberOfPoints;
+    for (int i = 0; i < m; i++)
+    {
+        sample[i] = vertices[(start + (unsigned long long)i * numberOfPoints / m) % numberOfPoints];
+    }
+    
+    // D&C is the cheapest on small sets, as long as no two x coordinates are equal
+    auto verticesOnHull = 0;
+    auto &dacContext = context.dacContext;
+    dacInitializeContext(dacContext, sample, m);
+    if (dacHasDistinctX(dacContext))
+    {
+        dacConstructFullHull(dacContext);
+        bool onHull[AUTO_SAMPLE_SIZE] = {};
+        for (auto &f : dacContext.faces)
+        {
+            for (int i = 0; i < 3; i++)
+            {
+                verticesOnHull += onHull[f.vertex[i].vIndex] ? 0 : 1;
+                onHull[f.vertex[i].vIndex] = true;
+            }
+        }
+    }
+    else
+    {
+        auto &qhContext = context.qhContext;
+        qhInitializeContext(qhContext, sample, m);
+        qhFullHull(qhContext);
+        qhContext.initialized = false;
+        verticesOnHull = qhContext.qHull.failed ? 0 : qhContext.qHull.processingState.verticesInHull;
+    }
+    dacContext.initialized = false;
+    features.hullFraction = (float)verticesOnHull / (float)m;
+    
+    return features;
+}
+
+// Hull-heavy input goes to D&C and the rest by size. Incremental only if the
+// config asks for it, or for hull-heavy input D&C can't take. How clustered or
+// flat the points are was measured too, but QuickHull was the fastest on every
+// mostly interior input from 2048 points up either way, so it isn't asked.
+static HullType SelectHullType(const AutoSelectConfig &config, const InputFeatures &features)
+{
+    if (features.numberOfPoints < config.incrementalBelow)
+    {
+        return Inc;
+    }
+    if (features.hullFraction >= config.dacHullFraction)
+    {
+        return features.distinctX ? Dac : Inc;
+    }
+    return features.numberOfPoints < config.dacBelow && features.distinctX ? Dac : QH;
+}
+
+// The algorithm the hull is built with. Auto is resolved once per point set.
+static HullType ResolveHullType(Hull &h)
+{
+    if (h.currentHullType != Auto)
+    {
+        return h.currentHullType;
+    }
+    
+    if (!h.autoResolved)
+    {
+        auto features = MeasureInputFeatures(h.featureContext, h.vertices, h.numberOfPoints, h.pointGenerator.seed);
+        h.autoHullType = SelectHullType(h.autoSelect, features);
+        if (h.autoHullType == Dac)
+        {
+            // the full hull reuses the sorted points
+            dacInitializeContext(h.dacContext, h.vertices, h.numberOfPoints);
+            features.distinctX = dacHasDistinctX(h.dacContext);
+            h.autoHullType = SelectHullType(h.autoSelect, features);
+        }
+        h.autoResolved = true;
+        log_a("Auto: hull fraction %.2f, picked %s\n", features.hullFraction, hullTypeNames[h.autoHullType]);
+    }
+    return h.autoHullType;
+}
+
 const char *GetGeneratorTypeString(GeneratorType type)
 {
     
@@ -83,23 +210,118 @@ const char *GetGeneratorTypeString(GeneratorType type)
     }
 }
 
-void WriteHullToCSV(const char *filename, int facesAdded, int totalFaceCount, int vertexCount, int pointsProcessed, unsigned long long distanceQueryCount, unsigned long long sidednessQueries, int verticesInHull, unsigned long long nstimeSpent, GeneratorType generateType)
+// Appends to the first of name.csv, name_2.csv, ... that is new or starts with
+// exactly this header, so rows never end up under columns they don't match.
+// Files written by older versions or with other columns are left as they are.
+static FILE *OpenHullCSV(const char *filename, const char *header)
 {
-    char *fullFilename = concat(filename, ".csv");
-    
-    auto fileExists = FileExists(fullFilename);
+    char path[256];
+    char firstLine[4096];
+    for (int version = 1; version < 100; version++)
+    {
+        if (version == 1)
+        {
+            snprintf(path, sizeof(path), "%s.csv", filename);
+        }
+        else
+        {
+            snprintf(path, sizeof(path), "%s_%d.csv", filename, version);
+        }
+        
+        if (!FileExists(path))
+        {
+            FILE *f = fopen(path, "w");
+            if (f)
+            {
+                fprintf(f, "%s\n", header);
+            }
+            return f;
+        }
+        
+        FILE *f = fopen(path, "r");
+        if (!f)
+        {
+            continue;
+        }
+        auto matches = fgets(firstLine, sizeof(firstLine), f) != nullptr;
+        fclose(f);
+        if (matches)
+        {
+            firstLine[strcspn(firstLine, "\r\n")] = '\0';
+            matches = strcmp(firstLine, header) == 0;
+        }
+        if (matches)
+        {
+            return fopen(path, "a");
+        }
+    }
+    return nullptr;
+}
+
+// The columns only depend on the engine (its phases, and merge levels for D&C),
+// each engine has its own file. Counters that weren't read are written as -1.
+void WriteHullToCSV(const char *filename, HullBenchResult &result)
+{
+    char header[4096];
+    auto length = snprintf(header, sizeof(header), "input vertices, faces added, faces in hull, points processed, distance queries, sidednessQueries, vertices in hull, time spent, point distribution, seed, "
+                           "runs, warmup runs, failed runs, hull ns min, hull ns median, hull ns p95, hull ns mean, hull ns stddev, setup ns median, setup ns mean, points per second, "
+                           "allocations mean, reallocations mean, frees mean, bytes allocated mean, peak live bytes mean, peak live bytes max, exact predicates mean, coordinate type, point order, memory policy");
+    for (int phase = 0; phase < result.phaseCount; phase++)
+    {
+        length += snprintf(header + length, sizeof(header) - length, ", %s ns mean", result.phaseNames[phase]);
+    }
+    if (result.hasMergeLevels)
+    {
+        length += snprintf(header + length, sizeof(header) - length, ", merge levels ns mean");
+    }
+    for (int counter = 0; counter < PerfCounter_Count; counter++)
+    {
+        length += snprintf(header + length, sizeof(header) - length, ", %s mean", perfCounterNames[counter]);
+    }
+    snprintf(header + length, sizeof(header) - length, ", instructions per cycle");
     
-    FILE *f = fopen(fullFilename, "a+");
-    free(fullFilename);
+    FILE *f = OpenHullCSV(filename, header);
     
     if (f)
     {
-        if (!fileExists)
+        auto hullTime = hullTimeStats(result);
+        auto setupTime = setupTimeStats(result);
+        auto pointsPerSecond = hullTime.median > 0.0 ? (double)result.vertexCount / (hullTime.median * 1e-9) : 0.0;
+        
+        // time spent stays the mean in microseconds to match the older data files
+        fprintf(f, "%d, %.1f, %.1f, %.1f, %.1f, %.1f, %.1f, %.1f, %s, %llu, %zu, %d, %d, %.0f, %.0f, %.0f, %.0f, %.0f, %.0f, %.0f, %.0f, %.0f, %.0f, %.0f, %.0f, %.0f, %lld, %.1f, %s, %s, %s",
+                result.vertexCount, sampleMean(result, &HullRunSample::addedFaces), sampleMean(result, &HullRunSample::facesOnHull), sampleMean(result, &HullRunSample::pointsProcessed),
+                sampleMean(result, &HullRunSample::distanceQueries), sampleMean(result, &HullRunSample::sidednessQueries), sampleMean(result, &HullRunSample::verticesOnHull),
+                hullTime.mean / 1000.0, GetGeneratorTypeString(result.genType), result.seed,
+                result.samples.size, result.warmupRuns, result.failedRuns,
+                hullTime.min, hullTime.median, hullTime.p95, hullTime.mean, hullTime.stddev, setupTime.median, setupTime.mean, pointsPerSecond,
+                memoryMean(result, &MemoryStats::allocations), memoryMean(result, &MemoryStats::reallocations), memoryMean(result, &MemoryStats::frees),
+                memoryMean(result, &MemoryStats::bytesAllocated), memoryMean(result, &MemoryStats::peakLiveBytes), maxPeakLiveBytes(result),
+                sampleMean(result, &HullRunSample::exactPredicates), result.scalarName, spatialOrderNames[result.spatialOrder], memoryPolicyNames[result.memoryPolicy]);
+        // the trailing newline is written after the phase columns
+        for (int phase = 0; phase < result.phaseCount; phase++)
         {
-            fprintf(f, "input vertices, faces added, faces in hull, points processed, distance queries, sidednessQueries, vertices in hull, time spent, point distribution\n");
+            fprintf(f, ", %.0f", phaseMean(result, phase));
         }
-        
-        fprintf(f, "%d, %d, %d, %d, %lld, %lld, %d, %lld, %s\n", vertexCount, facesAdded, totalFaceCount, pointsProcessed, distanceQueryCount, sidednessQueries, verticesInHull, nstimeSpent, GetGeneratorTypeString(generateType));
+        if (result.hasMergeLevels)
+        {
+            // one space separated value per merge level, smallest hulls first
+            auto levels = result.samples.size > 0 ? result.samples[0].mergeLevels : 0;
+            fprintf(f, ",");
+            for (int level = 0; level < Min(levels, DAC_MAX_MERGE_LEVELS); level++)
+            {
+                fprintf(f, " %.0f", mergeLevelMean(result, level));
+            }
+        }
+        // -1 marks a counter that was off or that this machine could not provide
+        for (int counter = 0; counter < PerfCounter_Count; counter++)
+        {
+            fprintf(f, ", %.0f", perfCounterMean(result, counter));
+        }
+        auto cycles = perfCounterMean(result, PerfCounter_Cycles);
+        auto instructions = perfCounterMean(result, PerfCounter_Instructions);
+        fprintf(f, ", %.3f", cycles > 0.0 && instructions >= 0.0 ? instructions / cycles : -1.0);
+        fprintf(f, "\n");
         fclose(f);
     }
 }
@@ -125,6 +347,7 @@ static void InitializeHull(Hull &h, Vertex *vertices, int numberOfPoints, HullTy
     h.dacTimer.timerInit = 0.2;
     h.dacTimer.currentTime = h.dacTimer.timerInit;
     h.currentHullType = hullType;
+    h.autoResolved = false;
 }
 
 static void reinitializeHull(Hull &h, Vertex *vertices, int numberOfPoints)
@@ -138,13 +361,14 @@ static void reinitializeHull(Hull &h, Vertex *vertices, int numberOfPoints)
     h.dacContext.initialized = false;
     
     h.incContext.initialized = false;
+    h.autoResolved = false;
 }
 
 static Mesh *UpdateHull(RenderContext &renderContext, Hull &h, HullType hullType, double deltaTime)
 {
     h.currentHullType = hullType;
     
-    switch (h.currentHullType)
+    switch (ResolveHullType(h))
     {
         case QH:
         {
@@ -175,7 +399,7 @@ static Mesh *UpdateHull(RenderContext &renderContext, Hull &h, HullType hullType
                 {
                     if (init)
                     {
-                        incInitStepHull();
+                        incInitStepHull(incContext);
                         init = false;
                     }
                     else
@@ -216,236 +440,795 @@ static Mesh *UpdateHull(RenderContext &renderContext, Hull &h, HullType hullType
     return nullptr;
 }
 
-static void RunFullHullTestQh(TestSet &testSet, glm::vec3 offset)
+// P is the input point type, Vertex or PrecisePoint
+template <typename S, typename P = Vertex>
+struct BenchContexts
 {
-    auto vertexAmounts = testSet.testSet;
-    auto genType = testSet.genType;
+    QhContext<S> qhContext;
+    IncContext<S> incContext;
+    DacContext<S> dacContext;
     
-    Vertex *vertices = nullptr;
+    // only read if opened
+    PerfCounters perfCounters;
     
-    auto seed = time(NULL);
-    PointGenerator generator;
-    std::random_device rd{};
-    std::mt19937_64 gen{rd()};
-    gen.seed((unsigned int)seed);
-    generator.gen = gen;
+    // the points are sorted along this curve before each run
+    SpatialOrderCurve spatialOrder;
+    SpatialOrder<P> order;
+};
+
+// Input points of the full hull tests, the double runs get double input so
+// they do not hull the float rounding of the generated points
+template <typename S>
+struct BenchPoint
+{
+    using type = Vertex;
+};
+
+template <>
+struct BenchPoint<double>
+{
+    using type = PrecisePoint;
+};
+
+// Runs one hull over the given points, timing the context setup (curve order,
+// copying, shuffling, sorting) separately from the hull construction itself.
+// Returns false if the algorithm reported a failure.
+template <typename S, typename P>
+static bool RunHullOnce(BenchContexts<S, P> &contexts, HullType hullType, P *vertices, int n, unsigned long long seed, HullRunSample &sample)
+{
+    sample = {};
+    for (int i = 0; i < PerfCounter_Count; i++)
+    {
+        sample.perf.values[i] = -1;
+    }
     
-    QhContext qhContext = {};
+    time_long orderTime = 0;
+    if (contexts.spatialOrder != SpatialOrder_None)
+    {
+        auto orderStart = currentTimeNano();
+        spatialOrderBuild(contexts.order, vertices, n, contexts.spatialOrder);
+        vertices = contexts.order.points.data();
+        orderTime = currentTimeNano() - orderStart;
+    }
     
-    log_a("Count: %zd\n", testSet.count);
-    for (size_t i = 0; i < testSet.count; i++)
+    switch (hullType)
     {
-        int addedFaces = 0;
-        int numFaces = 0;
-        int pointsProcessed = 0;
-        unsigned long long distanceQueries = 0;
-        unsigned long long sidednessQueries = 0;
-        int verticesOnHull = 0;
-        unsigned long long timeSpent = 0;
-        
-        int numForAvg = Max(1, testSet.iterations);
-        auto n = vertexAmounts[i];
-        
-        log_a("Num: %d\n", n);
-        initPointGenerator(generator, genType, n, 0.0, 5000.0);
-        
-        for (int j = 0; j < numForAvg; j++)
+        case QH:
         {
-            log_a("%d \n", j);
-            
-            vertices = generate(generator, offset);
-            
+            auto &qhContext = contexts.qhContext;
+            memoryBeginRun();
+            predicateExactCount = 0;
+            auto setupStart = currentTimeNano();
             qhInitializeContext(qhContext, vertices, n);
-            auto timerIndex = startTimer();
+            if (contexts.perfCounters.opened)
+            {
+                perfStart(contexts.perfCounters);
+            }
+            auto hullStart = currentTimeNano();
             qhFullHull(qhContext);
-            qhContext.qHull.processingState.timeSpent = endTimer(timerIndex);
+            auto hullEnd = currentTimeNano();
+            if (contexts.perfCounters.opened)
+            {
+                perfStop(contexts.perfCounters, sample.perf);
+            }
             
             qhContext.initialized = false;
+            qhContext.qHull.processingState.timeSpent = hullEnd - hullStart;
+            sample.memory = memoryGetStats();
+            sample.exactPredicates = predicateExactCount;
             if (qhContext.qHull.failed)
             {
-                free(vertices);
-                j--;
-                continue;
+                return false;
             }
             
-            addedFaces += qhContext.qHull.processingState.addedFaces;
-            numFaces += (int)qhContext.qHull.faces.size;
-            pointsProcessed += qhContext.qHull.processingState.pointsProcessed;
-            distanceQueries += qhContext.qHull.processingState.distanceQueryCount;
-            sidednessQueries += qhContext.qHull.processingState.sidednessQueries;
-            verticesOnHull += qhContext.qHull.processingState.verticesInHull;
-            timeSpent += qhContext.qHull.processingState.timeSpent;
+            sample.setupTime = hullStart - setupStart;
+            sample.hullTime = hullEnd - hullStart;
+            sample.addedFaces = qhContext.qHull.processingState.addedFaces;
+            sample.facesOnHull = (int)qhContext.qHull.faces.size;
+            sample.pointsProcessed = qhContext.qHull.processingState.pointsProcessed;
+            sample.distanceQueries = qhContext.qHull.processingState.distanceQueryCount;
+            sample.sidednessQueries = qhContext.qHull.processingState.sidednessQueries;
+            sample.verticesOnHull = qhContext.qHull.processingState.verticesInHull;
+            sample.phases = qhContext.qHull.processingState.phases;
+        }
+        break;
+        case Inc:
+        {
+            auto &incContext = contexts.incContext;
+            memoryBeginRun();
+            predicateExactCount = 0;
+            auto setupStart = currentTimeNano();
+            incInitializeContext(incContext, vertices, n, seed);
+            if (contexts.perfCounters.opened)
+            {
+                perfStart(contexts.perfCounters);
+            }
+            auto hullStart = currentTimeNano();
+            incConstructFullHull(incContext);
+            auto hullEnd = currentTimeNano();
+            if (contexts.perfCounters.opened)
+            {
+                perfStop(contexts.perfCounters, sample.perf);
+            }
+            
+            incContext.initialized = false;
+            incContext.processingState.timeSpent = hullEnd - hullStart;
+            sample.memory = memoryGetStats();
+            sample.exactPredicates = predicateExactCount;
+            if (incContext.failed)
+            {
+                incContext.failed = false;
+                return false;
+            }
+            
+            sample.setupTime = hullStart - setupStart;
+            sample.hullTime = hullEnd - hullStart;
+            sample.addedFaces = incContext.processingState.createdFaces;
+            sample.facesOnHull = incContext.processingState.facesOnHull;
+            sample.pointsProcessed = incContext.processingState.processedVertices;
+            sample.sidednessQueries = incContext.processingState.sidednessQueries;
+            sample.verticesOnHull = incContext.processingState.verticesOnHull;
+            sample.phases = incContext.processingState.phases;
+        }
+        break;
+        case Dac:
+        {
+            auto &dacContext = contexts.dacContext;
+            memoryBeginRun();
+            predicateExactCount = 0;
+            auto setupStart = currentTimeNano();
+            dacInitializeContext(dacContext, vertices, n);
+            if (contexts.perfCounters.opened)
+            {
+                perfStart(contexts.perfCounters);
+            }
+            auto hullStart = currentTimeNano();
+            dacConstructFullHull(dacContext);
+            auto hullEnd = currentTimeNano();
+            if (contexts.perfCounters.opened)
+            {
+                perfStop(contexts.perfCounters, sample.perf);
+            }
+            
+            dacContext.initialized = false;
+            dacContext.processingState.timeSpent = hullEnd - hullStart;
+            sample.memory = memoryGetStats();
+            sample.exactPredicates = predicateExactCount;
+            
+            sample.setupTime = hullStart - setupStart;
+            sample.hullTime = hullEnd - hullStart;
+            sample.addedFaces = dacContext.processingState.createdFaces;
+            sample.facesOnHull = dacContext.processingState.facesOnHull;
+            sample.pointsProcessed = dacContext.processingState.processedVertices;
+            sample.sidednessQueries = dacContext.processingState.sidednessQueries;
+            sample.verticesOnHull = dacContext.processingState.verticesOnHull;
+            sample.phases = dacContext.processingState.phases;
+            memcpy(sample.mergeLevelTimes, dacContext.processingState.mergeLevelTimes, sizeof(sample.mergeLevelTimes));
+            sample.mergeLevels = dacContext.processingState.mergeLevels;
+        }
+        break;
+        default:
+        {
+            // Auto has to be resolved to an algorithm first
+            return false;
         }
-        
-        WriteHullToCSV("../data/qh_hull_out", addedFaces / numForAvg, numFaces / numForAvg, n, pointsProcessed / numForAvg, distanceQueries / numForAvg, sidednessQueries / numForAvg, verticesOnHull / numForAvg, timeSpent / numForAvg, genType);
-        
-        addedFaces = 0;
-        numFaces = 0;
-        pointsProcessed = 0;
-        distanceQueries = 0;
-        sidednessQueries = 0;
-        verticesOnHull = 0;
-        timeSpent = 0;
     }
-    log_a("Done QH\n");
+    sample.setupTime += orderTime;
+    return true;
 }
 
-static void RunFullHullTestInc(TestSet &testSet, glm::vec3 offset)
+static void SetPhaseNames(HullBenchResult &result, HullType hullType)
+{
+    switch (hullType)
+    {
+        case QH:
+        {
+            result.phaseNames = qhPhaseNames;
+            result.phaseCount = QhPhase_Count;
+        }
+        break;
+        case Inc:
+        {
+            result.phaseNames = incPhaseNames;
+            result.phaseCount = IncPhase_Count;
+        }
+        break;
+        case Dac:
+        {
+            result.phaseNames = dacPhaseNames;
+            result.phaseCount = DacPhase_Count;
+            result.hasMergeLevels = true;
+        }
+        break;
+        default:
+        break;
+    }
+}
+
+static const char *GetHullOutputFile(HullType hullType)
+{
+    switch (hullType)
+    {
+        case QH:
+        {
+            return "../data/qh_hull_out";
+        }
+        break;
+        case Inc:
+        {
+            return "../data/inc_hull_out";
+        }
+        break;
+        case Dac:
+        {
+            return "../data/dac_hull_out";
+        }
+        break;
+        default:
+        break;
+    }
+    return "../data/hull_out";
+}
+
+// For every size in the test set: do the warmup runs, then record one sample
+// per iteration on freshly generated points and write the statistics to the CSV.
+// Failed runs are retried on new points and counted.
+template <typename S>
+static void RunFullHullTest(TestSet &testSet, glm::vec3 offset, HullType hullType, const char *scalarName)
 {
     auto vertexAmounts = testSet.testSet;
     auto genType = testSet.genType;
     
-    Vertex *vertices = nullptr;
-    
-    auto seed = time(NULL);
-    PointGenerator generator;
-    std::random_device rd{};
-    std::mt19937_64 gen{rd()};
-    gen.seed((unsigned int)seed);
-    generator.gen = gen;
+    PointGenerator generator = {};
+    generator.seed = testSet.seed;
     
-    IncContext incContext = {};
+    using Point = typename BenchPoint<S>::type;
+    BenchContexts<S, Point> contexts = {};
+    if (testSet.perfCounters)
+    {
+        perfOpen(contexts.perfCounters);
+    }
+    contexts.spatialOrder = testSet.spatialOrder;
+    auto previousMemoryPolicy = memoryPolicy;
+    memoryPolicy = testSet.memoryPolicy;
     
     log_a("Count: %zd\n", testSet.count);
     for (size_t i = 0; i < testSet.count; i++)
     {
-        int addedFaces = 0;
-        int numFaces = 0;
-        int pointsProcessed = 0;
-        unsigned long long sidednessQueries = 0;
-        int verticesOnHull = 0;
-        unsigned long long timeSpent = 0;
-        
-        int numForAvg = Max(1, testSet.iterations);
         auto n = vertexAmounts[i];
+        auto runs = Max(1, testSet.iterations);
+        auto warmupRuns = Max(0, testSet.warmup);
+        
+        HullBenchResult result = {};
+        result.vertexCount = n;
+        result.genType = genType;
+        result.seed = testSet.seed;
+        result.warmupRuns = warmupRuns;
+        result.scalarName = scalarName;
+        result.spatialOrder = testSet.spatialOrder;
+        result.memoryPolicy = testSet.memoryPolicy;
+        SetPhaseNames(result, hullType);
+        init(result.samples, (size_t)runs);
         
         log_a("Num: %d\n", n);
         initPointGenerator(generator, genType, n, 0.0, 5000.0);
         
-        for (int j = 0; j < numForAvg; j++)
+        int run = 0;
+        while (run < warmupRuns + runs)
         {
-            log_a("%d \n", j);
+            log_a("%d \n", run);
             
-            vertices = generate(generator, offset);
+            auto vertices = generate<Point>(generator, offset);
             
-            incInitializeContext(incContext, vertices, n);
-            auto timerIndex = startTimer();
-            incConstructFullHull(incContext);
-            incContext.processingState.timeSpent = endTimer(timerIndex);
+            HullRunSample sample;
+            auto succeeded = RunHullOnce(contexts, hullType, vertices, n, testSet.seed + (unsigned long long)run, sample);
+            free(vertices);
             
-            incContext.initialized = false;
-            if (incContext.failed)
+            if (!succeeded)
             {
-                free(vertices);
-                j--;
-                incContext.failed = false;
+                result.failedRuns++;
+                if (result.failedRuns > MAX_FAILED_RUNS_PER_RUN * (warmupRuns + runs))
+                {
+                    log_a("Giving up on %d points after %d failed runs\n", n, result.failedRuns);
+                    break;
+                }
                 continue;
             }
             
-            addedFaces += incContext.processingState.createdFaces;
-            pointsProcessed += incContext.processingState.processedVertices;
-            sidednessQueries += incContext.processingState.sidednessQueries;
-            verticesOnHull += incContext.processingState.verticesOnHull;
-            numFaces += incContext.processingState.facesOnHull;
-            timeSpent += incContext.processingState.timeSpent;
+            if (run >= warmupRuns)
+            {
+                addToList(result.samples, sample);
+            }
+            run++;
         }
         
-        WriteHullToCSV("../data/inc_hull_out", addedFaces / numForAvg, numFaces / numForAvg, n, pointsProcessed / numForAvg, 0, sidednessQueries / numForAvg, verticesOnHull / numForAvg, timeSpent / numForAvg, genType);
+        if (result.failedRuns > 0)
+        {
+            log_a("%d failed runs retried on new points\n", result.failedRuns);
+        }
         
-        addedFaces = 0;
-        numFaces = 0;
-        pointsProcessed = 0;
-        sidednessQueries = 0;
-        verticesOnHull = 0;
-        timeSpent = 0;
+        WriteHullToCSV(GetHullOutputFile(hullType), result);
+        clear(result.samples);
     }
+    
+    qhFreeContext(contexts.qhContext);
+    incFreeContext(contexts.incContext);
+    dacFreeContext(contexts.dacContext);
+    spatialOrderFree(contexts.order);
+    perfClose(contexts.perfCounters);
+    memoryPolicy = previousMemoryPolicy;
+}
+
+// Runs the test set once per coordinate type it asks for, all into the same CSV
+static void RunFullHullTest(TestSet &testSet, glm::vec3 offset, HullType hullType)
+{
+    if (testSet.scalars & Scalar_Float)
+    {
+        RunFullHullTest<float>(testSet, offset, hullType, "float");
+    }
+    if (testSet.scalars & Scalar_Double)
+    {
+        RunFullHullTest<double>(testSet, offset, hullType, "double");
+    }
+}
+
+static void RunFullHullTestQh(TestSet &testSet, glm::vec3 offset)
+{
+    RunFullHullTest(testSet, offset, HullType::QH);
+    log_a("Done QH\n");
+}
+
+static void RunFullHullTestInc(TestSet &testSet, glm::vec3 offset)
+{
+    RunFullHullTest(testSet, offset, HullType::Inc);
     log_a("Done inc\n");
 }
 
 static void RunFullHullTestDac(TestSet &testSet, glm::vec3 offset)
 {
-    auto vertexAmounts = testSet.testSet;
-    auto genType = testSet.genType;
-    
-    Vertex *vertices = nullptr;
-    
-    auto seed = time(NULL);
-    PointGenerator generator;
-    std::random_device rd{};
-    std::mt19937_64 gen{rd()};
-    gen.seed((unsigned int)seed);
-    generator.gen = gen;
+    RunFullHullTest(testSet, offset, HullType::Dac);
+    log_a("Done dac\n");
+}
+
+// Runs QuickHull once per scheduling and assignment mode on every distribution,
+// with the faces added and the time each mode took
+template <typename S>
+static void RunSchedulingBenchmark(glm::vec3 offset, unsigned long long seed, const char *scalarName)
+{
+    const int repetitions = 3;
+    // points on a sphere all end up on the hull, so they get fewer
+    struct
+    {
+        GeneratorType genType;
+        int pointCount;
+    } cases[] = {{InSphere, 1000000}, {InCube, 1000000}, {Clusters, 1000000}, {ManyInternal, 1000000}, {OnSphere, 60000}};
+
+    QhContext<S> qhContext = {};
+    for (auto &c : cases)
+    {
+        PointGenerator generator = {};
+        generator.seed = seed;
+        initPointGenerator(generator, c.genType, c.pointCount, 0.0, 200.0);
+        auto points = generate(generator, offset);
+
+        for (int mode = 0; mode < QhScheduling_Count; mode++)
+        {
+            for (int assignment = 0; assignment < QhAssignment_Count; assignment++)
+            {
+                // the stack has nothing to defer
+                if (mode == QhScheduling_Stack && assignment == QhAssignment_Deferred)
+                {
+                    continue;
+                }
+                qhContext.qHull.scheduling = (QhScheduling)mode;
+                qhContext.qHull.assignment = (QhAssignment)assignment;
+                time_long best = ~0ull;
+                for (int r = 0; r < repetitions; r++)
+                {
+                    qhInitializeContext(qhContext, points, c.pointCount);
+                    auto start = currentTimeNano();
+                    qhFullHull(qhContext);
+                    best = Min(best, currentTimeNano() - start);
+                }
+
+                auto &state = qhContext.qHull.processingState;
+                log_a("QH scheduling (%s) %s, %s, %s: %d points, %d faces added, %zu on hull, %llu sidedness queries: %.2f ms%s\n",
+                      scalarName, GetGeneratorTypeString(c.genType), qhSchedulingNames[mode], qhAssignmentNames[assignment], c.pointCount,
+                      state.addedFaces, qhContext.qHull.faces.size, state.sidednessQueries, best / 1e6, qhContext.qHull.failed ? ", failed" : "");
+            }
+        }
+        free(points);
+    }
+    qhFreeContext(qhContext);
+}
+
+// Order independent checksum of a hull by input indices, the same for every
+// curve the points were sorted along as long as the faces are
+template <typename S>
+static unsigned long long HullChecksum(const HullResult<S> &result)
+{
+    unsigned long long sum = 0;
+    for (size_t i = 0; i + 2 < result.indices.size; i += 3)
+    {
+        // rotate the smallest index to the front, which keeps the orientation
+        int face[3] = {result.indices[i], result.indices[i + 1], result.indices[i + 2]};
+        auto first = face[0] < face[1] ? (face[0] < face[2] ? 0 : 2) : (face[1] < face[2] ? 1 : 2);
+        unsigned long long h = 1469598103934665603ull;
+        for (int j = 0; j < 3; j++)
+        {
+            h = (h ^ (unsigned long long)face[(first + j) % 3]) * 1099511628211ull;
+        }
+        sum += h;
+    }
+    return sum;
+}
+
+// Runs every algorithm on the points in input order and sorted along each curve,
+// with the time the sort took and the hull time. The checksum is taken after
+// mapping the result back to input indices and has to match across the orders,
+// except for D&C on points that share x coordinates, which it can't hull.
+template <typename S>
+static void RunSpatialOrderBenchmark(glm::vec3 offset, unsigned long long seed, const char *scalarName)
+{
+    const int repetitions = 3;
+    struct
+    {
+        GeneratorType genType;
+        int pointCount;
+    } cases[] = {{InSphere, 500000}, {Clusters, 500000}, {OnSphere, 100000}};
+
+    BenchContexts<S> contexts = {};
+    HullResult<S> result = {};
+    for (auto &c : cases)
+    {
+        PointGenerator generator = {};
+        generator.seed = seed;
+        initPointGenerator(generator, c.genType, c.pointCount, 0.0, 200.0);
+        auto points = generate(generator, offset);
+
+        for (int hullType = QH; hullType <= Dac; hullType++)
+        {
+            for (int curve = 0; curve < SpatialOrder_Count; curve++)
+            {
+                contexts.spatialOrder = (SpatialOrderCurve)curve;
+                time_long bestHull = ~0ull;
+                time_long bestSetup = ~0ull;
+                auto succeeded = true;
+                HullRunSample sample;
+                for (int r = 0; r < repetitions && succeeded; r++)
+                {
+                    succeeded = RunHullOnce(contexts, (HullType)hullType, points, c.pointCount, seed, sample);
+                    bestHull = Min(bestHull, sample.hullTime);
+                    bestSetup = Min(bestSetup, sample.setupTime);
+                }
+
+                unsigned long long checksum = 0;
+                auto validInput = hullType != Dac || dacHasDistinctX(contexts.dacContext);
+                if (succeeded)
+                {
+                    switch (hullType)
+                    {
+                        case QH:
+                        {
+                            qhExtractResult(contexts.qhContext, result, 0);
+                        }
+                        break;
+                        case Inc:
+                        {
+                            incExtractResult(contexts.incContext, result, 0);
+                        }
+                        break;
+                        case Dac:
+                        {
+                            dacExtractResult(contexts.dacContext, result, 0);
+                        }
+                        break;
+                    }
+                    if (curve != SpatialOrder_None)
+                    {
+                        spatialOrderRemap(contexts.order, result);
+                    }
+                    checksum = HullChecksum(result);
+                }
+
+                log_a("Point order (%s) %s, %s, %s order: %d points, %zu faces, checksum %016llx, setup %.2f ms, hull %.2f ms%s%s\n",
+                      scalarName, GetGeneratorTypeString(c.genType), hullTypeNames[hullType], spatialOrderNames[curve], c.pointCount,
+                      hullResultFaceCount(result), checksum, bestSetup / 1e6, bestHull / 1e6, succeeded ? "" : ", failed",
+                      validInput ? "" : ", x not distinct");
+            }
+        }
+        free(points);
+    }
+    hullResultFree(result);
+    qhFreeContext(contexts.qhContext);
+    incFreeContext(contexts.incContext);
+    dacFreeContext(contexts.dacContext);
+    spatialOrderFree(contexts.order);
+}
+
+// Runs QuickHull and D&C once per memory policy on large inputs, with the hull
+// time and the dTLB misses if the machine lets us count them. The incremental
+// hull allocates its vertices one by one, so it has no large buffers to place.
+template <typename S>
+static void RunMemoryPolicyBenchmark(glm::vec3 offset, unsigned long long seed, const char *scalarName)
+{
+    const int repetitions = 3;
+    struct
+    {
+        GeneratorType genType;
+        int pointCount;
+    } cases[] = {{InSphere, 4000000}, {OnSphere, 1000000}};
+
+    BenchContexts<S> contexts = {};
+    perfOpen(contexts.perfCounters);
+    auto previousMemoryPolicy = memoryPolicy;
+    for (auto &c : cases)
+    {
+        PointGenerator generator = {};
+        generator.seed = seed;
+        initPointGenerator(generator, c.genType, c.pointCount, 0.0, 200.0);
+        auto points = generate(generator, offset);
+
+        HullType hullTypes[] = {QH, Dac};
+        for (auto hullType : hullTypes)
+        {
+            for (int policy = 0; policy < MemoryPolicy_Count; policy++)
+            {
+                // the buffers of the last policy would be reused otherwise
+                qhFreeContext(contexts.qhContext);
+                dacFreeContext(contexts.dacContext);
+                memoryPolicy = policy;
+
+                time_long bestHull = ~0ull;
+                time_long bestSetup = ~0ull;
+                long long dtlbMisses = -1;
+                auto succeeded = true;
+                for (int r = 0; r < repetitions && succeeded; r++)
+                {
+                    HullRunSample sample;
+                    succeeded = RunHullOnce(contexts, hullType, points, c.pointCount, seed, sample);
+                    if (sample.hullTime < bestHull)
+                    {
+                        bestHull = sample.hullTime;
+                        dtlbMisses = sample.perf.values[PerfCounter_DTLBMisses];
+                    }
+                    bestSetup = Min(bestSetup, sample.setupTime);
+                }
+                auto validInput = hullType != Dac || dacHasDistinctX(contexts.dacContext);
+
+                log_a("Memory policy (%s) %s, %s, %s: %d points, setup %.2f ms, hull %.2f ms, %lld dTLB misses%s%s\n",
+                      scalarName, GetGeneratorTypeString(c.genType), hullTypeNames[hullType], memoryPolicyNames[policy], c.pointCount,
+                      bestSetup / 1e6, bestHull / 1e6, dtlbMisses, succeeded ? "" : ", failed", validInput ? "" : ", x not distinct");
+            }
+        }
+        free(points);
+    }
+    memoryPolicy = previousMemoryPolicy;
+    qhFreeContext(contexts.qhContext);
+    dacFreeContext(contexts.dacContext);
+    perfClose(contexts.perfCounters);
+}
+
+// One point set of the calibration run and what each algorithm took on it
+struct AutoCalibrationCase
+{
+    GeneratorType genType;
+    InputFeatures features;
+    // setup plus hull time in ns, indexed by HullType
+    double times[3];
+};
+
+// Time of the fastest algorithm that can be used on the case
+static double AutoCalibrationFastest(const AutoCalibrationCase &c)
+{
+    auto fastest = Min(c.times[QH], c.times[Inc]);
+    return c.features.distinctX ? Min(fastest, c.times[Dac]) : fastest;
+}
+
+// How much slower the picks of config are than the fastest algorithm, summed over
+// the cases. Relative, so the big point sets don't decide everything.
+static double AutoSelectCost(const AutoSelectConfig &config, List<AutoCalibrationCase> &cases)
+{
+    auto cost = 0.0;
+    for (auto &c : cases)
+    {
+        cost += c.times[SelectHullType(config, c.features)] / AutoCalibrationFastest(c);
+    }
+    return cost;
+}
+
+// Times all three algorithms on every generator at a range of sizes and picks
+// the thresholds under which Auto comes closest to always using the fastest one.
+// Every threshold can also end up switched off. The measurements go to
+// data/auto_calibration.csv, the thresholds to config and the file at path.
+static void CalibrateAutoSelect(glm::vec3 offset, unsigned long long seed, AutoSelectConfig &config, const char *path)
+{
+    static const int sizes[] = {512, 1024, 2048, 8192, 32768};
+    const int sizeCount = (int)(sizeof(sizes) / sizeof(sizes[0]));
     
-    DacContext dacContext = {};
+    BenchContexts<float> contexts = {};
+    FeatureContext featureContext = {};
+    List<AutoCalibrationCase> cases = {};
     
-    log_a("Count: %zd\n", testSet.count);
-    for (size_t i = 0; i < testSet.count; i++)
+    for (int type = GeneratorType::InSphere; type <= GeneratorType::Clusters; type++)
     {
-        int addedFaces = 0;
-        int numFaces = 0;
-        int pointsProcessed = 0;
-        unsigned long long sidednessQueries = 0;
-        int verticesOnHull = 0;
-        unsigned long long timeSpent = 0;
-        
-        int numForAvg = Max(1, testSet.iterations);
-        auto n = vertexAmounts[i];
-        
-        log_a("Num: %d\n", n);
-        initPointGenerator(generator, genType, n, 0.0, 5000.0);
-        
-        for (int j = 0; j < numForAvg; j++)
+        for (int s = 0; s < sizeCount; s++)
         {
-            log_a("%d \n", j);
+            auto n = sizes[s];
+            PointGenerator generator = {};
+            generator.seed = seed + (unsigned long long)(type * sizeCount + s);
+            initPointGenerator(generator, (GeneratorType)type, n, 0.0, 5000.0);
+            auto vertices = generate(generator, offset);
             
-            vertices = generate(generator, offset);
+            AutoCalibrationCase c = {};
+            c.genType = (GeneratorType)type;
+            c.features = MeasureInputFeatures(featureContext, vertices, n, generator.seed);
             
-            dacInitializeContext(dacContext, vertices, n);
-            auto timerIndex = startTimer();
-            dacConstructFullHull(dacContext);
-            dacContext.processingState.timeSpent = endTimer(timerIndex);
-            
-            dacContext.initialized = false;
+            // best of a few runs, the large sets only once
+            auto runs = n <= 8192 ? 3 : 1;
+            for (int hullType = QH; hullType <= Dac; hullType++)
+            {
+                c.times[hullType] = 1e30;
+                for (int run = 0; run < runs; run++)
+                {
+                    HullRunSample sample;
+                    if (RunHullOnce(contexts, (HullType)hullType, vertices, n, generator.seed, sample))
+                    {
+                        c.times[hullType] = Min(c.times[hullType], (double)(sample.setupTime + sample.hullTime));
+                    }
+                }
+            }
+            c.features.distinctX = dacHasDistinctX(contexts.dacContext);
+            free(vertices);
             
-            addedFaces += dacContext.processingState.createdFaces;
-            pointsProcessed += dacContext.processingState.processedVertices;
-            sidednessQueries += dacContext.processingState.sidednessQueries;
-            verticesOnHull += dacContext.processingState.verticesOnHull;
-            numFaces += dacContext.processingState.facesOnHull;
-            timeSpent += dacContext.processingState.timeSpent;
+            log_a("%s, %d points: hull fraction %.2f, QH %.0f ns, inc %.0f ns, D&C %.0f ns\n",
+                  GetGeneratorTypeString(c.genType), n, c.features.hullFraction, c.times[QH], c.times[Inc], c.times[Dac]);
+            addToList(cases, c);
         }
-        
-        WriteHullToCSV("../data/dac_hull_out", addedFaces / numForAvg, numFaces / numForAvg, n, pointsProcessed / numForAvg, 0, sidednessQueries / numForAvg, verticesOnHull / numForAvg, timeSpent / numForAvg, genType);
-        
-        addedFaces = 0;
-        numFaces = 0;
-        pointsProcessed = 0;
-        sidednessQueries = 0;
-        verticesOnHull = 0;
-        timeSpent = 0;
     }
-    log_a("Done dac\n");
+    
+    qhFreeContext(contexts.qhContext);
+    incFreeContext(contexts.incContext);
+    dacFreeContext(contexts.dacContext);
+    dacFreeContext(featureContext.dacContext);
+    qhFreeContext(featureContext.qhContext);
+    
+    // candidates are the measured sizes, plus one that switches the rule off
+    List<int> sizeCandidates = {};
+    addToList(sizeCandidates, 0);
+    for (int s = 0; s < sizeCount; s++)
+    {
+        addToList(sizeCandidates, sizes[s] + 1);
+    }
+    
+    // and halfway between neighbouring measured fractions, if that is at least
+    // AUTO_FRACTION_MARGIN away from both. The fraction of a 256 point sample
+    // varies by about 0.025 between point sets of the same kind, a threshold
+    // closer than that would only sort the noise of this run.
+    List<float> fractions = {};
+    List<float> fractionCandidates = {};
+    addToList(fractionCandidates, 2.0f);
+    for (auto &c : cases)
+    {
+        addToList(fractions, c.features.hullFraction);
+    }
+    std::sort(fractions.begin(), fractions.end());
+    for (size_t i = 1; i < fractions.size; i++)
+    {
+        if (fractions[i] - fractions[i - 1] >= 2 * AUTO_FRACTION_MARGIN)
+        {
+            addToList(fractionCandidates, (fractions[i - 1] + fractions[i]) / 2);
+        }
+    }
+    
+    // first the switched off rules, a rule is only taken if it strictly helps
+    AutoSelectConfig best = {};
+    best.incrementalBelow = 0;
+    best.dacHullFraction = 2.0f;
+    best.dacBelow = 0;
+    auto bestCost = AutoSelectCost(best, cases);
+    for (auto incrementalBelow : sizeCandidates)
+    {
+        for (auto dacBelow : sizeCandidates)
+        {
+            for (auto dacHullFraction : fractionCandidates)
+            {
+                AutoSelectConfig candidate = {};
+                candidate.incrementalBelow = incrementalBelow;
+                candidate.dacBelow = dacBelow;
+                candidate.dacHullFraction = dacHullFraction;
+                auto cost = AutoSelectCost(candidate, cases);
+                if (cost < bestCost)
+                {
+                    best = candidate;
+                    bestCost = cost;
+                }
+            }
+        }
+    }
+    
+    // a single algorithm for everything, for comparison. D&C falls back to QuickHull.
+    double fixedCosts[3] = {};
+    for (auto &c : cases)
+    {
+        auto fastest = AutoCalibrationFastest(c);
+        fixedCosts[QH] += c.times[QH] / fastest;
+        fixedCosts[Inc] += c.times[Inc] / fastest;
+        fixedCosts[Dac] += (c.features.distinctX ? c.times[Dac] : c.times[QH]) / fastest;
+    }
+    log_a("Auto is %.2fx slower than always picking the fastest algorithm, QuickHull alone %.2fx, incremental %.2fx, D&C %.2fx\n",
+          bestCost / cases.size, fixedCosts[QH] / cases.size, fixedCosts[Inc] / cases.size, fixedCosts[Dac] / cases.size);
+    
+    auto fileExists = FileExists("../data/auto_calibration.csv");
+    FILE *f = fopen("../data/auto_calibration.csv", "a+");
+    if (f)
+    {
+        if (!fileExists)
+        {
+            fprintf(f, "point distribution, input vertices, hull fraction, distinct x, qh ns, inc ns, dac ns, auto pick, seed\n");
+        }
+        for (auto &c : cases)
+        {
+            fprintf(f, "%s, %d, %.3f, %d, %.0f, %.0f, %.0f, %s, %llu\n", GetGeneratorTypeString(c.genType), c.features.numberOfPoints,
+                    c.features.hullFraction, c.features.distinctX ? 1 : 0, c.times[QH], c.times[Inc], c.times[Dac],
+                    hullTypeNames[SelectHullType(best, c.features)], seed);
+        }
+        fclose(f);
+    }
+    
+    config = best;
+    writeAutoSelectConfig(path, config);
+    log_a("Auto select thresholds written to %s\n", path);
+    
+    clear(sizeCandidates);
+    clear(fractions);
+    clear(fractionCandidates);
+    clear(cases);
 }
 
 static Mesh &FullHull(RenderContext &renderContext, Hull &h)
 {
-    switch (h.currentHullType)
+    switch (ResolveHullType(h))
     {
         case QH:
         {
             auto &qhContext = h.qhContext;
             if (!qhContext.initialized)
             {
+                // one large hull, the passes over every point may take all threads
+                qhContext.qHull.threadCount = hardwareThreadCount();
                 qhInitializeContext(qhContext, h.vertices, h.numberOfPoints);
             }
             
-            auto timerIndex = startTimer();
+            auto hullStart = currentTimeNano();
             qhFullHull(qhContext);
-            TIME_END(timerIndex, "Full quick hull");
+            qhContext.qHull.processingState.timeSpent = currentTimeNano() - hullStart;
+            log_a("Full quick hull took %lld ns\n", qhContext.qHull.processingState.timeSpent);
             qhContext.qHull.finished = true;
             
-            WriteHullToCSV("qh_hull_out", qhContext.qHull.processingState.addedFaces, (int)qhContext.qHull.faces.size, h.numberOfPoints, qhContext.qHull.processingState.pointsProcessed, qhContext.qHull.processingState.distanceQueryCount,
-                           qhContext.qHull.processingState.sidednessQueries, qhContext.qHull.processingState.verticesInHull, qhContext.qHull.processingState.timeSpent, h.pointGenerator.type);
+            HullRunSample sample = {};
+            for (int i = 0; i < PerfCounter_Count; i++)
+            {
+                sample.perf.values[i] = -1;
+            }
+            sample.hullTime = qhContext.qHull.processingState.timeSpent;
+            sample.addedFaces = qhContext.qHull.processingState.addedFaces;
+            sample.facesOnHull = (int)qhContext.qHull.faces.size;
+            sample.pointsProcessed = qhContext.qHull.processingState.pointsProcessed;
+            sample.distanceQueries = qhContext.qHull.processingState.distanceQueryCount;
+            sample.sidednessQueries = qhContext.qHull.processingState.sidednessQueries;
+            sample.verticesOnHull = qhContext.qHull.processingState.verticesInHull;
+            sample.phases = qhContext.qHull.processingState.phases;
+            
+            HullBenchResult result = {};
+            SetPhaseNames(result, QH);
+            result.vertexCount = h.numberOfPoints;
+            result.genType = h.pointGenerator.type;
+            result.seed = h.pointGenerator.seed;
+            result.scalarName = "float";
+            addToList(result.samples, sample);
+            WriteHullToCSV("qh_hull_out", result);
+            clear(result.samples);
             
             return qhConvertToMesh(renderContext, qhContext.qHull, h.vertices);
         }
@@ -455,7 +1238,7 @@ static Mesh &FullHull(RenderContext &renderContext, Hull &h)
             auto &incContext = h.incContext;
             if (!incContext.initialized)
             {
-                incInitializeContext(incContext, h.vertices, h.numberOfPoints);
+                incInitializeContext(incContext, h.vertices, h.numberOfPoints, h.pointGenerator.seed);
             }
             auto timerIndex = startTimer();
             incConstructFullHull(incContext);
@@ -483,7 +1266,7 @@ static Mesh &FullHull(RenderContext &renderContext, Hull &h)
 
 static Mesh &StepHull(RenderContext &renderContext, Hull &h)
 {
-    switch (h.currentHullType)
+    switch (ResolveHullType(h))
     {
         case QH:
         {
@@ -502,11 +1285,11 @@ static Mesh &StepHull(RenderContext &renderContext, Hull &h)
             auto &incContext = h.stepIncContext;
             if (!incContext.initialized)
             {
-                incInitializeContext(incContext, h.vertices, h.numberOfPoints);
+                incInitializeContext(incContext, h.vertices, h.numberOfPoints, h.pointGenerator.seed);
             }
             if (init)
             {
-                incInitStepHull();
+                incInitStepHull(incContext);
                 init = false;
             }
             else
@@ -537,7 +1320,7 @@ static Mesh &StepHull(RenderContext &renderContext, Hull &h)
 
 static Mesh &TimedStepHull(RenderContext &renderContext, Hull &h)
 {
-    switch (h.currentHullType)
+    switch (ResolveHullType(h))
     {
         case QH:
         {
@@ -556,7 +1339,7 @@ static Mesh &TimedStepHull(RenderContext &renderContext, Hull &h)
             auto &incContext = h.timedStepIncContext;
             if (!incContext.initialized)
             {
-                incInitializeContext(incContext, h.vertices, h.numberOfPoints);
+                incInitializeContext(incContext, h.vertices, h.numberOfPoints, h.pointGenerator.seed);
             }
             
             h.incTimer.running = !h.incTimer.running;
@@ -0,0 +1,999 @@
+#ifndef HULL_QUERY_H
+#define HULL_QUERY_H
+
+// Containment, signed distance and support queries against a finished hull,
+// built from the HullResult of any engine.
+//
+// The hull is star shaped around the mean of its vertices, so the ray from
+// there to a point p leaves the hull through exactly one face, and p is inside
+// if and only if it is behind that face's plane. Directions from the center are
+// binned in a cube map, and every cell lists the planes of the faces whose
+// central projection touches it. A containment test then picks the cell of p's
+// direction and checks p against the few planes in it: behind all of them means
+// behind the exit face, and in front of one means outside.
+//
+// Signed distances use the same cells. The faces of p's cell bound the
+// distance to the boundary, from the exit face's plane inside and from the
+// faces p is in front of outside. The closest boundary point is no further
+// than that from p and lies between the inner and the outer ball, which limits
+// the angle at the center between it and p, so only the cells in that cone
+// are checked. How wide the cone is depends on the gap between the two balls:
+// on a hull of 200k faces around a sphere it is a few hundred cells, and
+// queries run about 20x faster than a scan of every face. Hulls of a few
+// hundred faces are scanned anyway.
+
+template <typename S>
+struct HullQuery
+{
+    // mean of the hull's vertices, the cube map is centered on it
+    position_t<S> center;
+    // balls around center that are inside the hull and that hold the hull
+    S innerRadius;
+    S outerRadius;
+
+    // resolution x resolution cells on each of the 6 sides of the cube. The
+    // planes of cell i are cellPlanes[cellStart[i]] up to cellPlanes[cellStart[i + 1]],
+    // cellFaces holds the faces they belong to.
+    int resolution;
+    List<int> cellStart;
+    List<plane_t<S>> cellPlanes;
+    List<int> cellFaces;
+
+    // per face: the plane as dot(normal, p) - offset, and its corners
+    List<S> normalX;
+    List<S> normalY;
+    List<S> normalZ;
+    List<S> offset;
+    List<position_t<S>> corners;
+};
+
+// Below this many faces signed distances scan every face, which is faster
+// than finding the cells to check
+#define HULL_QUERY_SCAN_FACES 512
+
+// What one thread needs for signed distance queries, kept between queries so
+// the marks aren't cleared every time. Start it at {}.
+struct HullQueryScratch
+{
+    // faces whose entry is mark were checked by the current query
+    List<unsigned int> visited;
+    unsigned int mark;
+};
+
+// Side of the cube map a direction points to and where on it, in [-1, 1]
+template <typename S>
+static int hullQuerySide(const position_t<S> &d, S &u, S &v)
+{
+    auto ax = std::abs(d.x);
+    auto ay = std::abs(d.y);
+    auto az = std::abs(d.z);
+    int axis = ax >= ay && ax >= az ? 0 : (ay >= az ? 1 : 2);
+    auto major = d[axis];
+    if (major == 0)
+    {
+        u = v = 0;
+        return 0;
+    }
+    u = d[(axis + 1) % 3] / std::abs(major);
+    v = d[(axis + 2) % 3] / std::abs(major);
+    return axis * 2 + (major < 0 ? 1 : 0);
+}
+
+template <typename S>
+static int hullQueryCellCoordinate(const HullQuery<S> &query, S u)
+{
+    auto cell = (int)std::floor((u + 1) * (S)0.5 * (S)query.resolution);
+    return Min(Max(cell, 0), query.resolution - 1);
+}
+
+template <typename S>
+static int hullQueryCell(const HullQuery<S> &query, const position_t<S> &p)
+{
+    S u, v;
+    auto side = hullQuerySide(position_t<S>(p - query.center), u, v);
+    return (side * query.resolution + hullQueryCellCoordinate(query, v)) * query.resolution + hullQueryCellCoordinate(query, u);
+}
+
+// Clips the polygon to the directions of one side of the cube map, the pyramid
+// where the side's axis is the largest component. Returns the new vertex count.
+template <typename S>
+static int hullQueryClipToSide(position_t<S> *polygon, int count, int side)
+{
+    auto axis = side / 2;
+    S sign = side % 2 ? (S)-1 : (S)1;
+    position_t<S> clipped[8];
+    for (int plane = 0; plane < 4 && count > 0; plane++)
+    {
+        auto other = (axis + 1 + plane / 2) % 3;
+        S otherSign = plane % 2 ? (S)-1 : (S)1;
+        auto distance = [&](const position_t<S> &p) { return sign * p[axis] - otherSign * p[other]; };
+
+        int clippedCount = 0;
+        for (int i = 0; i < count; i++)
+        {
+            auto &a = polygon[i];
+            auto &b = polygon[(i + 1) % count];
+            auto da = distance(a);
+            auto db = distance(b);
+            if (da >= 0)
+            {
+                clipped[clippedCount++] = a;
+            }
+            if ((da >= 0) != (db >= 0))
+            {
+                clipped[clippedCount++] = a + (b - a) * (da / (da - db));
+            }
+        }
+        count = clippedCount;
+        for (int i = 0; i < count; i++)
+        {
+            polygon[i] = clipped[i];
+        }
+    }
+    return count;
+}
+
+// Grows [uMin, uMax] x [vMin, vMax] to hold the central projection of the
+// triangle onto one side of the cube map
+template <typename S>
+static void hullQueryAddToSideBounds(const HullQuery<S> &query, const position_t<S> *corners, int side, S &uMin, S &uMax, S &vMin, S &vMax)
+{
+    position_t<S> polygon[8] = {corners[0] - query.center, corners[1] - query.center, corners[2] - query.center};
+    auto count = hullQueryClipToSide(polygon, 3, side);
+    auto axis = side / 2;
+    for (int i = 0; i < count; i++)
+    {
+        auto major = std::abs(polygon[i][axis]);
+        if (major <= 0)
+        {
+            continue;
+        }
+        auto u = polygon[i][(axis + 1) % 3] / major;
+        auto v = polygon[i][(axis + 2) % 3] / major;
+        uMin = Min(uMin, u);
+        uMax = Max(uMax, u);
+        vMin = Min(vMin, v);
+        vMax = Max(vMax, v);
+    }
+}
+
+// Calls fn(cell) for the cells of one side in the bounds. The cell ranges are
+// widened a little, so rounding can't drop a face from the cell a query lands in.
+template <typename S, typename F>
+static void hullQueryForSideCells(const HullQuery<S> &query, int side, S uMin, S uMax, S vMin, S vMax, F fn)
+{
+    const S margin = (S)1e-3;
+    if (uMin > uMax)
+    {
+        return;
+    }
+
+    auto firstU = hullQueryCellCoordinate(query, uMin - margin);
+    auto lastU = hullQueryCellCoordinate(query, uMax + margin);
+    auto firstV = hullQueryCellCoordinate(query, vMin - margin);
+    auto lastV = hullQueryCellCoordinate(query, vMax + margin);
+    for (int v = firstV; v <= lastV; v++)
+    {
+        for (int u = firstU; u <= lastU; u++)
+        {
+            fn((side * query.resolution + v) * query.resolution + u);
+        }
+    }
+}
+
+// Calls fn(cell) for every cell the central projection of face touches
+template <typename S, typename F>
+static void hullQueryForFaceCells(const HullQuery<S> &query, const position_t<S> *corners, F fn)
+{
+    for (int side = 0; side < 6; side++)
+    {
+        S uMin = 2, uMax = -2, vMin = 2, vMax = -2;
+        hullQueryAddToSideBounds(query, corners, side, uMin, uMax, vMin, vMax);
+        hullQueryForSideCells(query, side, uMin, uMax, vMin, vMax, fn);
+    }
+}
+
+// Calls fn(cell) for every cell the central projection of the box [min, max]
+// touches, some more than once. The box must not hold the center. Sides of the
+// cube the box doesn't reach are skipped. On the others the projection of a
+// box in front of the center is the one of its corners, else of its surface,
+// two triangles per side.
+template <typename S, typename F>
+static void hullQueryForBoxCells(const HullQuery<S> &query, const position_t<S> &min, const position_t<S> &max, F fn)
+{
+    position_t<S> box[8];
+    for (int i = 0; i < 8; i++)
+    {
+        box[i] = position_t<S>(i & 1 ? max.x : min.x, i & 2 ? max.y : min.y, i & 4 ? max.z : min.z);
+    }
+    // the corners of each side of the box in order around it
+    static const int sides[6][4] = {{0, 2, 6, 4}, {1, 3, 7, 5}, {0, 1, 5, 4}, {2, 3, 7, 6}, {0, 1, 3, 2}, {4, 5, 7, 6}};
+
+    auto low = min - query.center;
+    auto high = max - query.center;
+    for (int side = 0; side < 6; side++)
+    {
+        auto axis = side / 2;
+        auto nearest = side % 2 ? -high[axis] : low[axis];
+        auto furthest = side % 2 ? -low[axis] : high[axis];
+        // the side needs a point of the box further along the axis than across it
+        auto across = (S)0;
+        for (int other = 1; other < 3; other++)
+        {
+            auto i = (axis + other) % 3;
+            across = Max(across, low[i] > 0 ? low[i] : (high[i] < 0 ? -high[i] : (S)0));
+        }
+        if (furthest <= across)
+        {
+            continue;
+        }
+
+        S uMin = 2, uMax = -2, vMin = 2, vMax = -2;
+        if (nearest > 0)
+        {
+            for (auto &corner : box)
+            {
+                auto d = corner - query.center;
+                auto major = std::abs(d[axis]);
+                auto u = d[(axis + 1) % 3] / major;
+                auto v = d[(axis + 2) % 3] / major;
+                uMin = Min(uMin, u);
+                uMax = Max(uMax, u);
+                vMin = Min(vMin, v);
+                vMax = Max(vMax, v);
+            }
+        }
+        else
+        {
+            for (auto &quad : sides)
+            {
+                position_t<S> first[3] = {box[quad[0]], box[quad[1]], box[quad[2]]};
+                position_t<S> second[3] = {box[quad[0]], box[quad[2]], box[quad[3]]};
+                hullQueryAddToSideBounds(query, first, side, uMin, uMax, vMin, vMax);
+                hullQueryAddToSideBounds(query, second, side, uMin, uMax, vMin, vMax);
+            }
+        }
+        hullQueryForSideCells(query, side, uMin, uMax, vMin, vMax, fn);
+    }
+}
+
+// Cosine of the widest angle at the center between a point at r from it and
+// the boundary points within distance of that point. The boundary lies between
+// the inner and the outer ball, and by the law of cosines a boundary point at s
+// from the center is at cosine (s^2 + r^2 - distance^2) / (2 s r), smallest at
+// s = sqrt(r^2 - distance^2). The radii and distance get some slack for rounding.
+template <typename S>
+static S hullQueryConeCosine(const HullQuery<S> &query, S r, S distance)
+{
+    const S slack = (S)1e-5;
+    distance *= 1 + slack;
+    auto squared = r * r - distance * distance;
+    auto s = squared > 0 ? std::sqrt(squared) : (S)0;
+    s = Min(Max(s, query.innerRadius * (1 - slack)), query.outerRadius * (1 + slack));
+    if (s <= 0 || r <= 0)
+    {
+        return -1;
+    }
+    return (s * s + squared) / (2 * s * r);
+}
+
+// Calls fn(cell) for every cell holding a direction less than the angle of
+// cosine from d, some more than once. Returns false without calling fn when
+// the cone is too wide for that, through the box around its cap on the sphere
+// holding the center. The cells of the box are narrowed to those whose center
+// is within the angle and half a cell diagonal, the most a direction in the
+// cell can be from its center.
+template <typename S, typename F>
+static bool hullQueryForConeCells(const HullQuery<S> &query, const position_t<S> &d, S cosine, F fn)
+{
+    if (cosine <= 0)
+    {
+        return false;
+    }
+    auto axis = glm::normalize(d);
+    auto sine = std::sqrt(Max(1 - cosine * cosine, (S)0));
+    position_t<S> min, max;
+    for (int i = 0; i < 3; i++)
+    {
+        // the cap reaches furthest along i at the angle from axis[i] to it
+        auto across = std::sqrt(Max(1 - axis[i] * axis[i], (S)0)) * sine;
+        max[i] = axis[i] >= cosine ? 1 : axis[i] * cosine + across;
+        min[i] = axis[i] <= -cosine ? -1 : axis[i] * cosine - across;
+    }
+    if (glm::all(glm::lessThanEqual(min, position_t<S>(0))) && glm::all(glm::lessThanEqual(position_t<S>(0), max)))
+    {
+        return false;
+    }
+
+    auto diagonal = (S)1.4142136 / (S)query.resolution;
+    auto within = cosine * std::cos(diagonal) - sine * std::sin(diagonal);
+    auto sideCells = query.resolution * query.resolution;
+    hullQueryForBoxCells(query, query.center + min, query.center + max, [&](int cell)
+    {
+        auto side = cell / sideCells;
+        auto u = ((cell % query.resolution) + (S)0.5) * 2 / (S)query.resolution - 1;
+        auto v = ((cell / query.resolution % query.resolution) + (S)0.5) * 2 / (S)query.resolution - 1;
+        position_t<S> direction;
+        direction[side / 2] = side % 2 ? (S)-1 : (S)1;
+        direction[(side / 2 + 1) % 3] = u;
+        direction[(side / 2 + 2) % 3] = v;
+        if (glm::dot(direction, axis) >= within * glm::length(direction))
+        {
+            fn(cell);
+        }
+    });
+    return true;
+}
+
+// Builds the query structure for a hull extracted with HullResult_Compact.
+// A query kept around reuses its buffers.
+template <typename S>
+static void hullQueryBuild(HullQuery<S> &query, const HullResult<S> &result)
+{
+    assert(result.flags & HullResult_Compact);
+    auto faceCount = (int)hullResultFaceCount(result);
+
+    query.normalX.size = query.normalY.size = query.normalZ.size = query.offset.size = 0;
+    query.corners.size = 0;
+    reserve(query.normalX, (size_t)faceCount);
+    reserve(query.normalY, (size_t)faceCount);
+    reserve(query.normalZ, (size_t)faceCount);
+    reserve(query.offset, (size_t)faceCount);
+    reserve(query.corners, (size_t)faceCount * 3);
+
+    query.center = position_t<S>(0);
+    for (auto &v : result.vertices)
+    {
+        query.center += v;
+    }
+    query.center /= (S)Max(result.vertices.size, (size_t)1);
+
+    query.innerRadius = std::numeric_limits<S>::max();
+    query.outerRadius = 0;
+    for (auto &v : result.vertices)
+    {
+        query.outerRadius = Max(query.outerRadius, glm::length(v - query.center));
+    }
+
+    for (int f = 0; f < faceCount; f++)
+    {
+        auto &a = result.vertices[result.indices[f * 3]];
+        auto &b = result.vertices[result.indices[f * 3 + 1]];
+        auto &c = result.vertices[result.indices[f * 3 + 2]];
+        auto plane = (result.flags & HullResult_Planes) ? result.planes[f] : plane_t<S>(glm::normalize(glm::cross(b - a, c - a)), 0);
+        if (!(result.flags & HullResult_Planes))
+        {
+            plane.w = glm::dot(position_t<S>(plane), a);
+        }
+        addToList(query.normalX, plane.x);
+        addToList(query.normalY, plane.y);
+        addToList(query.normalZ, plane.z);
+        addToList(query.offset, plane.w);
+        addToList(query.corners, {a, b, c});
+        query.innerRadius = Min(query.innerRadius, plane.w - glm::dot(position_t<S>(plane), query.center));
+    }
+    query.innerRadius = Max(query.innerRadius, (S)0);
+
+    // about as many cells as faces, so most cells hold a handful of planes
+    query.resolution = Max(1, (int)std::ceil(std::sqrt(faceCount / 6.0)));
+    auto cellCount = 6 * query.resolution * query.resolution;
+    query.cellStart.size = 0;
+    reserve(query.cellStart, (size_t)cellCount + 1);
+    query.cellStart.size = (size_t)cellCount + 1;
+    for (auto &start : query.cellStart)
+    {
+        start = 0;
+    }
+    for (int f = 0; f < faceCount; f++)
+    {
+        hullQueryForFaceCells(query, &query.corners[f * 3], [&](int cell) { query.cellStart[cell + 1]++; });
+    }
+    for (int cell = 0; cell < cellCount; cell++)
+    {
+        query.cellStart[cell + 1] += query.cellStart[cell];
+    }
+
+    query.cellPlanes.size = 0;
+    reserve(query.cellPlanes, (size_t)query.cellStart[cellCount]);
+    query.cellPlanes.size = (size_t)query.cellStart[cellCount];
+    query.cellFaces.size = 0;
+    reserve(query.cellFaces, (size_t)query.cellStart[cellCount]);
+    query.cellFaces.size = (size_t)query.cellStart[cellCount];
+    // cellStart[cell] walks up to the end of the cell while filling, and is
+    // moved back one cell afterwards
+    for (int f = 0; f < faceCount; f++)
+    {
+        auto plane = plane_t<S>(query.normalX[f], query.normalY[f], query.normalZ[f], query.offset[f]);
+        hullQueryForFaceCells(query, &query.corners[f * 3], [&](int cell)
+        {
+            query.cellFaces[query.cellStart[cell]] = f;
+            query.cellPlanes[query.cellStart[cell]++] = plane;
+        });
+    }
+    for (int cell = cellCount; cell > 0; cell--)
+    {
+        query.cellStart[cell] = query.cellStart[cell - 1];
+    }
+    query.cellStart[0] = 0;
+}
+
+// Inside or on the hull. Points within rounding of the boundary can go either way.
+template <typename S>
+static bool hullQueryContains(const HullQuery<S> &query, const position_t<S> &p)
+{
+    auto d = p - query.center;
+    auto squared = glm::dot(d, d);
+    if (squared <= query.innerRadius * query.innerRadius)
+    {
+        return true;
+    }
+    if (squared > query.outerRadius * query.outerRadius)
+    {
+        return false;
+    }
+
+    auto cell = hullQueryCell(query, p);
+    auto planes = query.cellPlanes.data();
+    for (int i = query.cellStart[cell]; i < query.cellStart[cell + 1]; i++)
+    {
+        if (glm::dot(position_t<S>(planes[i]), p) > planes[i].w)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Squared distance from p to the triangle abc, from Ericson, Real-Time Collision Detection 5.1.5
+template <typename S>
+static S hullQueryTriangleDistanceSquared(const position_t<S> &p, const position_t<S> &a, const position_t<S> &b, const position_t<S> &c)
+{
+    auto ab = b - a;
+    auto ac = c - a;
+    auto ap = p - a;
+    auto d1 = glm::dot(ab, ap);
+    auto d2 = glm::dot(ac, ap);
+    position_t<S> closest;
+    if (d1 <= 0 && d2 <= 0)
+    {
+        closest = a;
+    }
+    else
+    {
+        auto bp = p - b;
+        auto d3 = glm::dot(ab, bp);
+        auto d4 = glm::dot(ac, bp);
+        auto cp = p - c;
+        auto d5 = glm::dot(ab, cp);
+        auto d6 = glm::dot(ac, cp);
+        auto vc = d1 * d4 - d3 * d2;
+        auto vb = d5 * d2 - d1 * d6;
+        auto va = d3 * d6 - d5 * d4;
+        if (d3 >= 0 && d4 <= d3)
+        {
+            closest = b;
+        }
+        else if (vc <= 0 && d1 >= 0 && d3 <= 0)
+        {
+            closest = a + ab * (d1 / (d1 - d3));
+        }
+        else if (d6 >= 0 && d5 <= d6)
+        {
+            closest = c;
+        }
+        else if (vb <= 0 && d2 >= 0 && d6 <= 0)
+        {
+            closest = a + ac * (d2 / (d2 - d6));
+        }
+        else if (va <= 0 && (d4 - d3) >= 0 && (d5 - d6) >= 0)
+        {
+            closest = b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+        }
+        else
+        {
+            auto denom = 1 / (va + vb + vc);
+            closest = a + ab * (vb * denom) + ac * (vc * denom);
+        }
+    }
+    auto d = p - closest;
+    return glm::dot(d, d);
+}
+
+// Largest plane distance over every face, in arrays of plane components laid
+// out so the loop vectorizes
+template <typename S>
+static S hullQueryLargestPlaneDistance(const HullQuery<S> &query, const position_t<S> &p)
+{
+    auto faceCount = (int)query.offset.size;
+    auto nx = query.normalX.data();
+    auto ny = query.normalY.data();
+    auto nz = query.normalZ.data();
+    auto w = query.offset.data();
+
+    auto largest = -std::numeric_limits<S>::max();
+    for (int f = 0; f < faceCount; f++)
+    {
+        auto distance = nx[f] * p.x + ny[f] * p.y + nz[f] * p.z - w[f];
+        largest = distance > largest ? distance : largest;
+    }
+    return largest;
+}
+
+// Smaller of closest and the squared distance to the closest face p is in
+// front of, over every face
+template <typename S>
+static S hullQueryClosestFaceSquared(const HullQuery<S> &query, const position_t<S> &p, S closest)
+{
+    auto faceCount = (int)query.offset.size;
+    for (int f = 0; f < faceCount; f++)
+    {
+        // the face is no closer than its plane
+        auto distance = query.normalX[f] * p.x + query.normalY[f] * p.y + query.normalZ[f] * p.z - query.offset[f];
+        if (distance > 0 && distance * distance < closest)
+        {
+            auto corners = &query.corners[f * 3];
+            closest = Min(closest, hullQueryTriangleDistanceSquared(p, corners[0], corners[1], corners[2]));
+        }
+    }
+    return closest;
+}
+
+// Distance to the hull's boundary, negative inside. Inside the closest
+// boundary point is on the closest face plane. Outside it is on one of the
+// faces p is in front of. Either way the faces of p's cell bound the distance,
+// which bounds the cells the closest boundary point can be in.
+template <typename S>
+static S hullQuerySignedDistance(const HullQuery<S> &query, HullQueryScratch &scratch, const position_t<S> &p)
+{
+    auto faceCount = query.offset.size;
+    if (faceCount < HULL_QUERY_SCAN_FACES)
+    {
+        auto largest = hullQueryLargestPlaneDistance(query, p);
+        return largest <= 0 ? largest : std::sqrt(hullQueryClosestFaceSquared(query, p, std::numeric_limits<S>::max()));
+    }
+
+    auto planes = query.cellPlanes.data();
+    auto faces = query.cellFaces.data();
+    auto d = p - query.center;
+    auto r = glm::length(d);
+    auto cell = hullQueryCell(query, p);
+    auto largest = -std::numeric_limits<S>::max();
+    for (int i = query.cellStart[cell]; i < query.cellStart[cell + 1]; i++)
+    {
+        auto distance = glm::dot(position_t<S>(planes[i]), p) - planes[i].w;
+        largest = distance > largest ? distance : largest;
+    }
+
+    if (largest <= 0)
+    {
+        auto cosine = hullQueryConeCosine(query, r, -largest);
+        auto bounded = hullQueryForConeCells(query, d, cosine, [&](int coneCell)
+        {
+            for (int i = query.cellStart[coneCell]; i < query.cellStart[coneCell + 1]; i++)
+            {
+                auto distance = glm::dot(position_t<S>(planes[i]), p) - planes[i].w;
+                largest = distance > largest ? distance : largest;
+            }
+        });
+        return bounded ? largest : hullQueryLargestPlaneDistance(query, p);
+    }
+
+    if (scratch.visited.size != faceCount || ++scratch.mark == 0)
+    {
+        scratch.visited.size = 0;
+        reserve(scratch.visited, faceCount);
+        scratch.visited.size = faceCount;
+        for (size_t f = 0; f < faceCount; f++)
+        {
+            scratch.visited[f] = 0;
+        }
+        scratch.mark = 1;
+    }
+
+    // the face is no closer than its plane, a face in several cells is checked once
+    auto closest = std::numeric_limits<S>::max();
+    auto checkCell = [&](int coneCell)
+    {
+        for (int i = query.cellStart[coneCell]; i < query.cellStart[coneCell + 1]; i++)
+        {
+            auto distance = glm::dot(position_t<S>(planes[i]), p) - planes[i].w;
+            if (distance > 0 && distance * distance < closest && scratch.visited[faces[i]] != scratch.mark)
+            {
+                scratch.visited[faces[i]] = scratch.mark;
+                auto corners = &query.corners[faces[i] * 3];
+                closest = Min(closest, hullQueryTriangleDistanceSquared(p, corners[0], corners[1], corners[2]));
+            }
+        }
+    };
+    checkCell(cell);
+    auto cosine = hullQueryConeCosine(query, r, std::sqrt(closest));
+    if (!hullQueryForConeCells(query, d, cosine, checkCell))
+    {
+        closest = hullQueryClosestFaceSquared(query, p, closest);
+    }
+    return std::sqrt(closest);
+}
+
+static void hullQueryScratchFree(HullQueryScratch &scratch)
+{
+    clear(scratch.visited);
+    scratch = {};
+}
+
+// Batch versions, split over threadCount threads, <= 0 for one per hardware thread
+template <typename S>
+static void hullQueryContains(const HullQuery<S> &query, const position_t<S> *points, int count, bool *inside, int threadCount)
+{
+    parallelFor(count, threadCount, [&](int begin, int end)
+    {
+        for (int i = begin; i < end; i++)
+        {
+            inside[i] = hullQueryContains(query, points[i]);
+        }
+    });
+}
+
+template <typename S>
+static void hullQuerySignedDistance(const HullQuery<S> &query, const position_t<S> *points, int count, S *distances, int threadCount)
+{
+    parallelFor(count, threadCount, [&](int begin, int end)
+    {
+        HullQueryScratch scratch = {};
+        for (int i = begin; i < end; i++)
+        {
+            distances[i] = hullQuerySignedDistance(query, scratch, points[i]);
+        }
+        hullQueryScratchFree(scratch);
+    });
+}
+
+template <typename S>
+static void hullQueryFree(HullQuery<S> &query)
+{
+    clear(query.cellStart);
+    clear(query.cellPlanes);
+    clear(query.cellFaces);
+    clear(query.normalX);
+    clear(query.normalY);
+    clear(query.normalZ);
+    clear(query.offset);
+    clear(query.corners);
+    query = {};
+}
+
+// Support queries, the hull vertex furthest along a direction. On a convex
+// hull a vertex with no neighbour further along d is the furthest of all, so
+// a query climbs the vertex graph from wherever the previous query of the same
+// stream ended. For directions that change a little between queries, like the
+// support calls of a moving object, that is a step or two.
+
+template <typename S>
+struct HullSupport
+{
+    List<position_t<S>> vertices;
+    // the neighbours of vertex v are neighbours[neighbourStart[v]] up to neighbours[neighbourStart[v + 1]]
+    List<int> neighbourStart;
+    List<int> neighbours;
+    // furthest vertex along each of the 26 directions (x, y, z) in {-1, 0, 1}^3
+    // except 0, where queries without a previous one start
+    int coldStart[26];
+};
+
+// Where one stream of support queries left off. Start it at {-1}.
+struct HullSupportCursor
+{
+    int vertex;
+};
+
+// Builds the vertex graph of a hull extracted with HullResult_Compact.
+// A structure kept around reuses its buffers.
+template <typename S>
+static void hullSupportBuild(HullSupport<S> &support, const HullResult<S> &result)
+{
+    assert(result.flags & HullResult_Compact);
+    auto vertexCount = (int)result.vertices.size;
+    auto faceCount = (int)hullResultFaceCount(result);
+
+    support.vertices.size = 0;
+    addToList(support.vertices, result.vertices.data(), result.vertices.size);
+
+    // every edge a -> b of a face is b -> a in its neighbour face, so the
+    // directed edges give each undirected edge once per end
+    support.neighbourStart.size = 0;
+    reserve(support.neighbourStart, (size_t)vertexCount + 1);
+    support.neighbourStart.size = (size_t)vertexCount + 1;
+    for (auto &start : support.neighbourStart)
+    {
+        start = 0;
+    }
+    for (int i = 0; i < faceCount * 3; i++)
+    {
+        support.neighbourStart[result.indices[i] + 1]++;
+    }
+    for (int v = 0; v < vertexCount; v++)
+    {
+        support.neighbourStart[v + 1] += support.neighbourStart[v];
+    }
+
+    support.neighbours.size = 0;
+    reserve(support.neighbours, (size_t)faceCount * 3);
+    support.neighbours.size = (size_t)faceCount * 3;
+    for (int f = 0; f < faceCount; f++)
+    {
+        for (int i = 0; i < 3; i++)
+        {
+            auto from = result.indices[f * 3 + i];
+            auto to = result.indices[f * 3 + (i + 1) % 3];
+            support.neighbours[support.neighbourStart[from]++] = to;
+        }
+    }
+    for (int v = vertexCount; v > 0; v--)
+    {
+        support.neighbourStart[v] = support.neighbourStart[v - 1];
+    }
+    support.neighbourStart[0] = 0;
+
+    for (int i = 0, direction = 0; i < 27; i++)
+    {
+        if (i == 13)
+        {
+            continue;
+        }
+        auto d = position_t<S>((S)(i % 3 - 1), (S)(i / 3 % 3 - 1), (S)(i / 9 - 1));
+        auto best = 0;
+        auto bestDot = -std::numeric_limits<S>::max();
+        for (int v = 0; v < vertexCount; v++)
+        {
+            auto dot = glm::dot(support.vertices[v], d);
+            if (dot > bestDot)
+            {
+                best = v;
+                bestDot = dot;
+            }
+        }
+        support.coldStart[direction++] = best;
+    }
+}
+
+// Index of the hull vertex furthest along d, starting from where cursor left off
+template <typename S>
+static int hullSupport(const HullSupport<S> &support, HullSupportCursor &cursor, const position_t<S> &d)
+{
+    auto vertices = support.vertices.data();
+    auto current = cursor.vertex;
+    if (current < 0 || current >= (int)support.vertices.size)
+    {
+        // the coarse direction closest to d, components rounded where they
+        // are at least 0.4 of the largest
+        auto largest = Max(std::abs(d.x), Max(std::abs(d.y), std::abs(d.z)));
+        auto threshold = largest * (S)0.4;
+        auto coarse = [&](S c) { return c > threshold ? 2 : (c < -threshold ? 0 : 1); };
+        auto i = coarse(d.x) + coarse(d.y) * 3 + coarse(d.z) * 9;
+        current = support.coldStart[i == 13 ? 0 : (i > 13 ? i - 1 : i)];
+    }
+
+    auto currentDot = glm::dot(vertices[current], d);
+    for (;;)
+    {
+        auto next = current;
+        auto nextDot = currentDot;
+        for (int i = support.neighbourStart[current]; i < support.neighbourStart[current + 1]; i++)
+        {
+            auto neighbour = support.neighbours[i];
+            auto dot = glm::dot(vertices[neighbour], d);
+            if (dot > nextDot)
+            {
+                next = neighbour;
+                nextDot = dot;
+            }
+        }
+        if (next == current)
+        {
+            break;
+        }
+        current = next;
+        currentDot = nextDot;
+    }
+
+    cursor.vertex = current;
+    return current;
+}
+
+// One stream of count directions, in order, each warm started from the previous
+template <typename S>
+static void hullSupport(const HullSupport<S> &support, HullSupportCursor &cursor, const position_t<S> *directions, int count, int *vertices)
+{
+    for (int i = 0; i < count; i++)
+    {
+        vertices[i] = hullSupport(support, cursor, directions[i]);
+    }
+}
+
+template <typename S>
+static void hullSupportFree(HullSupport<S> &support)
+{
+    clear(support.vertices);
+    clear(support.neighbourStart);
+    clear(support.neighbours);
+    support = {};
+}
+
+// Builds the query structure over incremental hulls of a few sizes and logs
+// the rate of containment and signed distance queries, against testing every
+// plane for containment. The query points fill the hull's bounding box and a
+// margin around it.
+template <typename S>
+static void RunQueryBenchmark(glm::vec3 offset, unsigned long long seed, const char *scalarName)
+{
+    const int pointCounts[] = {1000, 100000};
+    const int queryCount = 200000;
+    GeneratorType genTypes[] = {InSphere, OnSphere};
+
+    for (auto genType : genTypes)
+    {
+        for (auto pointCount : pointCounts)
+        {
+            PointGenerator generator = {};
+            generator.seed = seed;
+            initPointGenerator(generator, genType, pointCount, 0.0, 200.0);
+            auto points = generate(generator, offset);
+
+            IncContext<S> incContext = {};
+            incInitializeContext(incContext, points, pointCount, seed);
+            incConstructFullHull(incContext);
+            HullResult<S> result = {};
+            incExtractResult(incContext, result, HullResult_Compact | HullResult_Planes);
+            incFreeContext(incContext);
+
+            HullQuery<S> query = {};
+            auto buildStart = currentTimeNano();
+            hullQueryBuild(query, result);
+            auto buildTime = currentTimeNano() - buildStart;
+
+            std::mt19937_64 gen{seed};
+            std::uniform_real_distribution<S> coordinate(-(S)1.2, (S)1.2);
+            std::vector<position_t<S>> queries((size_t)queryCount);
+            for (auto &q : queries)
+            {
+                q = query.center + position_t<S>(coordinate(gen), coordinate(gen), coordinate(gen)) * query.outerRadius;
+            }
+            auto inside = (bool *)malloc(sizeof(bool) * queryCount);
+            auto distances = (S *)malloc(sizeof(S) * queryCount);
+
+            auto start = currentTimeNano();
+            hullQueryContains(query, queries.data(), queryCount, inside, 1);
+            auto containsTime = currentTimeNano() - start;
+
+            start = currentTimeNano();
+            auto bruteInside = 0;
+            auto faceCount = (int)hullResultFaceCount(result);
+            for (auto &q : queries)
+            {
+                auto in = true;
+                for (int f = 0; f < faceCount && in; f++)
+                {
+                    in = glm::dot(position_t<S>(result.planes[f]), q) <= result.planes[f].w;
+                }
+                bruteInside += in ? 1 : 0;
+            }
+            auto bruteTime = currentTimeNano() - start;
+
+            auto threadCount = hardwareThreadCount();
+            start = currentTimeNano();
+            hullQueryContains(query, queries.data(), queryCount, inside, threadCount);
+            auto containsThreadsTime = currentTimeNano() - start;
+
+            // distances on big hulls check hundreds of cells, so fewer of them
+            auto distanceCount = Max(1, Min(queryCount, (int)(2e9 / faceCount)));
+            start = currentTimeNano();
+            hullQuerySignedDistance(query, queries.data(), distanceCount, distances, threadCount);
+            auto distanceTime = currentTimeNano() - start;
+
+            auto insideCount = 0;
+            for (int i = 0; i < queryCount; i++)
+            {
+                insideCount += inside[i] ? 1 : 0;
+            }
+
+            log_a("Query (%s) %s: %d faces, build %.2f ms, %.1f planes per cell, %d%% inside (all planes %d%%)\n",
+                  scalarName, GetGeneratorTypeString(genType), faceCount, buildTime / 1e6,
+                  query.cellPlanes.size / (double)(query.cellStart.size - 1), insideCount * 100 / queryCount, bruteInside * 100 / queryCount);
+            log_a("    contains: %.1f Mq/s (all planes %.2f Mq/s), %d threads %.1f Mq/s; signed distance, %d threads: %.3f Mq/s\n",
+                  queryCount / (containsTime / 1e3), queryCount / (bruteTime / 1e3), threadCount, queryCount / (containsThreadsTime / 1e3),
+                  threadCount, distanceCount / (distanceTime / 1e3));
+
+            free(inside);
+            free(distances);
+            hullQueryFree(query);
+            hullResultFree(result);
+            free(points);
+        }
+    }
+}
+
+// Support queries over incremental hulls of a few sizes: a stream of slowly
+// turning directions warm started from the previous query, random directions
+// from a cold start, and a scan of every vertex.
+template <typename S>
+static void RunSupportBenchmark(glm::vec3 offset, unsigned long long seed, const char *scalarName)
+{
+    const int pointCounts[] = {1000, 100000};
+    const int queryCount = 1000000;
+    GeneratorType genTypes[] = {InSphere, OnSphere};
+
+    for (auto genType : genTypes)
+    {
+        for (auto pointCount : pointCounts)
+        {
+            PointGenerator generator = {};
+            generator.seed = seed;
+            initPointGenerator(generator, genType, pointCount, 0.0, 200.0);
+            auto points = generate(generator, offset);
+
+            IncContext<S> incContext = {};
+            incInitializeContext(incContext, points, pointCount, seed);
+            incConstructFullHull(incContext);
+            HullResult<S> result = {};
+            incExtractResult(incContext, result, HullResult_Compact);
+            incFreeContext(incContext);
+
+            HullSupport<S> support = {};
+            auto buildStart = currentTimeNano();
+            hullSupportBuild(support, result);
+            auto buildTime = currentTimeNano() - buildStart;
+
+            // a direction turning by about a tenth of a degree per query
+            std::vector<position_t<S>> coherent((size_t)queryCount);
+            std::vector<position_t<S>> random((size_t)queryCount);
+            std::mt19937_64 gen{seed};
+            std::normal_distribution<S> normal;
+            for (int i = 0; i < queryCount; i++)
+            {
+                auto t = (S)i * (S)0.002;
+                coherent[i] = position_t<S>(std::cos(t) * std::cos(t * (S)0.37), std::sin(t) * std::cos(t * (S)0.37), std::sin(t * (S)0.37));
+                random[i] = position_t<S>(normal(gen), normal(gen), normal(gen));
+            }
+            auto found = (int *)malloc(sizeof(int) * queryCount);
+
+            HullSupportCursor cursor = {-1};
+            auto start = currentTimeNano();
+            hullSupport(support, cursor, coherent.data(), queryCount, found);
+            auto coherentTime = currentTimeNano() - start;
+
+            start = currentTimeNano();
+            for (int i = 0; i < queryCount; i++)
+            {
+                HullSupportCursor cold = {-1};
+                found[i] = hullSupport(support, cold, random[i]);
+            }
+            auto randomTime = currentTimeNano() - start;
+
+            // every vertex, on fewer directions
+            auto scanCount = Max(1, Min(queryCount, (int)(1e8 / support.vertices.size)));
+            auto mismatches = 0;
+            start = currentTimeNano();
+            for (int i = 0; i < scanCount; i++)
+            {
+                auto bestDot = -std::numeric_limits<S>::max();
+                for (auto &v : support.vertices)
+                {
+                    bestDot = Max(bestDot, glm::dot(v, random[i]));
+                }
+                mismatches += bestDot > glm::dot(support.vertices[found[i]], random[i]) ? 1 : 0;
+            }
+            auto scanTime = currentTimeNano() - start;
+
+            log_a("Support (%s) %s: %d hull vertices, build %.2f ms: coherent %.1f ns, cold %.1f ns, every vertex %.1f ns per query%s\n",
+                  scalarName, GetGeneratorTypeString(genType), (int)support.vertices.size, buildTime / 1e6,
+                  coherentTime / (double)queryCount, randomTime / (double)queryCount, scanTime / (double)scanCount,
+                  mismatches ? ", wrong answers" : "");
+
+            free(found);
+            hullSupportFree(support);
+            hullResultFree(result);
+            free(points);
+        }
+    }
+}
+
+#endif
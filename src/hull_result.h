@@ -0,0 +1,120 @@
+#ifndef HULL_RESULT_H
+#define HULL_RESULT_H
+
+// The finished hull in flat buffers, for code that wants the result rather than
+// something to draw. The engines fill it with qhExtractResult, incExtractResult
+// and dacExtractResult. Nothing in here touches GL or allocates per face, and a
+// result kept between runs reuses its buffers.
+
+enum HullResultFlags
+{
+    // number the hull's vertices 0..vertices.size and copy them out
+    HullResult_Compact = 1,
+    // one plane per face
+    HullResult_Planes = 2,
+};
+
+// Plane through a face as normal and offset, dot(normal, p) == offset on the
+// plane and greater outside of the hull
+template <typename S>
+using plane_t = glm::vec<4, S, glm::defaultp>;
+
+template <typename S>
+struct HullResult
+{
+    int flags;
+
+    // three indices per face, counter clockwise seen from outside. They index
+    // into the input points, or into vertices with HullResult_Compact.
+    List<int32_t> indices;
+
+    // HullResult_Compact: the hull's vertices and which input point each one is
+    List<position_t<S>> vertices;
+    List<int32_t> inputIndices;
+
+    // HullResult_Planes: the plane of the face starting at indices[3 * i]
+    List<plane_t<S>> planes;
+
+    // input index to compacted index, -1 for points not seen yet. Only the
+    // entries in inputIndices are ever set, so it's reset in O(hull vertices).
+    List<int32_t> compactIndex;
+};
+
+// Empties result for a hull of faceCount faces on pointCount input points
+template <typename S>
+static void hullResultBegin(HullResult<S> &result, int flags, int pointCount, size_t faceCount)
+{
+    for (auto inputIndex : result.inputIndices)
+    {
+        result.compactIndex[inputIndex] = -1;
+    }
+
+    result.flags = flags;
+    result.indices.size = 0;
+    result.vertices.size = 0;
+    result.inputIndices.size = 0;
+    result.planes.size = 0;
+
+    reserve(result.indices, faceCount * 3);
+    if (flags & HullResult_Compact)
+    {
+        reserve(result.compactIndex, (size_t)pointCount);
+        while (result.compactIndex.size < (size_t)pointCount)
+        {
+            result.compactIndex.data()[result.compactIndex.size++] = -1;
+        }
+    }
+    if (flags & HullResult_Planes)
+    {
+        reserve(result.planes, faceCount);
+    }
+}
+
+// Appends the face (a, b, c), given counter clockwise seen from outside by input index and position
+template <typename S>
+static void hullResultAddFace(HullResult<S> &result, const int inputIndex[3], const position_t<S> *position[3])
+{
+    if (result.flags & HullResult_Compact)
+    {
+        for (int i = 0; i < 3; i++)
+        {
+            auto &compactIndex = result.compactIndex[inputIndex[i]];
+            if (compactIndex < 0)
+            {
+                compactIndex = (int32_t)result.vertices.size;
+                addToList(result.vertices, *position[i]);
+                addToList(result.inputIndices, (int32_t)inputIndex[i]);
+            }
+            addToList(result.indices, compactIndex);
+        }
+    }
+    else
+    {
+        addToList(result.indices, {(int32_t)inputIndex[0], (int32_t)inputIndex[1], (int32_t)inputIndex[2]});
+    }
+
+    if (result.flags & HullResult_Planes)
+    {
+        auto normal = glm::normalize(glm::cross(*position[1] - *position[0], *position[2] - *position[0]));
+        addToList(result.planes, plane_t<S>(normal, glm::dot(normal, *position[0])));
+    }
+}
+
+template <typename S>
+static size_t hullResultFaceCount(const HullResult<S> &result)
+{
+    return result.indices.size / 3;
+}
+
+template <typename S>
+static void hullResultFree(HullResult<S> &result)
+{
+    clear(result.indices);
+    clear(result.vertices);
+    clear(result.inputIndices);
+    clear(result.planes);
+    clear(result.compactIndex);
+    result = {};
+}
+
+#endif
@@ -2,77 +2,92 @@
 #define INCREMENTAL_H
 
 ///forward declare structs
+template <typename S>
 struct IncVertex;
+template <typename S>
 struct IncEdge;
+template <typename S>
 struct IncFace;
+template <typename S>
 struct IncArc;
 
+template <typename S>
 struct IncArc
 {
     union {
-        IncVertex *vertexEndpoint;
-        IncFace *faceEndpoint;
+        IncVertex<S> *vertexEndpoint;
+        IncFace<S> *faceEndpoint;
     };
     size_t indexInEndpoint;
 };
 
+template <typename S>
 struct IncVertex
 {
-    glm::vec3 position;
+    position_t<S> position;
     int vIndex;
-    IncEdge *duplicate;
+    IncEdge<S> *duplicate;
     bool isOnHull;
     bool isProcessed;
     bool isRemoved;
     bool isAlreadyInConflicts;
-    IncVertex *next;
-    IncVertex *prev;
-    List<IncArc> arcs;
+    IncVertex<S> *next;
+    IncVertex<S> *prev;
+    List<IncArc<S>> arcs;
 };
 
+template <typename S>
 struct IncEdge
 {
-    IncFace *adjFace[2];
-    IncVertex *endPoints[2];
-    IncFace *newFace; //pointer to face about to be added (to remember old structure)
+    IncFace<S> *adjFace[2];
+    IncVertex<S> *endPoints[2];
+    IncFace<S> *newFace; //pointer to face about to be added (to remember old structure)
     bool shouldBeRemoved;
     bool isRemoved;
-    IncEdge *next;
-    IncEdge *prev;
+    IncEdge<S> *next;
+    IncEdge<S> *prev;
 };
 
+template <typename S>
 struct IncFace
 {
-    IncEdge *edge[3];
-    IncVertex *vertex[3];
-    glm::vec3 normal;
-    glm::vec3 centerPoint;
+    IncEdge<S> *edge[3];
+    IncVertex<S> *vertex[3];
+    //built by the first sidedness test, many faces are removed before they get one
+    PredicatePlane plane;
+    bool hasPlane;
     bool isVisible;
     bool isRemoved;
-    IncFace *next;
-    IncFace *prev;
-    List<IncArc> arcs;
+    IncFace<S> *next;
+    IncFace<S> *prev;
+    List<IncArc<S>> arcs;
 };
 
-//Head pointers to each of the three lists
-IncVertex *incVertices = nullptr;
-IncEdge *incEdges = nullptr;
-IncFace *incFaces = nullptr;
-
-//Pointer to current vertex in step context
-IncVertex *currentStepVertex = nullptr;
+// Phases timed by the benchmark harness. Cone excludes the conflict list rebuild of the new faces.
+enum IncPhase
+{
+    IncPhase_ConflictInit,
+    IncPhase_Cone,
+    IncPhase_ConflictRebuild,
+    IncPhase_Cleanup,
+    IncPhase_Count
+};
 
-//counters
-static int incCreatedFaces = 0;
-static int incProcessedVertices = 3;
-static unsigned long long incSidednessQueries = 0;
-static int incVerticesOnHull = 0;
-static int incFacesOnHull = 0;
+static const char *incPhaseNames[IncPhase_Count] = {"conflict init", "cone", "conflict rebuild", "cleanup"};
 
+template <typename S>
 struct IncContext
 {
     bool initialized;
     
+    //Head pointers to each of the three lists
+    IncVertex<S> *vertices;
+    IncEdge<S> *edges;
+    IncFace<S> *faces;
+    
+    //Pointer to current vertex in step context
+    IncVertex<S> *currentStepVertex;
+    
     int numberOfPoints;
     Mesh *m;
     struct
@@ -83,8 +98,15 @@ struct IncContext
         int facesOnHull;
         int verticesOnHull;
         unsigned long long timeSpent;
+        PhaseTimes phases;
     } processingState;
     bool failed;
+    unsigned long long seed;
+    
+    //for incInsertPoints: a point strictly inside the hull, set on the first insertion
+    position_t<S> interiorPoint;
+    bool hasInteriorPoint;
+    unsigned long long walkState;
 };
 
 template <typename T>
@@ -119,46 +141,60 @@ void incRemoveFromHead(T *head, T *pointer)
         }
         (*pointer)->next->prev = (*pointer)->prev;
         (*pointer)->prev->next = (*pointer)->next;
-        free(*pointer);
+        memFree(*pointer);
         *pointer = nullptr;
     }
 };
 
-static void incCopyVertices(Vertex *vertices, int numberOfPoints)
+template <typename S, typename P>
+static void incCopyVertices(IncContext<S> &incContext, P *vertices, int numberOfPoints, unsigned long long seed)
 {
-    Vertex *shuffledVertices = (Vertex *)malloc(sizeof(Vertex) * numberOfPoints);
-    memcpy(shuffledVertices, vertices, sizeof(Vertex) * numberOfPoints);
-    Vertex temp;
+    //shuffle the order instead of the vertices, so vIndex can stay the index into the input
+    int *order = (int *)memAlloc(sizeof(int) * numberOfPoints);
+    for (int i = 0; i < numberOfPoints; i++)
+    {
+        order[i] = i;
+    }
+    int temp;
     int j;
-    //Fisher Yates shuffle
+    //Fisher Yates shuffle, seeded so a run can be repeated on the same insertion order
+    std::mt19937_64 gen{seed};
     for (int i = numberOfPoints - 1; i > 0; i--)
     {
-        j = rand() % (i + 1);
-        temp = shuffledVertices[j];
-        shuffledVertices[j] = shuffledVertices[i];
-        shuffledVertices[i] = temp;
+        j = (int)(gen() % (unsigned long long)(i + 1));
+        temp = order[j];
+        order[j] = order[i];
+        order[i] = temp;
     }
     
-    IncVertex *v;
+    //allocated in input order and linked in insertion order, so points that are
+    //close in the input (see spatial_order.h) are close in memory as well
+    IncVertex<S> **allocated = (IncVertex<S> **)memAlloc(sizeof(IncVertex<S> *) * numberOfPoints);
     for (int i = 0; i < numberOfPoints; i++)
     {
-        v = (IncVertex *)malloc(sizeof(IncVertex));
+        IncVertex<S> *v = (IncVertex<S> *)memAlloc(sizeof(IncVertex<S>));
         v->duplicate = nullptr;
         v->isOnHull = false;
         v->isProcessed = false;
         v->isRemoved = false;
         v->isAlreadyInConflicts = false;
         v->vIndex = i;
-        v->position = shuffledVertices[i].position;
+        v->position = position_t<S>(vertices[i].position);
         init(v->arcs);
-        incAddToHead(&incVertices, v);
+        allocated[i] = v;
+    }
+    for (int i = 0; i < numberOfPoints; i++)
+    {
+        incAddToHead(&incContext.vertices, allocated[order[i]]);
     }
-    free(shuffledVertices);
+    memFree(allocated);
+    memFree(order);
 }
 
-IncEdge *incCreateNullEdge()
+template <typename S>
+IncEdge<S> *incCreateNullEdge(IncContext<S> &incContext)
 {
-    IncEdge *e = (IncEdge *)malloc(sizeof(IncEdge));
+    IncEdge<S> *e = (IncEdge<S> *)memAlloc(sizeof(IncEdge<S>));
     e->adjFace[0] = e->adjFace[1] = nullptr;
     e->newFace = nullptr;
     e->endPoints[0] = e->endPoints[1] = nullptr;
@@ -166,24 +202,26 @@ IncEdge *incCreateNullEdge()
     e->isRemoved = false;
     e->next = nullptr;
     e->prev = nullptr;
-    incAddToHead(&incEdges, e);
+    incAddToHead(&incContext.edges, e);
     
     return e;
 }
 
-IncFace *incCreateNullFace()
+template <typename S>
+IncFace<S> *incCreateNullFace(IncContext<S> &incContext)
 {
-    IncFace *f = (IncFace *)malloc(sizeof(IncFace));
+    IncFace<S> *f = (IncFace<S> *)memAlloc(sizeof(IncFace<S>));
     f->edge[0] = f->edge[1] = f->edge[2] = nullptr;
     f->vertex[0] = f->vertex[1] = f->vertex[2] = nullptr;
+    f->hasPlane = false;
     f->isVisible = false;
     f->isRemoved = false;
     f->next = nullptr;
     f->prev = nullptr;
-    incAddToHead(&incFaces, f);
+    incAddToHead(&incContext.faces, f);
     init(f->arcs);
     
-    incCreatedFaces++;
+    incContext.processingState.createdFaces++;
     
     return f;
 }
@@ -200,21 +238,28 @@ return
     ((v1->position.x - v0->position.x)(v2->position.y - v0->position.y)-(v2->position.x - v0->position.x)(v1->position.y - v0->position.y) == 0)
     
 */
-bool incColinear(IncVertex *v0, IncVertex *v1, IncVertex *v2)
+//colinear in 3D if colinear in all three axis-aligned projections
+template <typename S>
+bool incColinear(IncVertex<S> *v0, IncVertex<S> *v1, IncVertex<S> *v2)
 {
-    return glm::cross((v0->position - v1->position), (v1->position - v2->position)) == glm::vec3(0, 0, 0);
+    auto &a = v0->position;
+    auto &b = v1->position;
+    auto &c = v2->position;
+    return orient2d(a.x, a.y, b.x, b.y, c.x, c.y) == 0.0 && orient2d(a.y, a.z, b.y, b.z, c.y, c.z) == 0.0 && orient2d(a.z, a.x, b.z, b.x, c.z, c.x) == 0.0;
 }
 
-glm::vec3 incComputeFaceNormal(IncFace *f)
+//only for drawing, the sidedness tests go through the face's plane
+template <typename S>
+position_t<S> incComputeFaceNormal(const IncFace<S> *f)
 {
     // Newell's Method
     // https://www.khronos.org/opengl/wiki/Calculating_a_Surface_Normal
-    glm::vec3 normal = glm::vec3(0.0);
+    position_t<S> normal = position_t<S>(0);
     
     for (int i = 0; i < 3; i++)
     {
-        glm::vec3 current = f->vertex[i]->position;
-        glm::vec3 next = f->vertex[(i + 1) % 3]->position;
+        position_t<S> current = f->vertex[i]->position;
+        position_t<S> next = f->vertex[(i + 1) % 3]->position;
         
         normal.x = normal.x + (current.y - next.y) * (current.z + next.z);
         normal.y = normal.y + (current.z - next.z) * (current.x + next.x);
@@ -224,28 +269,47 @@ glm::vec3 incComputeFaceNormal(IncFace *f)
     return glm::normalize(normal);
 }
 
-static bool incIsPointOnPositiveSide(IncFace *f, IncVertex *v, coord_t epsilon = 0.0)
+//exact, the face normal points to the side orient3d calls below.
+//The face's plane decides unless v is too close to it, orient3d does then.
+template <typename S>
+static bool incIsPointOnPositiveSide(IncContext<S> &incContext, IncFace<S> *f, IncVertex<S> *v)
 {
-    incSidednessQueries++;
-    auto d = glm::dot(f->normal, v->position - f->centerPoint);
-    return d > epsilon;
+    incContext.processingState.sidednessQueries++;
+    //a face's own vertices are exactly on it, skip the exact fallback for them
+    if (v == f->vertex[0] || v == f->vertex[1] || v == f->vertex[2])
+    {
+        return false;
+    }
+    if (!f->hasPlane)
+    {
+        predicatePlaneBegin(f->plane, f->vertex[0]->position, f->vertex[1]->position, f->vertex[2]->position);
+        f->hasPlane = true;
+    }
+    bool certain;
+    auto value = predicatePlaneValue(f->plane, v->position, certain);
+    if (certain)
+    {
+        return value > 0.0;
+    }
+    return orient3d(f->vertex[0]->position, f->vertex[1]->position, f->vertex[2]->position, v->position) < 0.0;
 }
 
-static bool incIsPointCoplanar(IncFace *f, IncVertex *v, coord_t epsilon = 0.0)
+template <typename S>
+static bool incIsPointCoplanar(IncFace<S> *f, IncVertex<S> *v)
 {
-    auto d = glm::dot(f->normal, v->position - f->centerPoint);
-    return d >= -epsilon && d <= epsilon;
+    return orient3d(f->vertex[0]->position, f->vertex[1]->position, f->vertex[2]->position, v->position) == 0.0;
 }
 
-IncFace *incMakeFace(IncVertex *v0, IncVertex *v1, IncVertex *v2, IncFace *face)
+template <typename S>
+IncFace<S> *incMakeFace(IncContext<S> &incContext, IncVertex<S> *v0, IncVertex<S> *v1, IncVertex<S> *v2, IncFace<S> *face)
 {
-    IncEdge *e0, *e1, *e2;
+    IncEdge<S> *e0, *e1, *e2;
     //initial hedron, no edges to copy from
     if (!face)
     {
-        e0 = incCreateNullEdge();
-        e1 = incCreateNullEdge();
-        e2 = incCreateNullEdge();
+        e0 = incCreateNullEdge(incContext);
+        e1 = incCreateNullEdge(incContext);
+        e2 = incCreateNullEdge(incContext);
     }
     //copy edges in reverse order
     else
@@ -261,34 +325,33 @@ IncFace *incMakeFace(IncVertex *v0, IncVertex *v1, IncVertex *v2, IncFace *face)
     e2->endPoints[0] = v2;
     e2->endPoints[1] = v0;
     
-    IncFace *f = incCreateNullFace();
+    IncFace<S> *f = incCreateNullFace(incContext);
     f->edge[0] = e0;
     f->edge[1] = e1;
     f->edge[2] = e2;
     f->vertex[0] = v0;
     f->vertex[1] = v1;
     f->vertex[2] = v2;
-    auto v = (f->vertex[0]->position + f->vertex[1]->position + f->vertex[2]->position);
-    f->centerPoint = glm::vec3(v.x / 3.0, v.y / 3.0, v.z / 3.0);
     
     e0->adjFace[0] = e1->adjFace[0] = e2->adjFace[0] = f;
     
     return f;
 }
 
-void incInitConflictListForFace(IncFace *newFace, IncFace *oldFace1, IncFace *oldFace2)
+template <typename S>
+void incInitConflictListForFace(IncContext<S> &incContext, IncFace<S> *newFace, IncFace<S> *oldFace1, IncFace<S> *oldFace2)
 {
-    for (IncArc &arc : oldFace1->arcs)
+    for (IncArc<S> &arc : oldFace1->arcs)
     {
-        IncVertex *v = arc.vertexEndpoint;
-        if (incIsPointOnPositiveSide(newFace, v))
+        IncVertex<S> *v = arc.vertexEndpoint;
+        if (incIsPointOnPositiveSide(incContext, newFace, v))
         {
-            IncArc arcToFace = {};
+            IncArc<S> arcToFace = {};
             arcToFace.faceEndpoint = newFace;
             arcToFace.indexInEndpoint = newFace->arcs.size;
             addToList(v->arcs, arcToFace);
             
-            IncArc arcToVertex = {};
+            IncArc<S> arcToVertex = {};
             arcToVertex.vertexEndpoint = v;
             arcToVertex.indexInEndpoint = v->arcs.size - 1;
             addToList(newFace->arcs, arcToVertex);
@@ -296,19 +359,19 @@ void incInitConflictListForFace(IncFace *newFace, IncFace *oldFace1, IncFace *ol
         }
     }
     
-    for (IncArc &arc : oldFace2->arcs)
+    for (IncArc<S> &arc : oldFace2->arcs)
     {
-        IncVertex *v = arc.vertexEndpoint;
+        IncVertex<S> *v = arc.vertexEndpoint;
         if (!v->isAlreadyInConflicts)
         {
-            if (incIsPointOnPositiveSide(newFace, v))
+            if (incIsPointOnPositiveSide(incContext, newFace, v))
             {
-                IncArc arcToFace = {};
+                IncArc<S> arcToFace = {};
                 arcToFace.faceEndpoint = newFace;
                 arcToFace.indexInEndpoint = newFace->arcs.size;
                 addToList(v->arcs, arcToFace);
                 
-                IncArc arcToVertex = {};
+                IncArc<S> arcToVertex = {};
                 arcToVertex.vertexEndpoint = v;
                 arcToVertex.indexInEndpoint = v->arcs.size - 1;
                 addToList(newFace->arcs, arcToVertex);
@@ -316,27 +379,28 @@ void incInitConflictListForFace(IncFace *newFace, IncFace *oldFace1, IncFace *ol
         }
     }
     
-    for (IncArc &arc : newFace->arcs)
+    for (IncArc<S> &arc : newFace->arcs)
     {
         arc.vertexEndpoint->isAlreadyInConflicts = false;
     }
 }
 
-void incCleanConflictGraph(std::vector<IncFace *> &facesToRemove)
+template <typename S>
+void incCleanConflictGraph(std::vector<IncFace<S> *> &facesToRemove)
 {
-    for (IncFace *face : facesToRemove)
+    for (IncFace<S> *face : facesToRemove)
     {
-        for (IncArc &arc : face->arcs)
+        for (IncArc<S> &arc : face->arcs)
         {
             //We have to remove the arc from f->v and the arc v->f.
             //This is done by swapping with the last element in the arcs list
             //But since every arc knows the index of its duplicate arc, we also have to update the endPoint arcs we swap with
-            IncVertex *v = arc.vertexEndpoint;
+            IncVertex<S> *v = arc.vertexEndpoint;
             
             if (v->arcs.size == 0)
                 continue;
             
-            IncArc lastArcInV = v->arcs[v->arcs.size - 1];
+            IncArc<S> lastArcInV = v->arcs[v->arcs.size - 1];
             lastArcInV.faceEndpoint->arcs[lastArcInV.indexInEndpoint].indexInEndpoint = arc.indexInEndpoint;
             v->arcs[arc.indexInEndpoint] = v->arcs[v->arcs.size - 1];
             v->arcs.size = v->arcs.size - 1;
@@ -345,27 +409,28 @@ void incCleanConflictGraph(std::vector<IncFace *> &facesToRemove)
 }
 
 //double sided triangle from points NOT colinear
-void incCreateBihedron()
+template <typename S>
+void incCreateBihedron(IncContext<S> &incContext)
 {
-    IncVertex *v0 = incVertices;
+    IncVertex<S> *v0 = incContext.vertices;
     while (incColinear(v0, v0->next, v0->next->next))
     {
         v0 = v0->next;
-        if (v0 == incVertices)
+        if (v0 == incContext.vertices)
         {
             //ERROR ONLY COLINEAR POINTS
             printf("incCreateBihedron - colinear points");
             exit(0);
         }
     }
-    IncVertex *v1 = v0->next;
-    IncVertex *v2 = v1->next;
+    IncVertex<S> *v1 = v0->next;
+    IncVertex<S> *v2 = v1->next;
     
-    IncFace *f0, *f1;
+    IncFace<S> *f0, *f1;
     f0 = f1 = nullptr;
     
-    f0 = incMakeFace(v0, v1, v2, f1);
-    f1 = incMakeFace(v2, v1, v0, f0);
+    f0 = incMakeFace(incContext, v0, v1, v2, f1);
+    f1 = incMakeFace(incContext, v2, v1, v0, f0);
     
     f0->edge[0]->adjFace[1] = f1;
     f0->edge[1]->adjFace[1] = f1;
@@ -374,14 +439,11 @@ void incCreateBihedron()
     f1->edge[1]->adjFace[1] = f0;
     f1->edge[2]->adjFace[1] = f0;
     
-    f0->normal = incComputeFaceNormal(f0);
-    f1->normal = incComputeFaceNormal(f1);
-    
     v0->isProcessed = true;
     v1->isProcessed = true;
     v2->isProcessed = true;
     
-    IncVertex *v3 = v2->next;
+    IncVertex<S> *v3 = v2->next;
     bool coplanar = incIsPointCoplanar(f0, v3);
     while (coplanar)
     {
@@ -394,15 +456,16 @@ void incCreateBihedron()
         }
         coplanar = incIsPointCoplanar(f0, v3);
     }
-    incVertices = v3;
+    incContext.vertices = v3;
 }
 
-void incEnforceCounterClockWise(IncFace *newFace, IncEdge *e, IncVertex *v)
+template <typename S>
+void incEnforceCounterClockWise(IncFace<S> *newFace, IncEdge<S> *e, IncVertex<S> *v)
 {
     //From Computational Geometry in C page 136
     //We are applying the orientation of the face we are replacing. As we are on the horizon edge, one face is visible, while one is not.
     //As we are creating a new face above the old face, they have two points in common, and the orientation will be the same
-    IncFace *visibleFace;
+    IncFace<S> *visibleFace;
     if (e->adjFace[0]->isVisible)
     {
         visibleFace = e->adjFace[0];
@@ -433,44 +496,42 @@ void incEnforceCounterClockWise(IncFace *newFace, IncEdge *e, IncVertex *v)
         //this swap is just for consistency, it is not exactly necessary to enforce counter clockwise orientation for edges.
         //in incMakeConeFace, we set e as edge[0], edge[1] is based on endPoint[0], and edge[2] on endPoint[1].
         //if e goes from left to right, then edge[1] should be based on endPoint[1] and edge[2] on endPoint[0] to ensure counter clockwise of edges as well
-        IncEdge *temp = newFace->edge[1];
+        IncEdge<S> *temp = newFace->edge[1];
         newFace->edge[1] = newFace->edge[2];
         newFace->edge[2] = temp;
     }
     newFace->vertex[2] = v;
 }
 
-IncFace *incMakeConeFace(IncEdge *e, IncVertex *v)
+template <typename S>
+IncFace<S> *incMakeConeFace(IncContext<S> &incContext, IncEdge<S> *e, IncVertex<S> *v)
 {
     //duplicate is commented in compgeoC book 135
     //since we create faces to v in arbitrary order, we let vertices on hull know about the edge of the new face that it is endpoint for
     //if neighbor face is created we copy edge info from that one. If neighbor face is not created yet, duplicate is null and we create new edges for that
-    IncEdge *newEdge1 = e->endPoints[0]->duplicate;
+    IncEdge<S> *newEdge1 = e->endPoints[0]->duplicate;
     if (!newEdge1)
     {
-        newEdge1 = incCreateNullEdge();
+        newEdge1 = incCreateNullEdge(incContext);
         newEdge1->endPoints[0] = e->endPoints[0];
         newEdge1->endPoints[1] = v;
         e->endPoints[0]->duplicate = newEdge1;
     }
     
-    IncEdge *newEdge2 = e->endPoints[1]->duplicate;
+    IncEdge<S> *newEdge2 = e->endPoints[1]->duplicate;
     if (!newEdge2)
     {
-        newEdge2 = incCreateNullEdge();
+        newEdge2 = incCreateNullEdge(incContext);
         newEdge2->endPoints[0] = e->endPoints[1];
         newEdge2->endPoints[1] = v;
         e->endPoints[1]->duplicate = newEdge2;
     }
     
-    IncFace *newFace = incCreateNullFace();
+    IncFace<S> *newFace = incCreateNullFace(incContext);
     newFace->edge[0] = e;
     newFace->edge[1] = newEdge1;
     newFace->edge[2] = newEdge2;
     incEnforceCounterClockWise(newFace, e, v);
-    auto c = newFace->vertex[0]->position + newFace->vertex[1]->position + newFace->vertex[2]->position;
-    newFace->centerPoint = glm::vec3((coord_t)c.x / 3.0, (coord_t)c.y / 3.0, (coord_t)c.z / 3.0);
-    newFace->normal = incComputeFaceNormal(newFace);
     
     if (!newEdge1->adjFace[0])
     {
@@ -491,15 +552,16 @@ IncFace *incMakeConeFace(IncEdge *e, IncVertex *v)
     return newFace;
 }
 
-std::pair<std::vector<IncFace *>, std::vector<IncEdge *>> incAddToHull(IncVertex *v, IncContext &incContext)
+template <typename S>
+std::pair<std::vector<IncFace<S> *>, std::vector<IncEdge<S> *>> incAddToHull(IncVertex<S> *v, IncContext<S> &incContext)
 {
-    std::vector<IncFace *> facesToRemove;
-    std::vector<IncEdge *> horizonEdges;
+    std::vector<IncFace<S> *> facesToRemove;
+    std::vector<IncEdge<S> *> horizonEdges;
     bool visible = false;
-    std::vector<IncArc> vConflicts;
+    std::vector<IncArc<S>> vConflicts;
     std::copy(v->arcs.begin(), v->arcs.end(), std::back_inserter(vConflicts));
     
-    for (IncArc &arc : vConflicts)
+    for (IncArc<S> &arc : vConflicts)
     {
         arc.faceEndpoint->isVisible = visible = true;
     }
@@ -508,17 +570,17 @@ std::pair<std::vector<IncFace *>, std::vector<IncEdge *>> incAddToHull(IncVertex
         //No faces are visible and we are inside hull. No arcs to update
         v->isOnHull = false;
         v->isRemoved = true;
-        //clear(v->arcs);
+        clear(v->arcs);
         v->isProcessed = true;
-        incRemoveFromHead(&incVertices, &v);
-        std::pair<std::vector<IncFace *>, std::vector<IncEdge *>> cleaningBundle(facesToRemove, horizonEdges);
+        incRemoveFromHead(&incContext.vertices, &v);
+        std::pair<std::vector<IncFace<S> *>, std::vector<IncEdge<S> *>> cleaningBundle(facesToRemove, horizonEdges);
         return cleaningBundle;
     }
     
-    IncEdge *e;
-    for (IncArc arc : vConflicts)
+    IncEdge<S> *e;
+    for (IncArc<S> arc : vConflicts)
     {
-        IncFace *face = arc.faceEndpoint;
+        IncFace<S> *face = arc.faceEndpoint;
         //since two faces can share an edge, we could go through all edges twice (although it fails fast). Discussion?
         for (int i = 0; i < 3; i++)
         {
@@ -531,7 +593,7 @@ std::pair<std::vector<IncFace *>, std::vector<IncEdge *>> incAddToHull(IncVertex
                 {
                     incContext.failed = true;
                     printf("FAILED INC\n");
-                    std::pair<std::vector<IncFace *>, std::vector<IncEdge *>> cleaningBundle(facesToRemove, horizonEdges);
+                    std::pair<std::vector<IncFace<S> *>, std::vector<IncEdge<S> *>> cleaningBundle(facesToRemove, horizonEdges);
                     return cleaningBundle;
                 }
                 if (e->adjFace[0]->isVisible && e->adjFace[1]->isVisible)
@@ -542,10 +604,13 @@ std::pair<std::vector<IncFace *>, std::vector<IncEdge *>> incAddToHull(IncVertex
                 else if (e->adjFace[0]->isVisible || e->adjFace[1]->isVisible)
                 {
                     //only one is visible: border edge, erect face for cone
-                    e->newFace = incMakeConeFace(e, v);
+                    e->newFace = incMakeConeFace(incContext, e, v);
                     
                     //OPTIMIZE THIS!!!
-                    incInitConflictListForFace(e->newFace, e->adjFace[0], e->adjFace[1]);
+                    {
+                        TIME_PHASE(incContext.processingState.phases, IncPhase_ConflictRebuild);
+                        incInitConflictListForFace(incContext, e->newFace, e->adjFace[0], e->adjFace[1]);
+                    }
                     
                     horizonEdges.push_back(e);
                 }
@@ -555,16 +620,17 @@ std::pair<std::vector<IncFace *>, std::vector<IncEdge *>> incAddToHull(IncVertex
     }
     
     v->isProcessed = true;
-    incProcessedVertices++;    
-    std::pair<std::vector<IncFace *>, std::vector<IncEdge *>> cleaningBundle(facesToRemove, horizonEdges);
+    incContext.processingState.processedVertices++;
+    std::pair<std::vector<IncFace<S> *>, std::vector<IncEdge<S> *>> cleaningBundle(facesToRemove, horizonEdges);
     return cleaningBundle;
 }
 
-void incCleanEdgesAndFaces(std::vector<IncFace *> &facesToRemove, std::vector<IncEdge *> &horizonEdges)
+template <typename S>
+void incCleanEdgesAndFaces(IncContext<S> &incContext, std::vector<IncFace<S> *> &facesToRemove, std::vector<IncEdge<S> *> &horizonEdges)
 {
     //replace the pointer to the newly created face. no need to go through all edges
     //send horizon edges to this one. Loop over them.
-    for (IncEdge *horizonEdge : horizonEdges)
+    for (IncEdge<S> *horizonEdge : horizonEdges)
     {
         if (horizonEdge->newFace)
         {
@@ -581,45 +647,47 @@ void incCleanEdgesAndFaces(std::vector<IncFace *> &facesToRemove, std::vector<In
         horizonEdge->endPoints[0]->isOnHull = horizonEdge->endPoints[1]->isOnHull = true;
     }
     int i;
-    for (IncFace *face : facesToRemove)
+    for (IncFace<S> *face : facesToRemove)
     {
         for (i = 0; i < 3; i++)
         {
-            IncEdge *e = face->edge[i];
+            IncEdge<S> *e = face->edge[i];
             if (e && !e->isRemoved && e->shouldBeRemoved)
             {
                 //no idea why this works
                 e->isRemoved = true;
-                incRemoveFromHead(&incEdges, &e);
+                incRemoveFromHead(&incContext.edges, &e);
             }
             
-            IncVertex *v = face->vertex[i];
+            IncVertex<S> *v = face->vertex[i];
             if (v && !v->isRemoved && !v->isOnHull)
             {
                 v->isRemoved = true;
-                //clear(v->arcs);
-                incRemoveFromHead(&incVertices, &v);
+                clear(v->arcs);
+                incRemoveFromHead(&incContext.vertices, &v);
             }
         }
-        //clear(face->arcs);
-        incRemoveFromHead(&incFaces, &face);
+        clear(face->arcs);
+        incRemoveFromHead(&incContext.faces, &face);
     }
     //reset vertex flags
-    for (IncEdge *horizonEdge : horizonEdges)
+    for (IncEdge<S> *horizonEdge : horizonEdges)
     {
         horizonEdge->endPoints[0]->isOnHull = horizonEdge->endPoints[1]->isOnHull = false;
         horizonEdge->endPoints[0]->duplicate = horizonEdge->endPoints[1]->duplicate = nullptr;
     }
 }
 
-void incCleanStuff(std::pair<std::vector<IncFace *>, std::vector<IncEdge *>> &cleaningBundle)
+template <typename S>
+void incCleanStuff(IncContext<S> &incContext, std::pair<std::vector<IncFace<S> *>, std::vector<IncEdge<S> *>> &cleaningBundle)
 {
     //    auto timerCleanEdgesAndFaces = startTimer();
     incCleanConflictGraph(cleaningBundle.first);
-    incCleanEdgesAndFaces(cleaningBundle.first, cleaningBundle.second);
+    incCleanEdgesAndFaces(incContext, cleaningBundle.first, cleaningBundle.second);
 }
 
-Mesh &incConvertToMesh(IncContext &context, RenderContext &renderContext)
+template <typename S>
+Mesh &incConvertToMesh(IncContext<S> &context, RenderContext &renderContext)
 {
     if (!context.m)
     {
@@ -631,7 +699,7 @@ Mesh &incConvertToMesh(IncContext &context, RenderContext &renderContext)
     context.m->scale = glm::vec3(globalScale);
     context.m->dirty = true;
     
-    IncFace *f = incFaces;
+    IncFace<S> *f = context.faces;
     if (f)
     {
         do
@@ -640,167 +708,610 @@ Mesh &incConvertToMesh(IncContext &context, RenderContext &renderContext)
             for (int i = 0; i < 3; i++)
             {
                 Vertex newVertex = {};
-                newVertex.position = f->vertex[i]->position;
+                newVertex.position = glm::vec3(f->vertex[i]->position);
                 newVertex.vertexIndex = f->vertex[i]->vIndex;
                 addToList(newFace.vertices, newVertex);
             }
             newFace.faceColor = rgb(163, 71, 255);
             newFace.faceColor.w = 0.5f;
-            newFace.faceNormal = f->normal;
-            newFace.centerPoint = f->centerPoint;
+            newFace.faceNormal = glm::vec3(incComputeFaceNormal(f));
+            newFace.centerPoint = glm::vec3((f->vertex[0]->position + f->vertex[1]->position + f->vertex[2]->position) / (S)3);
             context.m->faces.push_back(newFace);
             
             f = f->next;
-        } while (f != incFaces);
+        } while (f != context.faces);
     }
     
     return *context.m;
 }
 
-void incInitConflictLists()
+// Writes the finished hull to result, see HullResultFlags for flags
+template <typename S>
+void incExtractResult(IncContext<S> &context, HullResult<S> &result, int flags)
+{
+    hullResultBegin(result, flags, context.numberOfPoints, (size_t)context.processingState.facesOnHull);
+    IncFace<S> *f = context.faces;
+    if (f)
+    {
+        do
+        {
+            int inputIndex[3] = {};
+            const position_t<S> *position[3] = {};
+            for (int i = 0; i < 3; i++)
+            {
+                inputIndex[i] = f->vertex[i]->vIndex;
+                position[i] = &f->vertex[i]->position;
+            }
+            hullResultAddFace(result, inputIndex, position);
+            
+            f = f->next;
+        } while (f != context.faces);
+    }
+}
+
+template <typename S>
+void incInitConflictLists(IncContext<S> &incContext)
 {
     //determine which of the points can see which of the two faces - linear time
     //for each point - positive side of one face, also if coplanar
-    IncVertex *v = incVertices;
-    IncVertex *nextVertex;
-    IncFace *f1 = incFaces;
-    IncFace *f2 = incFaces->next;
+    IncVertex<S> *v = incContext.vertices;
+    IncVertex<S> *nextVertex;
+    IncFace<S> *f1 = incContext.faces;
+    IncFace<S> *f2 = incContext.faces->next;
     int i = 0;
     do
     {
         i++;
         nextVertex = v->next;
         
-        IncFace *conflictFace = incIsPointOnPositiveSide(f1, v) ? f1 : f2;
-        IncArc arcToFace = {};
+        IncFace<S> *conflictFace = incIsPointOnPositiveSide(incContext, f1, v) ? f1 : f2;
+        IncArc<S> arcToFace = {};
         arcToFace.faceEndpoint = conflictFace;
         arcToFace.indexInEndpoint = conflictFace->arcs.size;
         addToList(v->arcs, arcToFace);
         
-        IncArc arcToVertex = {};
+        IncArc<S> arcToVertex = {};
         arcToVertex.vertexEndpoint = v;
         arcToVertex.indexInEndpoint = v->arcs.size - 1;
         addToList(conflictFace->arcs, arcToVertex);
         
         v = nextVertex;
-    } while (v != incVertices);
+    } while (v != incContext.vertices);
 }
 
-void incConstructFullHull(IncContext &incContext)
+template <typename S>
+void incConstructFullHull(IncContext<S> &incContext)
 {
-    
-    incCreateBihedron();
-    incInitConflictLists();
-    IncVertex *v = incVertices;
-    IncVertex *nextVertex;
+    auto &phases = incContext.processingState.phases;
+    {
+        TIME_PHASE(phases, IncPhase_ConflictInit);
+        incCreateBihedron(incContext);
+        incInitConflictLists(incContext);
+    }
+    IncVertex<S> *v = incContext.vertices;
+    IncVertex<S> *nextVertex;
     do
     {
         nextVertex = v->next;
         if (!v->isProcessed)
         {
-            std::pair<std::vector<IncFace *>, std::vector<IncEdge *>> cleaningBundle = incAddToHull(v, incContext);
+            std::pair<std::vector<IncFace<S> *>, std::vector<IncEdge<S> *>> cleaningBundle;
+            {
+                TIME_PHASE(phases, IncPhase_Cone);
+                cleaningBundle = incAddToHull(v, incContext);
+            }
             if (incContext.failed)
             {
                 return;
             }
             //v->isProcessed = true;
-            incCleanStuff(cleaningBundle);
+            TIME_PHASE(phases, IncPhase_Cleanup);
+            incCleanStuff(incContext, cleaningBundle);
         }
         v = nextVertex;
-    } while (v != incVertices);
+    } while (v != incContext.vertices);
+    
+    //the rebuild is timed inside incAddToHull
+    phases.times[IncPhase_Cone] -= phases.times[IncPhase_ConflictRebuild];
     
-    // add counters to context
-    incContext.processingState.createdFaces = incCreatedFaces;
-    incContext.processingState.processedVertices = incProcessedVertices;
-    incContext.processingState.sidednessQueries = incSidednessQueries;
-    v = incVertices;
+    // count what is left on the hull
+    v = incContext.vertices;
     do
     {
-        incVerticesOnHull++;
+        incContext.processingState.verticesOnHull++;
         v = v->next;
-    } while (v != incVertices);
-    incContext.processingState.verticesOnHull = incVerticesOnHull;
-    IncFace *f = incFaces;
+    } while (v != incContext.vertices);
+    IncFace<S> *f = incContext.faces;
     do
     {
-        incFacesOnHull++;
+        incContext.processingState.facesOnHull++;
         f = f->next;
-    } while (f != incFaces);
-    incContext.processingState.facesOnHull = incFacesOnHull;
+    } while (f != incContext.faces);
 }
 
-void incInitStepHull()
+template <typename S>
+void incInitStepHull(IncContext<S> &incContext)
 {
-    incCreateBihedron();
-    incInitConflictLists();
-    currentStepVertex = incVertices;
+    incCreateBihedron(incContext);
+    incInitConflictLists(incContext);
+    incContext.currentStepVertex = incContext.vertices;
 }
 
-void incHullStep(IncContext &incContext)
+template <typename S>
+void incHullStep(IncContext<S> &incContext)
 {
-    IncVertex *nextVertex;
+    auto &currentStepVertex = incContext.currentStepVertex;
+    IncVertex<S> *nextVertex;
     nextVertex = currentStepVertex->next;
     if (!currentStepVertex->isProcessed)
     {
-        std::pair<std::vector<IncFace *>, std::vector<IncEdge *>> cleaningBundle = incAddToHull(currentStepVertex, incContext);
+        std::pair<std::vector<IncFace<S> *>, std::vector<IncEdge<S> *>> cleaningBundle = incAddToHull(currentStepVertex, incContext);
         if (incContext.failed)
         {
             return;
         }
         currentStepVertex->isProcessed = true;
-        incCleanStuff(cleaningBundle);
+        incCleanStuff(incContext, cleaningBundle);
     }
     currentStepVertex = nextVertex;
 }
 
-void incInitializeContext(IncContext &incContext, Vertex *vertices, int numberOfPoints)
+//Growing a finished hull. After incConstructFullHull only the hull is left in the context and the
+//conflict graph is empty. New points are located on the hull by a walk, get arcs to every face they
+//see and then go through incAddToHull like in the full construction. So the conflict graph only ever
+//holds the points of one batch, and a batch costs its walks plus the faces it changes, not the size
+//of the hull. Points inside the hull are dropped after their walk.
+
+template <typename S>
+static IncEdge<S> *incEdgeBetween(IncFace<S> *f, IncVertex<S> *a, IncVertex<S> *b)
 {
-    //counter reset
-    incContext.failed = false;
-    incCreatedFaces = 0;
-    incProcessedVertices = 3;
-    incSidednessQueries = 0;
-    incVerticesOnHull = 0;
-    incFacesOnHull = 0;
+    for (int i = 0; i < 3; i++)
+    {
+        IncEdge<S> *e = f->edge[i];
+        if ((e->endPoints[0] == a && e->endPoints[1] == b) || (e->endPoints[0] == b && e->endPoints[1] == a))
+        {
+            return e;
+        }
+    }
+    return nullptr;
+}
+
+template <typename S>
+static IncFace<S> *incNeighbourAcross(IncFace<S> *f, IncVertex<S> *a, IncVertex<S> *b)
+{
+    IncEdge<S> *e = incEdgeBetween(f, a, b);
+    if (!e)
+    {
+        return nullptr;
+    }
+    return e->adjFace[0] == f ? e->adjFace[1] : e->adjFace[0];
+}
+
+//Walks over the hull as seen from the interior point towards p and returns the face the ray from the
+//interior point to p leaves the hull through. Steps to the neighbour behind the first edge p lies beyond.
+//Which edge is tried first is random, a fixed order can cycle on some triangulations.
+template <typename S>
+static IncFace<S> *incLocate(IncContext<S> &incContext, IncFace<S> *start, const position_t<S> &p)
+{
+    auto &o = incContext.interiorPoint;
+    IncFace<S> *f = start;
+    while (f)
+    {
+        incContext.walkState = incContext.walkState * 6364136223846793005ull + 1442695040888963407ull;
+        int first = (int)((incContext.walkState >> 33) % 3);
+        IncFace<S> *next = nullptr;
+        for (int k = 0; k < 3 && !next; k++)
+        {
+            int i = (first + k) % 3;
+            IncVertex<S> *a = f->vertex[i];
+            IncVertex<S> *b = f->vertex[(i + 1) % 3];
+            //the face's third vertex is on the negative side of the plane through o, a and b
+            if (orient3d(o, a->position, b->position, p) > 0.0)
+            {
+                next = incNeighbourAcross(f, a, b);
+            }
+        }
+        if (!next)
+        {
+            return f;
+        }
+        f = next;
+    }
+    return f;
+}
+
+//Gives v arcs to all faces it sees, found by a flood fill from seen. The visible faces of a convex hull
+//are connected. isVisible marks the faces already taken and is reset before returning.
+template <typename S>
+static void incInitConflictsFrom(IncContext<S> &incContext, IncVertex<S> *v, IncFace<S> *seen, std::vector<IncFace<S> *> &stack)
+{
+    seen->isVisible = true;
+    stack.push_back(seen);
+    while (!stack.empty())
+    {
+        IncFace<S> *f = stack.back();
+        stack.pop_back();
+        
+        IncArc<S> arcToFace = {};
+        arcToFace.faceEndpoint = f;
+        arcToFace.indexInEndpoint = f->arcs.size;
+        addToList(v->arcs, arcToFace);
+        
+        IncArc<S> arcToVertex = {};
+        arcToVertex.vertexEndpoint = v;
+        arcToVertex.indexInEndpoint = v->arcs.size - 1;
+        addToList(f->arcs, arcToVertex);
+        
+        for (int i = 0; i < 3; i++)
+        {
+            IncEdge<S> *e = f->edge[i];
+            IncFace<S> *neighbour = e->adjFace[0] == f ? e->adjFace[1] : e->adjFace[0];
+            if (!neighbour->isVisible && incIsPointOnPositiveSide(incContext, neighbour, v))
+            {
+                neighbour->isVisible = true;
+                stack.push_back(neighbour);
+            }
+        }
+    }
+    for (IncArc<S> &arc : v->arcs)
+    {
+        arc.faceEndpoint->isVisible = false;
+    }
+}
+
+//Sets the interior point the walks start from to the mean of the hull's vertices
+template <typename S>
+void incUpdateInteriorPoint(IncContext<S> &incContext)
+{
+    position_t<S> sum = position_t<S>(0);
+    int n = 0;
+    IncFace<S> *f = incContext.faces;
+    do
+    {
+        sum += f->vertex[0]->position + f->vertex[1]->position + f->vertex[2]->position;
+        n += 3;
+        f = f->next;
+    } while (f != incContext.faces);
+    incContext.interiorPoint = sum / (S)n;
+    if (!incContext.hasInteriorPoint)
+    {
+        incContext.walkState = incContext.seed;
+    }
+    incContext.hasInteriorPoint = true;
+}
+
+//Adds count points to the finished hull in incContext, with the given input indices.
+//Check incContext.failed afterwards.
+template <typename S>
+void incInsertPoints(IncContext<S> &incContext, const position_t<S> *positions, const int *inputIndices, int count)
+{
+    if (incContext.failed || !incContext.faces || count <= 0)
+    {
+        return;
+    }
+    
+    if (!incContext.hasInteriorPoint)
+    {
+        //stays inside as the hull grows
+        incUpdateInteriorPoint(incContext);
+    }
+    
+    auto &phases = incContext.processingState.phases;
+    std::vector<IncVertex<S> *> pending;
+    {
+        TIME_PHASE(phases, IncPhase_ConflictInit);
+        //each walk starts where the last one ended, so the batch is located in Z-order
+        position_t<S> min = positions[0];
+        position_t<S> max = min;
+        for (int i = 1; i < count; i++)
+        {
+            min = glm::min(min, positions[i]);
+            max = glm::max(max, positions[i]);
+        }
+        std::vector<unsigned long long> order((size_t)count);
+        for (int i = 0; i < count; i++)
+        {
+            order[i] = ((unsigned long long)mortonCode(positions[i], min, max) << 32) | (unsigned int)i;
+        }
+        std::sort(order.begin(), order.end());
+        
+        std::vector<IncFace<S> *> stack;
+        IncFace<S> *start = incContext.faces->prev;
+        for (auto key : order)
+        {
+            int i = (int)(key & 0xffffffffull);
+            auto &position = positions[i];
+            IncFace<S> *seen = incLocate(incContext, start, position);
+            start = seen;
+            if (!seen || orient3d(seen->vertex[0]->position, seen->vertex[1]->position, seen->vertex[2]->position, position) >= 0.0)
+            {
+                continue;
+            }
+            
+            IncVertex<S> *v = (IncVertex<S> *)memAlloc(sizeof(IncVertex<S>));
+            v->duplicate = nullptr;
+            v->isOnHull = false;
+            v->isProcessed = false;
+            v->isRemoved = false;
+            v->isAlreadyInConflicts = false;
+            v->vIndex = inputIndices[i];
+            v->position = position;
+            init(v->arcs);
+            incInitConflictsFrom(incContext, v, seen, stack);
+            incAddToHead(&incContext.vertices, v);
+            pending.push_back(v);
+        }
+    }
+    
+    //random insertion order, like the full construction
+    for (int i = (int)pending.size() - 1; i > 0; i--)
+    {
+        incContext.walkState = incContext.walkState * 6364136223846793005ull + 1442695040888963407ull;
+        std::swap(pending[i], pending[(size_t)((incContext.walkState >> 33) % (unsigned long long)(i + 1))]);
+    }
+    
+    auto createdFaces = incContext.processingState.createdFaces;
+    auto removedFaces = 0;
+    auto rebuildTime = phases.times[IncPhase_ConflictRebuild];
+    for (IncVertex<S> *v : pending)
+    {
+        std::pair<std::vector<IncFace<S> *>, std::vector<IncEdge<S> *>> cleaningBundle;
+        {
+            TIME_PHASE(phases, IncPhase_Cone);
+            cleaningBundle = incAddToHull(v, incContext);
+        }
+        if (incContext.failed)
+        {
+            return;
+        }
+        removedFaces += (int)cleaningBundle.first.size();
+        TIME_PHASE(phases, IncPhase_Cleanup);
+        incCleanStuff(incContext, cleaningBundle);
+    }
+    //the rebuild is timed inside incAddToHull
+    phases.times[IncPhase_Cone] -= phases.times[IncPhase_ConflictRebuild] - rebuildTime;
+    
+    //a closed triangulated hull has two faces per vertex, less four
+    incContext.processingState.facesOnHull += incContext.processingState.createdFaces - createdFaces - removedFaces;
+    incContext.processingState.verticesOnHull = incContext.processingState.facesOnHull / 2 + 2;
+}
+
+//Adds count points to the finished hull in incContext. They get the input indices numberOfPoints and
+//up, in order. Check incContext.failed afterwards.
+template <typename S>
+void incInsertPoints(IncContext<S> &incContext, Vertex *points, int count)
+{
+    std::vector<position_t<S>> positions((size_t)Max(count, 0));
+    std::vector<int> inputIndices((size_t)Max(count, 0));
+    for (int i = 0; i < count; i++)
+    {
+        positions[i] = position_t<S>(points[i].position);
+        inputIndices[i] = incContext.numberOfPoints + i;
+    }
+    incInsertPoints(incContext, positions.data(), inputIndices.data(), count);
+    incContext.numberOfPoints += count;
+}
+
+//Removing a vertex from a finished hull. The faces away from the vertex stay, only its star is
+//replaced, by the faces of the hull of its neighbours (its link) that the removed vertex sees. Those
+//are found by clipping ears off the link polygon: an ear is one of them if no link vertex is outside
+//of it. Points that were hidden under the star are not looked at, the caller inserts them again.
+
+//Finds the hull vertex with the given input index at position. Returns a face of it and its corner in
+//corner, or nullptr if the point is not a vertex of the hull.
+template <typename S>
+IncFace<S> *incFindHullVertex(IncContext<S> &incContext, const position_t<S> &position, int inputIndex, int &corner)
+{
+    if (incContext.failed || !incContext.faces)
+    {
+        return nullptr;
+    }
+    if (!incContext.hasInteriorPoint)
+    {
+        incUpdateInteriorPoint(incContext);
+    }
+    
+    //the ray towards a vertex leaves the hull through the vertex, so the walk ends on a face of it
+    IncFace<S> *f = incLocate(incContext, incContext.faces->prev, position);
+    for (corner = 0; f && corner < 3; corner++)
+    {
+        if (f->vertex[corner]->vIndex == inputIndex)
+        {
+            return f;
+        }
+    }
+    return nullptr;
+}
+
+//Removes the vertex at corner of face from the hull and appends the faces that now cover its place
+//to patch. Sets incContext.failed if the hole can't be closed, which takes a degenerate hull.
+template <typename S>
+void incRemoveHullVertex(IncContext<S> &incContext, IncFace<S> *face, int corner, std::vector<IncFace<S> *> &patch)
+{
+    IncVertex<S> *v = face->vertex[corner];
+    
+    //star faces in counter clockwise order around v, star[k] is (v, link[k], link[k + 1])
+    std::vector<IncFace<S> *> star;
+    std::vector<IncVertex<S> *> link;
+    std::vector<IncEdge<S> *> linkEdges;
+    std::vector<IncEdge<S> *> spokes;
+    IncFace<S> *f = face;
+    do
+    {
+        int i = 0;
+        while (f->vertex[i] != v)
+        {
+            i++;
+        }
+        IncVertex<S> *b = f->vertex[(i + 1) % 3];
+        IncVertex<S> *c = f->vertex[(i + 2) % 3];
+        star.push_back(f);
+        link.push_back(b);
+        linkEdges.push_back(incEdgeBetween(f, b, c));
+        spokes.push_back(incEdgeBetween(f, v, b));
+        f = incNeighbourAcross(f, v, c);
+    } while (f && f != face && star.size() <= (size_t)incContext.processingState.facesOnHull);
     
-    if (incVertices)
+    if (f != face || link.size() < 3)
     {
-        IncVertex *v = incVertices->next;
-        IncVertex *nextVertex;
-        while (incVertices)
+        incContext.failed = true;
+        return;
+    }
+    
+    auto removed = v->position;
+    for (size_t k = 0; k < star.size(); k++)
+    {
+        IncEdge<S> *e = linkEdges[k];
+        e->adjFace[e->adjFace[0] == star[k] ? 0 : 1] = nullptr;
+        incRemoveFromHead(&incContext.edges, &spokes[k]);
+        clear(star[k]->arcs);
+        incRemoveFromHead(&incContext.faces, &star[k]);
+    }
+    clear(v->arcs);
+    incRemoveFromHead(&incContext.vertices, &v);
+    
+    //link edge k runs from link[k] to link[k + 1] and has one open side
+    while (link.size() >= 3)
+    {
+        auto n = link.size();
+        size_t ear = n;
+        for (size_t k = 0; k < n && ear == n; k++)
+        {
+            auto &a = link[(k + n - 1) % n]->position;
+            auto &b = link[k]->position;
+            auto &c = link[(k + 1) % n]->position;
+            if (orient3d(a, b, c, removed) > 0.0 || (n > 3 && incColinear(link[(k + n - 1) % n], link[k], link[(k + 1) % n])))
+            {
+                continue;
+            }
+            
+            bool isFace = true;
+            for (size_t j = 0; j < n && isFace; j++)
+            {
+                if (j != k && j != (k + n - 1) % n && j != (k + 1) % n)
+                {
+                    isFace = orient3d(a, b, c, link[j]->position) >= 0.0;
+                }
+            }
+            if (isFace)
+            {
+                ear = k;
+            }
+        }
+        if (ear == n)
+        {
+            incContext.failed = true;
+            return;
+        }
+        
+        auto previous = (ear + n - 1) % n;
+        auto next = (ear + 1) % n;
+        IncEdge<S> *closing;
+        if (n > 3)
+        {
+            closing = incCreateNullEdge(incContext);
+            closing->endPoints[0] = link[next];
+            closing->endPoints[1] = link[previous];
+        }
+        else
+        {
+            closing = linkEdges[next];
+        }
+        
+        IncFace<S> *newFace = incCreateNullFace(incContext);
+        newFace->vertex[0] = link[previous];
+        newFace->vertex[1] = link[ear];
+        newFace->vertex[2] = link[next];
+        newFace->edge[0] = linkEdges[previous];
+        newFace->edge[1] = linkEdges[ear];
+        newFace->edge[2] = closing;
+        for (int i = 0; i < 3; i++)
+        {
+            IncEdge<S> *e = newFace->edge[i];
+            e->adjFace[e->adjFace[0] ? 1 : 0] = newFace;
+        }
+        patch.push_back(newFace);
+        
+        if (n == 3)
+        {
+            break;
+        }
+        linkEdges[previous] = closing;
+        link.erase(link.begin() + ear);
+        linkEdges.erase(linkEdges.begin() + ear);
+    }
+    
+    incContext.processingState.facesOnHull -= 2;
+    incContext.processingState.verticesOnHull -= 1;
+    
+    //the hull shrank, the walks need a point that is still inside
+    for (IncFace<S> *patchFace : patch)
+    {
+        if (incContext.hasInteriorPoint && orient3d(patchFace->vertex[0]->position, patchFace->vertex[1]->position, patchFace->vertex[2]->position, incContext.interiorPoint) <= 0.0)
+        {
+            incUpdateInteriorPoint(incContext);
+            break;
+        }
+    }
+}
+
+// Frees the vertices, edges and faces left over from the last run
+template <typename S>
+void incFreeContext(IncContext<S> &incContext)
+{
+    if (incContext.vertices)
+    {
+        IncVertex<S> *v = incContext.vertices->next;
+        IncVertex<S> *nextVertex;
+        while (incContext.vertices)
         {
             nextVertex = v->next;
-            //clear(v->arcs);
-            incRemoveFromHead(&incVertices, &v);
+            clear(v->arcs);
+            incRemoveFromHead(&incContext.vertices, &v);
             v = nextVertex;
         };
     }
     
-    if (incFaces)
+    if (incContext.faces)
     {
-        IncFace *f = incFaces->next;
-        IncFace *nextFace;
-        while (incFaces)
+        IncFace<S> *f = incContext.faces->next;
+        IncFace<S> *nextFace;
+        while (incContext.faces)
         {
             nextFace = f->next;
-            //clear(f->arcs);
-            incRemoveFromHead(&incFaces, &f);
+            clear(f->arcs);
+            incRemoveFromHead(&incContext.faces, &f);
             f = nextFace;
         };
     }
-    if (incEdges)
+    if (incContext.edges)
     {
-        IncEdge *e = incEdges->next;
-        IncEdge *nextEdge;
-        while (incEdges)
+        IncEdge<S> *e = incContext.edges->next;
+        IncEdge<S> *nextEdge;
+        while (incContext.edges)
         {
             nextEdge = e->next;
-            incRemoveFromHead(&incEdges, &e);
+            incRemoveFromHead(&incContext.edges, &e);
             e = nextEdge;
         }
     }
+    incContext.currentStepVertex = nullptr;
+    incContext.initialized = false;
+}
+
+template <typename S, typename P>
+void incInitializeContext(IncContext<S> &incContext, P *vertices, int numberOfPoints, unsigned long long seed = 0)
+{
+    //counter reset
+    incContext.failed = false;
+    incContext.processingState = {};
+    incContext.processingState.processedVertices = 3;
+    
+    incFreeContext(incContext);
     
-    incCopyVertices(vertices, numberOfPoints);
+    incContext.seed = seed;
+    incContext.hasInteriorPoint = false;
+    incCopyVertices(incContext, vertices, numberOfPoints, seed);
     incContext.numberOfPoints = numberOfPoints;
     incContext.initialized = true;
 }
@@ -1,101 +1,234 @@
 #ifndef LIST_H
 #define LIST_H
 
+// Growable array. The first N elements live inside the list itself, so short
+// lists like the 3 vertices of a face never touch the heap. Structs holding a
+// list are copied around by value, which is why the elements are always reached
+// through data() instead of a stored pointer into the inline buffer.
+
+template<typename T, size_t N>
+struct ListInlineStorage
+{
+    T inlineElements[N];
+    
+    T *inlineData() {return this->inlineElements;}
+    const T *inlineData() const {return this->inlineElements;}
+};
+
 template<typename T>
-struct List
+struct ListInlineStorage<T, 0>
+{
+    T *inlineData() {return nullptr;}
+    const T *inlineData() const {return nullptr;}
+};
+
+template<typename T, size_t N = 0>
+struct List : ListInlineStorage<T, N>
 {
     size_t size = 0;
-    size_t capacity = 0;
-    T *list = nullptr;
+    size_t capacity = N;
+    // nullptr while the elements fit inline
+    T *heap = nullptr;
+    
+    T *data() {return this->heap ? this->heap : this->inlineData();}
+    const T *data() const {return this->heap ? this->heap : this->inlineData();}
     
     T &operator[](size_t index)
     {
         assert(index < this->size);
-        return this->list[index];
+        return this->data()[index];
     }
     
     T &operator[](int index)
     {
         assert(index < this->size);
-        return this->list[index];
+        return this->data()[index];
+    }
+    
+    const T &operator[](size_t index) const
+    {
+        assert(index < this->size);
+        return this->data()[index];
+    }
+    
+    const T &operator[](int index) const
+    {
+        assert(index < this->size);
+        return this->data()[index];
     }
     
-    T *begin() {return this->list;}
-    T *end() {return this->list + this->size;}
+    T *begin() {return this->data();}
+    T *end() {return this->data() + this->size;}
+    const T *begin() const {return this->data();}
+    const T *end() const {return this->data() + this->size;}
     
 };
 
-template<typename T>
-static void addToList(List<T> &list, T element)
+// Makes room for at least capacity elements without changing the size
+template<typename T, size_t N>
+static void reserve(List<T, N> &list, size_t capacity)
 {
-    if (list.capacity == 0)
+    if(capacity <= list.capacity)
     {
-        list.capacity = 2;
-        list.list = (T*)malloc(sizeof(T) * list.capacity);
+        return;
     }
     
-    if (list.size + 1 > list.capacity)
+    assert(capacity < SIZE_MAX / sizeof(T));
+    
+    if(list.heap)
     {
-        list.capacity *= 2;
-        list.list = (T*)realloc(list.list, sizeof(T) * list.capacity);
+        list.heap = (T*)memRealloc(list.heap, sizeof(T) * capacity);
     }
-    
-    list.list[list.size++] = element;
+    else
+    {
+        auto heap = (T*)memAlloc(sizeof(T) * capacity);
+        auto inlineElements = list.inlineData();
+        for(size_t i = 0; i < list.size; i++)
+        {
+            heap[i] = std::move(inlineElements[i]);
+        }
+        list.heap = heap;
+    }
+    list.capacity = capacity;
 }
 
-template<typename T>
-static void addToList(List<T> &list, std::initializer_list<T> elements)
+// Doubles the capacity until count more elements fit
+template<typename T, size_t N>
+static void growFor(List<T, N> &list, size_t count)
 {
-    if(list.capacity == 0)
+    auto needed = list.size + count;
+    if(needed <= list.capacity)
     {
-        list.capacity = (size_t)(pow(elements.size(), log2(elements.size())));
-        list.list = (T*)malloc(sizeof(T) * list.capacity);
+        return;
     }
     
-    if(list.size + elements.size() > list.capacity)
+    auto capacity = list.capacity < 2 ? (size_t)2 : list.capacity;
+    while(capacity < needed)
     {
-        list.capacity = (size_t)(pow(list.size + elements.size(), log2(list.size + elements.size())));
-        list.list = (T*)realloc(list.list, sizeof(T) * list.capacity);
+        capacity *= 2;
     }
+    reserve(list, capacity);
+}
+
+template<typename T, size_t N>
+static void addToList(List<T, N> &list, T element)
+{
+    growFor(list, 1);
+    list.data()[list.size++] = std::move(element);
+}
+
+template<typename T, size_t N>
+static void addToList(List<T, N> &list, std::initializer_list<T> elements)
+{
+    growFor(list, elements.size());
     
+    auto data = list.data();
     for(auto &e : elements)
     {
-        list.list[list.size++] = e;
+        data[list.size++] = e;
     }
 }
 
-template<typename T>
-static void clear(List<T> &list, size_t capacity = 0)
+template<typename T, size_t N>
+static void addToList(List<T, N> &list, const T *elements, size_t count)
 {
-    if(list.list)
+    growFor(list, count);
+    
+    auto data = list.data();
+    for(size_t i = 0; i < count; i++)
+    {
+        data[list.size++] = elements[i];
+    }
+}
+
+// Moves all elements of source to the end of list and leaves source empty.
+// If list is empty and has nothing allocated, source's heap buffer is taken over as is.
+template<typename T, size_t N, size_t M>
+static void appendList(List<T, N> &list, List<T, M> &source)
+{
+    if(source.size == 0)
     {
-        free(list.list);
+        return;
     }
     
-    list.list = nullptr;
-    list.size = 0;
-    list.capacity = (size_t)pow(capacity, (size_t)ceil(log2(capacity)));
+    if(list.size == 0 && !list.heap && source.heap && source.capacity > N)
+    {
+        list.heap = source.heap;
+        list.capacity = source.capacity;
+        list.size = source.size;
+        
+        source.heap = nullptr;
+        source.capacity = M;
+        source.size = 0;
+        return;
+    }
+    
+    growFor(list, source.size);
     
-    if(list.capacity > 0)
+    auto data = list.data();
+    auto sourceData = source.data();
+    for(size_t i = 0; i < source.size; i++)
     {
-        list.list = (T*)malloc(sizeof(T) * list.capacity);
+        data[list.size++] = std::move(sourceData[i]);
     }
+    source.size = 0;
 }
 
-template<typename T>
-static void init(List<T> &list, size_t capacity = 0)
+// Takes the heap buffer away from list and returns it together with its capacity.
+// The list is left empty on its inline storage. Returns nullptr if there was no heap buffer.
+template<typename T, size_t N>
+static T *releaseBuffer(List<T, N> &list, size_t &capacity)
 {
-    list.size = 0;
-    list.capacity = (size_t)pow(capacity, (size_t)ceil(log2(capacity)));
+    auto heap = list.heap;
+    capacity = heap ? list.capacity : 0;
     
-    list.list = nullptr;
+    list.heap = nullptr;
+    list.size = 0;
+    list.capacity = N;
+    return heap;
+}
+
+// Makes list use a buffer from releaseBuffer with room for capacity elements
+// and moves the elements over. The list must not have a heap buffer of its own.
+template<typename T, size_t N>
+static void adoptBuffer(List<T, N> &list, T *buffer, size_t capacity)
+{
+    assert(!list.heap && capacity >= list.size);
     
-    if(list.capacity > 0)
+    auto inlineElements = list.inlineData();
+    for(size_t i = 0; i < list.size; i++)
     {
-        list.list = (T*)malloc(sizeof(T) * list.capacity);
+        buffer[i] = std::move(inlineElements[i]);
     }
+    list.heap = buffer;
+    list.capacity = capacity;
+}
+
+// Frees the list and, if capacity is given, allocates room for that many elements
+template<typename T, size_t N>
+static void clear(List<T, N> &list, size_t capacity = 0)
+{
+    if(list.heap)
+    {
+        memFree(list.heap);
+    }
+    
+    list.heap = nullptr;
+    list.size = 0;
+    list.capacity = N;
     
+    reserve(list, capacity);
 }
 
-#endif
+// Like clear, but for lists whose memory is uninitialized
+template<typename T, size_t N>
+static void init(List<T, N> &list, size_t capacity = 0)
+{
+    list.heap = nullptr;
+    list.size = 0;
+    list.capacity = N;
+    
+    reserve(list, capacity);
+}
 
+#endif
@@ -2,7 +2,10 @@
 #include <chrono>
 #include <random>
 #include <vector>
+#include <deque>
 #include <iterator>
+#include <thread>
+#include <atomic>
 #include <cstdio>
 #include <cstdlib>
 #if defined(__linux)
@@ -17,6 +20,7 @@
 
 #include <cmath>
 #include <algorithm>
+#include <unordered_map>
 
 
 // BEGIN IGNORE WARNINGS IN LIBS ON Windows
@@ -40,9 +44,14 @@
 #pragma warning(pop)
 #endif
 
+#include "memory.h"
 #include "list.h"
 #include "timing.h"
 #include "util.h"
+#include "predicates.h"
+#include "hull_result.h"
+#include "parallel.h"
+#include "perf_counters.h"
 #include "keys.h"
 
 const static float globalScale = 0.1f;
@@ -57,9 +66,14 @@ static InputState inputState;
 #include "quickhull.h"
 #include "incremental.h"
 #include "divideconquer.h"
+#include "spatial_order.h"
 
 #include "point_generator.h"
+#include "benchmark.h"
 #include "hull.h"
+#include "batch.h"
+#include "dynamic.h"
+#include "hull_query.h"
 
 void reinitPoints(Vertex **vertices, ConfigData &configData, Hull &h, RenderContext &renderContext)
 {
@@ -179,12 +193,6 @@ void renderGenAndHullType(RenderContext &renderContext, Hull &h)
 
 int main()
 {
-    auto seed = time(NULL);
-    
-    srand((unsigned int)seed);
-    
-    printf("Seed: %zd\n", seed);
-    
     RenderContext renderContext = {};
     renderContext.FoV = 45.0f;
     renderContext.position = glm::vec3(0.0f, 50.5f, 70.0f);
@@ -217,6 +225,12 @@ int main()
     ConfigData configData = {};
     loadConfig("../.config", configData, renderContext);
     
+    auto seed = configData.seed;
+    
+    srand((unsigned int)seed);
+    
+    printf("Seed: %llu\n", seed);
+    
     Hull h;
     h.vertices = nullptr;
     h.numberOfPoints = 0;
@@ -234,10 +248,8 @@ int main()
     h.currentHullType = HullType::QH;
     auto previousHullType = h.currentHullType;
     
-    std::random_device rd{};
-    std::mt19937_64 gen{rd()};
-    gen.seed((unsigned int)seed);
-    h.pointGenerator.gen = gen;
+    h.pointGenerator = {};
+    h.pointGenerator.seed = (unsigned long long)seed;
     
     int numberOfPoints;
 
@@ -260,6 +272,7 @@ int main()
     initPointGenerator(h.pointGenerator, configData.genType, numberOfPoints, 0.0, 200.0);
     
     InitializeHull(h, configData.vertices, h.pointGenerator.numberOfPoints, hullType);
+    h.autoSelect = configData.autoSelect;
     
     Mesh* currentMesh = nullptr;
     Vertex* currentVertices = configData.vertices;
@@ -321,10 +334,81 @@ int main()
             
         }
         
+        if(KeyDown(Key_B))
+        {
+            auto scalars = configData.scalars ? configData.scalars : Scalar_Float;
+            if(scalars & Scalar_Float)
+            {
+                RunBatchBenchmark<float>(renderContext.originOffset, configData.seed, "float");
+                RunParallelHullBenchmark<float>(renderContext.originOffset, configData.seed, "float");
+            }
+            if(scalars & Scalar_Double)
+            {
+                RunBatchBenchmark<double>(renderContext.originOffset, configData.seed, "double");
+                RunParallelHullBenchmark<double>(renderContext.originOffset, configData.seed, "double");
+            }
+        }
+        
+        if(KeyDown(Key_G))
+        {
+            auto scalars = configData.scalars ? configData.scalars : Scalar_Float;
+            if(scalars & Scalar_Float)
+            {
+                RunInsertionBenchmark<float>(renderContext.originOffset, configData.seed, "float");
+                RunSlidingWindowBenchmark<float>(renderContext.originOffset, configData.seed, "float");
+            }
+            if(scalars & Scalar_Double)
+            {
+                RunInsertionBenchmark<double>(renderContext.originOffset, configData.seed, "double");
+                RunSlidingWindowBenchmark<double>(renderContext.originOffset, configData.seed, "double");
+            }
+        }
+        
+        if(KeyDown(Key_V))
+        {
+            auto scalars = configData.scalars ? configData.scalars : Scalar_Float;
+            if(scalars & Scalar_Float)
+            {
+                RunQueryBenchmark<float>(renderContext.originOffset, configData.seed, "float");
+                RunSupportBenchmark<float>(renderContext.originOffset, configData.seed, "float");
+            }
+            if(scalars & Scalar_Double)
+            {
+                RunQueryBenchmark<double>(renderContext.originOffset, configData.seed, "double");
+                RunSupportBenchmark<double>(renderContext.originOffset, configData.seed, "double");
+            }
+        }
+        
+        if(KeyDown(Key_M))
+        {
+            auto scalars = configData.scalars ? configData.scalars : Scalar_Float;
+            if(scalars & Scalar_Float)
+            {
+                RunSchedulingBenchmark<float>(renderContext.originOffset, configData.seed, "float");
+                RunSpatialOrderBenchmark<float>(renderContext.originOffset, configData.seed, "float");
+                RunMemoryPolicyBenchmark<float>(renderContext.originOffset, configData.seed, "float");
+            }
+            if(scalars & Scalar_Double)
+            {
+                RunSchedulingBenchmark<double>(renderContext.originOffset, configData.seed, "double");
+                RunSpatialOrderBenchmark<double>(renderContext.originOffset, configData.seed, "double");
+                RunMemoryPolicyBenchmark<double>(renderContext.originOffset, configData.seed, "double");
+            }
+        }
+        
+        if(KeyDown(Key_K))
+        {
+            auto path = configData.autoSelectPath[0] ? configData.autoSelectPath : "../.autoselect";
+            CalibrateAutoSelect(renderContext.originOffset, configData.seed, configData.autoSelect, path);
+            h.autoSelect = configData.autoSelect;
+            h.autoResolved = false;
+        }
+        
         if(KeyDown(Key_Y))
         {
             reinitPoints(&configData.vertices, configData, h, renderContext);
             reinitHull(configData.vertices, h, &currentVertices, &currentMesh, &fullHull, &timedHull, &stepHull);
+            h.autoSelect = configData.autoSelect;
         }
         
         if(KeyDown(Key_C))
@@ -398,6 +482,12 @@ int main()
             hullType = HullType::Dac;
         }
         
+        if(KeyDown(Key_U))
+        {
+            previousHullType = hullType;
+            hullType = HullType::Auto;
+        }
+        
         if(currentMesh)
         {
             RenderMesh(renderContext, *currentMesh, configData.vertices);
@@ -0,0 +1,366 @@
+#ifndef MEMORY_H
+#define MEMORY_H
+
+// Tracked allocations for the hull data structures (List, the incremental
+// vertices/edges/faces and the D&C buffers). Every block gets a small header
+// with its size and the run it was allocated in, so the benchmark can count
+// allocations, bytes and the peak live bytes of a single run. Blocks left over
+// from earlier runs are not charged to the current one when they are freed.
+// Build with -DDISABLE_MEMORY_TRACKING to fall back to plain malloc/free.
+
+#if defined(__linux)
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+#endif
+
+struct MemoryStats
+{
+    unsigned long long allocations;
+    unsigned long long reallocations;
+    unsigned long long frees;
+    unsigned long long bytesAllocated;
+    long long liveBytes;
+    long long peakLiveBytes;
+};
+
+#ifndef DISABLE_MEMORY_TRACKING
+
+struct MemoryHeader
+{
+    size_t size;
+    unsigned long long run;
+};
+
+// 16 bytes keeps the user pointer as aligned as malloc's
+static_assert(sizeof(MemoryHeader) == 16, "MemoryHeader must keep malloc alignment");
+
+static std::atomic<unsigned long long> memoryRun(0);
+static std::atomic<unsigned long long> memoryAllocations(0);
+static std::atomic<unsigned long long> memoryReallocations(0);
+static std::atomic<unsigned long long> memoryFrees(0);
+static std::atomic<unsigned long long> memoryBytesAllocated(0);
+static std::atomic<long long> memoryLiveBytes(0);
+static std::atomic<long long> memoryPeakLiveBytes(0);
+
+static void memoryAddLive(long long bytes)
+{
+    auto live = memoryLiveBytes.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+    auto peak = memoryPeakLiveBytes.load(std::memory_order_relaxed);
+    while(live > peak && !memoryPeakLiveBytes.compare_exchange_weak(peak, live, std::memory_order_relaxed))
+    {
+    }
+}
+
+static void *memAlloc(size_t size)
+{
+    auto header = (MemoryHeader*)malloc(sizeof(MemoryHeader) + size);
+    if(!header)
+    {
+        return nullptr;
+    }
+
+    header->size = size;
+    header->run = memoryRun.load(std::memory_order_relaxed);
+
+    memoryAllocations.fetch_add(1, std::memory_order_relaxed);
+    memoryBytesAllocated.fetch_add(size, std::memory_order_relaxed);
+    memoryAddLive((long long)size);
+
+    return header + 1;
+}
+
+static void memFree(void *pointer)
+{
+    if(!pointer)
+    {
+        return;
+    }
+
+    auto header = (MemoryHeader*)pointer - 1;
+    memoryFrees.fetch_add(1, std::memory_order_relaxed);
+    if(header->run == memoryRun.load(std::memory_order_relaxed))
+    {
+        memoryAddLive(-(long long)header->size);
+    }
+    free(header);
+}
+
+static void *memRealloc(void *pointer, size_t size)
+{
+    if(!pointer)
+    {
+        return memAlloc(size);
+    }
+
+    auto oldHeader = (MemoryHeader*)pointer - 1;
+    auto oldSize = oldHeader->size;
+    auto oldRun = oldHeader->run;
+
+    auto header = (MemoryHeader*)realloc(oldHeader, sizeof(MemoryHeader) + size);
+    if(!header)
+    {
+        return nullptr;
+    }
+
+    auto run = memoryRun.load(std::memory_order_relaxed);
+    header->size = size;
+    header->run = run;
+
+    memoryReallocations.fetch_add(1, std::memory_order_relaxed);
+    memoryBytesAllocated.fetch_add(size, std::memory_order_relaxed);
+    // a block from an earlier run is charged to this one in full
+    memoryAddLive(oldRun == run ? (long long)size - (long long)oldSize : (long long)size);
+
+    return header + 1;
+}
+
+// Counts a block memAllocLarge mapped itself, returns the run it belongs to
+static unsigned long long memoryTrackAlloc(size_t size)
+{
+    memoryAllocations.fetch_add(1, std::memory_order_relaxed);
+    memoryBytesAllocated.fetch_add(size, std::memory_order_relaxed);
+    memoryAddLive((long long)size);
+    return memoryRun.load(std::memory_order_relaxed);
+}
+
+static void memoryTrackFree(size_t size, unsigned long long run)
+{
+    memoryFrees.fetch_add(1, std::memory_order_relaxed);
+    if(run == memoryRun.load(std::memory_order_relaxed))
+    {
+        memoryAddLive(-(long long)size);
+    }
+}
+
+// Starts a new run: resets the counters, and blocks allocated before this
+// point no longer count towards the live bytes.
+static void memoryBeginRun()
+{
+    memoryRun.fetch_add(1, std::memory_order_relaxed);
+    memoryAllocations.store(0, std::memory_order_relaxed);
+    memoryReallocations.store(0, std::memory_order_relaxed);
+    memoryFrees.store(0, std::memory_order_relaxed);
+    memoryBytesAllocated.store(0, std::memory_order_relaxed);
+    memoryLiveBytes.store(0, std::memory_order_relaxed);
+    memoryPeakLiveBytes.store(0, std::memory_order_relaxed);
+}
+
+static MemoryStats memoryGetStats()
+{
+    MemoryStats stats = {};
+    stats.allocations = memoryAllocations.load(std::memory_order_relaxed);
+    stats.reallocations = memoryReallocations.load(std::memory_order_relaxed);
+    stats.frees = memoryFrees.load(std::memory_order_relaxed);
+    stats.bytesAllocated = memoryBytesAllocated.load(std::memory_order_relaxed);
+    stats.liveBytes = memoryLiveBytes.load(std::memory_order_relaxed);
+    stats.peakLiveBytes = memoryPeakLiveBytes.load(std::memory_order_relaxed);
+    return stats;
+}
+
+#else
+
+static void *memAlloc(size_t size)
+{
+    return malloc(size);
+}
+
+static void memFree(void *pointer)
+{
+    free(pointer);
+}
+
+static void *memRealloc(void *pointer, size_t size)
+{
+    return realloc(pointer, size);
+}
+
+static unsigned long long memoryTrackAlloc(size_t)
+{
+    return 0;
+}
+
+static void memoryTrackFree(size_t, unsigned long long)
+{
+}
+
+static void memoryBeginRun()
+{
+}
+
+static MemoryStats memoryGetStats()
+{
+    return {};
+}
+
+#endif
+
+// The buffers that grow with the point count: the engines' vertex arrays and
+// the D&C merge buffers. They are read in no particular order, so at 10M+
+// points the TLB misses on them add up. These go through memAllocLarge, which
+// maps them with the page policy set in memoryPolicy. Small blocks, and all
+// blocks while no policy is set, come from memAlloc as before.
+//
+// Without MemoryPolicy_Interleave each page lands on the NUMA node of the
+// thread that writes it first, which for qhCopyVertices is the thread that owns
+// that slice. The exception is the first page: the header is written there by
+// the allocating thread, so that page, 2MB with MemoryPolicy_HugePages, is
+// always placed on the allocating thread's node.
+
+enum MemoryPolicyFlags
+{
+    // madvise(MADV_HUGEPAGE), for transparent huge pages set to "madvise"
+    MemoryPolicy_HugePages = 1,
+    // pages round robin over every NUMA node the process may use, instead of first touch
+    MemoryPolicy_Interleave = 2,
+    MemoryPolicy_Count = 4
+};
+
+static const char *memoryPolicyNames[MemoryPolicy_Count] = {"default", "huge pages", "interleave", "huge pages, interleave"};
+
+// MemoryPolicyFlags for the blocks allocated from now on, only used on Linux
+static int memoryPolicy = 0;
+
+#define MEMORY_LARGE_MIN (1 << 20)
+#define MEMORY_HUGE_PAGE_SIZE (2 << 20)
+
+struct MemoryLargeHeader
+{
+    // the block's own mapping, null if it came from memAlloc
+    void *mapping;
+    size_t length;
+    size_t size;
+    unsigned long long run;
+};
+
+static_assert(sizeof(MemoryLargeHeader) % 16 == 0, "MemoryLargeHeader must keep malloc alignment");
+
+static bool memoryMapsLarge(size_t size)
+{
+#if defined(__linux)
+    return memoryPolicy != 0 && size >= MEMORY_LARGE_MIN;
+#else
+    return false;
+#endif
+}
+
+#if defined(__linux)
+// Maps a block starting on a huge page boundary with the current policy, null if that failed
+static MemoryLargeHeader *memoryMapLarge(size_t size)
+{
+    auto length = (sizeof(MemoryLargeHeader) + size + MEMORY_HUGE_PAGE_SIZE - 1) & ~(size_t)(MEMORY_HUGE_PAGE_SIZE - 1);
+    auto raw = (char *)mmap(nullptr, length + MEMORY_HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(raw == (char *)MAP_FAILED)
+    {
+        return nullptr;
+    }
+    
+    // give back the slack in front of the first huge page boundary and behind the block
+    auto mapping = (char *)(((uintptr_t)raw + MEMORY_HUGE_PAGE_SIZE - 1) & ~(uintptr_t)(MEMORY_HUGE_PAGE_SIZE - 1));
+    if(mapping > raw)
+    {
+        munmap(raw, (size_t)(mapping - raw));
+    }
+    auto end = raw + length + MEMORY_HUGE_PAGE_SIZE;
+    if(end > mapping + length)
+    {
+        munmap(mapping + length, (size_t)(end - (mapping + length)));
+    }
+    
+    if(memoryPolicy & MemoryPolicy_HugePages)
+    {
+        madvise(mapping, length, MADV_HUGEPAGE);
+    }
+    if(memoryPolicy & MemoryPolicy_Interleave)
+    {
+        // machines with more than 64 nodes keep first touch
+        unsigned long nodes = 0;
+        if(syscall(SYS_get_mempolicy, nullptr, &nodes, sizeof(nodes) * 8, nullptr, MPOL_F_MEMS_ALLOWED) == 0 && nodes)
+        {
+            syscall(SYS_mbind, mapping, length, MPOL_INTERLEAVE, &nodes, sizeof(nodes) * 8 + 1, 0);
+        }
+    }
+    
+    auto header = (MemoryLargeHeader *)mapping;
+    header->mapping = mapping;
+    header->length = length;
+    return header;
+}
+#endif
+
+static void *memAllocLarge(size_t size)
+{
+#if defined(__linux)
+    if(memoryMapsLarge(size))
+    {
+        auto header = memoryMapLarge(size);
+        if(header)
+        {
+            header->size = size;
+            header->run = memoryTrackAlloc(size);
+            return header + 1;
+        }
+    }
+#endif
+    
+    auto header = (MemoryLargeHeader *)memAlloc(sizeof(MemoryLargeHeader) + size);
+    if(!header)
+    {
+        return nullptr;
+    }
+    header->mapping = nullptr;
+    header->length = 0;
+    header->size = size;
+    header->run = 0;
+    return header + 1;
+}
+
+static void memFreeLarge(void *pointer)
+{
+    if(!pointer)
+    {
+        return;
+    }
+    
+    auto header = (MemoryLargeHeader *)pointer - 1;
+#if defined(__linux)
+    if(header->mapping)
+    {
+        memoryTrackFree(header->size, header->run);
+        munmap(header->mapping, header->length);
+        return;
+    }
+#endif
+    memFree(header);
+}
+
+static void *memReallocLarge(void *pointer, size_t size)
+{
+    if(!pointer)
+    {
+        return memAllocLarge(size);
+    }
+    
+    auto header = (MemoryLargeHeader *)pointer - 1;
+    if(!header->mapping && !memoryMapsLarge(size))
+    {
+        // realloc can often grow the block in place
+        header = (MemoryLargeHeader *)memRealloc(header, sizeof(MemoryLargeHeader) + size);
+        if(!header)
+        {
+            return nullptr;
+        }
+        header->size = size;
+        return header + 1;
+    }
+    
+    auto result = memAllocLarge(size);
+    if(result)
+    {
+        memcpy(result, pointer, size < header->size ? size : header->size);
+        memFreeLarge(pointer);
+    }
+    return result;
+}
+
+#endif
@@ -0,0 +1,194 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+static int hardwareThreadCount()
+{
+    auto count = (int)std::thread::hardware_concurrency();
+    return count > 0 ? count : 1;
+}
+
+// Splits [0, count) into one contiguous range per thread and calls
+// fn(begin, end) for each of them. The calling thread takes the last range.
+// threadCount <= 0 means one thread per hardware thread.
+template<typename F>
+static void parallelFor(int count, int threadCount, F fn)
+{
+    if(threadCount <= 0)
+    {
+        threadCount = hardwareThreadCount();
+    }
+
+    threadCount = Min(threadCount, count);
+
+    if(threadCount <= 1)
+    {
+        if(count > 0)
+        {
+            fn(0, count);
+        }
+        return;
+    }
+
+    std::vector<std::thread> threads;
+    threads.reserve((size_t)threadCount - 1);
+
+    auto perThread = count / threadCount;
+    auto remainder = count % threadCount;
+    auto begin = 0;
+
+    for(int t = 0; t < threadCount; t++)
+    {
+        auto end = begin + perThread + (t < remainder ? 1 : 0);
+        if(t == threadCount - 1)
+        {
+            fn(begin, end);
+        }
+        else
+        {
+            threads.emplace_back(fn, begin, end);
+        }
+        begin = end;
+    }
+
+    for(auto &thread : threads)
+    {
+        thread.join();
+    }
+}
+
+// Range of work owned by one thread of parallelForStealing, begin in the low
+// and end in the high 32 bits so the owner taking from the front and a thief
+// taking the back half can both update it with a single compare and swap.
+// Padded to a cache line so threads don't slow each other down.
+struct StealRange
+{
+    std::atomic<unsigned long long> range;
+    char padding[64 - sizeof(std::atomic<unsigned long long>)];
+};
+
+static unsigned long long stealPack(int begin, int end)
+{
+    return (unsigned long long)(unsigned int)begin | ((unsigned long long)(unsigned int)end << 32);
+}
+
+// Takes up to grain items from the front of the owner's own range
+static bool stealTakeFront(StealRange &own, int grain, int &begin, int &end)
+{
+    auto packed = own.range.load(std::memory_order_acquire);
+    for(;;)
+    {
+        auto b = (int)(unsigned int)packed;
+        auto e = (int)(packed >> 32);
+        if(b >= e)
+        {
+            return false;
+        }
+        auto newBegin = Min(b + grain, e);
+        if(own.range.compare_exchange_weak(packed, stealPack(newBegin, e), std::memory_order_acq_rel))
+        {
+            begin = b;
+            end = newBegin;
+            return true;
+        }
+    }
+}
+
+// Moves the back half of victim's range into the thief's own, empty range
+static bool stealBackHalf(StealRange &victim, StealRange &own, int grain)
+{
+    auto packed = victim.range.load(std::memory_order_acquire);
+    for(;;)
+    {
+        auto b = (int)(unsigned int)packed;
+        auto e = (int)(packed >> 32);
+        // not worth it if the owner is about to take the rest anyway
+        if(e - b <= grain)
+        {
+            return false;
+        }
+        auto middle = e - (e - b) / 2;
+        if(victim.range.compare_exchange_weak(packed, stealPack(b, middle), std::memory_order_acq_rel))
+        {
+            own.range.store(stealPack(middle, e), std::memory_order_release);
+            return true;
+        }
+    }
+}
+
+// Like parallelFor, but for items of very different cost. Every thread starts
+// on its own contiguous range and works through it grain items at a time.
+// A thread that runs dry steals the back half of another thread's remaining
+// range, so no thread idles while there is work left. Calls
+// fn(thread, begin, end), thread in [0, threadCount), which lets callers keep
+// per-thread state. Returns the number of threads used.
+template<typename F>
+static int parallelForStealing(int count, int threadCount, int grain, F fn)
+{
+    if(threadCount <= 0)
+    {
+        threadCount = hardwareThreadCount();
+    }
+    
+    threadCount = Max(1, Min(threadCount, count));
+    grain = Max(grain, 1);
+    
+    if(threadCount == 1)
+    {
+        if(count > 0)
+        {
+            fn(0, 0, count);
+        }
+        return 1;
+    }
+    
+    std::vector<StealRange> ranges((size_t)threadCount);
+    auto perThread = count / threadCount;
+    auto remainder = count % threadCount;
+    auto begin = 0;
+    for(int t = 0; t < threadCount; t++)
+    {
+        auto end = begin + perThread + (t < remainder ? 1 : 0);
+        ranges[t].range.store(stealPack(begin, end), std::memory_order_relaxed);
+        begin = end;
+    }
+    
+    auto worker = [&](int thread)
+    {
+        for(;;)
+        {
+            int b, e;
+            while(stealTakeFront(ranges[thread], grain, b, e))
+            {
+                fn(thread, b, e);
+            }
+            
+            // work only ever moves between ranges, so if every range looks
+            // empty the remaining items are already being worked on
+            auto stole = false;
+            for(int i = 1; i < threadCount && !stole; i++)
+            {
+                stole = stealBackHalf(ranges[(thread + i) % threadCount], ranges[thread], grain);
+            }
+            if(!stole)
+            {
+                return;
+            }
+        }
+    };
+    
+    std::vector<std::thread> threads;
+    threads.reserve((size_t)threadCount - 1);
+    for(int t = 1; t < threadCount; t++)
+    {
+        threads.emplace_back(worker, t);
+    }
+    worker(0);
+    
+    for(auto &thread : threads)
+    {
+        thread.join();
+    }
+    return threadCount;
+}
+
+#endif
@@ -0,0 +1,182 @@
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+// Hardware performance counters read with perf_event_open around a hull run.
+// Only available on Linux. Counters the kernel or the machine does not support
+// (or that perf_event_paranoid forbids) are reported as -1.
+
+#if defined(__linux)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
+enum PerfCounter
+{
+    PerfCounter_Cycles,
+    PerfCounter_Instructions,
+    PerfCounter_L1DMisses,
+    PerfCounter_LLCMisses,
+    PerfCounter_BranchMisses,
+    PerfCounter_DTLBMisses,
+    PerfCounter_Count
+};
+
+static const char *perfCounterNames[PerfCounter_Count] = {"cycles", "instructions", "L1d misses", "LLC misses", "branch misses", "dTLB misses"};
+
+struct PerfCounters
+{
+    int fds[PerfCounter_Count];
+    bool opened;
+};
+
+struct PerfSample
+{
+    // -1 if the counter could not be read
+    long long values[PerfCounter_Count];
+};
+
+#if defined(__linux)
+
+static unsigned long long perfCacheConfig(unsigned long long cache, unsigned long long op, unsigned long long result)
+{
+    return cache | (op << 8) | (result << 16);
+}
+
+static int perfOpenCounter(unsigned int type, unsigned long long config)
+{
+    perf_event_attr attr = {};
+    attr.size = sizeof(perf_event_attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    // the counters are multiplexed if the PMU runs out of registers, these let us scale back up
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static void perfOpen(PerfCounters &counters)
+{
+    counters.fds[PerfCounter_Cycles] = perfOpenCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+    counters.fds[PerfCounter_Instructions] = perfOpenCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+    counters.fds[PerfCounter_L1DMisses] = perfOpenCounter(PERF_TYPE_HW_CACHE, perfCacheConfig(PERF_COUNT_HW_CACHE_L1D, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS));
+    counters.fds[PerfCounter_LLCMisses] = perfOpenCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+    counters.fds[PerfCounter_BranchMisses] = perfOpenCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+    counters.fds[PerfCounter_DTLBMisses] = perfOpenCounter(PERF_TYPE_HW_CACHE, perfCacheConfig(PERF_COUNT_HW_CACHE_DTLB, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS));
+
+    auto available = 0;
+    for(int i = 0; i < PerfCounter_Count; i++)
+    {
+        if(counters.fds[i] >= 0)
+        {
+            available++;
+        }
+    }
+
+    if(available < PerfCounter_Count)
+    {
+        log_a("Only %d of %d hardware counters are available\n", available, PerfCounter_Count);
+    }
+
+    counters.opened = true;
+}
+
+static void perfClose(PerfCounters &counters)
+{
+    if(!counters.opened)
+    {
+        return;
+    }
+
+    for(int i = 0; i < PerfCounter_Count; i++)
+    {
+        if(counters.fds[i] >= 0)
+        {
+            close(counters.fds[i]);
+        }
+        counters.fds[i] = -1;
+    }
+    counters.opened = false;
+}
+
+static void perfStart(PerfCounters &counters)
+{
+    for(int i = 0; i < PerfCounter_Count; i++)
+    {
+        if(counters.fds[i] >= 0)
+        {
+            ioctl(counters.fds[i], PERF_EVENT_IOC_RESET, 0);
+            ioctl(counters.fds[i], PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+}
+
+static void perfStop(PerfCounters &counters, PerfSample &sample)
+{
+    for(int i = 0; i < PerfCounter_Count; i++)
+    {
+        if(counters.fds[i] >= 0)
+        {
+            ioctl(counters.fds[i], PERF_EVENT_IOC_DISABLE, 0);
+        }
+    }
+
+    for(int i = 0; i < PerfCounter_Count; i++)
+    {
+        sample.values[i] = -1;
+        if(counters.fds[i] < 0)
+        {
+            continue;
+        }
+
+        // value, time enabled, time running
+        unsigned long long data[3] = {};
+        if(read(counters.fds[i], data, sizeof(data)) != (ssize_t)sizeof(data) || data[2] == 0)
+        {
+            continue;
+        }
+
+        auto value = (double)data[0];
+        if(data[2] < data[1])
+        {
+            value *= (double)data[1] / (double)data[2];
+        }
+        sample.values[i] = (long long)value;
+    }
+}
+
+#else
+
+static void perfOpen(PerfCounters &counters)
+{
+    for(int i = 0; i < PerfCounter_Count; i++)
+    {
+        counters.fds[i] = -1;
+    }
+    log_a("Hardware counters are only supported on Linux\n");
+    counters.opened = true;
+}
+
+static void perfClose(PerfCounters &counters)
+{
+    counters.opened = false;
+}
+
+static void perfStart(PerfCounters &)
+{
+}
+
+static void perfStop(PerfCounters &, PerfSample &sample)
+{
+    for(int i = 0; i < PerfCounter_Count; i++)
+    {
+        sample.values[i] = -1;
+    }
+}
+
+#endif
+
+#endif
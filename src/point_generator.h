@@ -3,8 +3,15 @@
 
 struct PointGenerator;
 
-#define GENERATOR_FUNCTION(name) Vertex* name(PointGenerator& pointGenerator, glm::vec3 offset)
-typedef GENERATOR_FUNCTION(GeneratorFunction);
+// A generated point for the double benchmarks. The generators work in double,
+// a Vertex keeps the float rounding of that, this keeps the double.
+struct PrecisePoint
+{
+    glm::dvec3 position;
+};
+
+// Generators fill either Vertex (drawing and the float benchmarks) or PrecisePoint
+#define GENERATOR_FUNCTION(name) template<typename P> static P* name(PointGenerator& pointGenerator, glm::vec3 offset)
 
 enum GeneratorType
 {
@@ -20,25 +27,124 @@ struct PointGenerator
 {
     int numberOfPoints;
     GeneratorType type;
-    std::mt19937_64 gen;
-    std::uniform_real_distribution<coord_t> d;
+    unsigned long long seed;
+    unsigned long long sequence;
+    int threadCount;
     coord_t min;
     coord_t max;
 };
 
+// Coordinate types a test set is benchmarked with, read from "scalar float|double|both"
+enum ScalarTypes
+{
+    Scalar_Float = 1,
+    Scalar_Double = 2
+};
+
 struct TestSet
 {
     int *testSet;
     size_t count;
     int iterations;
+    int warmup;
     GeneratorType genType;
+    unsigned long long seed;
+    // read hardware counters around every hull run, see perf_counters.h
+    bool perfCounters;
+    // ScalarTypes flags, float if not set
+    int scalars;
+    // curve the points are sorted along before every hull run, see spatial_order.h
+    SpatialOrderCurve spatialOrder;
+    // MemoryPolicyFlags for the engines' large buffers, see memory.h
+    int memoryPolicy;
 };
 
+// Thresholds of the Auto hull type, see SelectHullType in hull.h. Written by
+// the calibration run (K) and read from the file named by "autoselect" in the config.
+struct AutoSelectConfig
+{
+    // the incremental hull below this many points
+    int incrementalBelow;
+    // D&C if this share of a sample is on the sample's hull
+    float dacHullFraction;
+    // otherwise D&C below this many points and QuickHull from there on
+    int dacBelow;
+};
+
+// Used unless the config names a file from a calibration run, and the
+// thresholds by size are the batch API's defaults too. Picked from timing all
+// three algorithms on 512 to 32k points of every generator: the samples of
+// points on a sphere have all of them on the hull, the others under a quarter,
+// and D&C was 3-4x faster on the first at every size. On the rest QuickHull
+// was faster from 1024 points on. The incremental hull was never the fastest,
+// so it is off unless asked for.
+static AutoSelectConfig defaultAutoSelectConfig()
+{
+    AutoSelectConfig config = {};
+    config.incrementalBelow = 0;
+    config.dacHullFraction = 0.5f;
+    config.dacBelow = 1024;
+    return config;
+}
+
+static void readAutoSelectConfig(const char *filename, AutoSelectConfig &config)
+{
+    FILE *f = fopen(filename, "r");
+    if(!f)
+    {
+        log_a("No auto select thresholds in %s, using the defaults\n", filename);
+        return;
+    }
+    
+    char buf[128];
+    while(getData(buf, sizeof(buf), f))
+    {
+        if(startsWith(buf, "incrementalBelow"))
+        {
+            sscanf(buf, "incrementalBelow %d", &config.incrementalBelow);
+        }
+        else if(startsWith(buf, "dacHullFraction"))
+        {
+            sscanf(buf, "dacHullFraction %f", &config.dacHullFraction);
+        }
+        else if(startsWith(buf, "dacBelow"))
+        {
+            sscanf(buf, "dacBelow %d", &config.dacBelow);
+        }
+    }
+    fclose(f);
+}
+
+static void writeAutoSelectConfig(const char *filename, const AutoSelectConfig &config)
+{
+    FILE *f = fopen(filename, "w");
+    if(!f)
+    {
+        log_a("Could not write %s\n", filename);
+        return;
+    }
+    
+    fprintf(f, "# Auto hull type thresholds, from the calibration run\n");
+    fprintf(f, "incrementalBelow %d\n", config.incrementalBelow);
+    fprintf(f, "dacHullFraction %.3f\n", config.dacHullFraction);
+    fprintf(f, "dacBelow %d\n", config.dacBelow);
+    fclose(f);
+}
+
 struct ConfigData
 {
     int numberOfPoints;
     Vertex *vertices;
     GeneratorType genType;
+    unsigned long long seed;
+    bool perfCounters;
+    int scalars;
+    SpatialOrderCurve spatialOrder;
+    int memoryPolicy;
+    
+    // where the calibration run writes the auto select thresholds
+    char autoSelectPath[128];
+    AutoSelectConfig autoSelect;
     
     List<TestSet> qhTestSets;
     List<TestSet> incTestSets;
@@ -49,6 +155,51 @@ struct ConfigData
     int verticesInMesh;
 };
 
+static int readScalarTypes(const char *buf)
+{
+    char name[16] = {};
+    sscanf(buf, "scalar %15s", name);
+    if(strcmp(name, "double") == 0)
+    {
+        return Scalar_Double;
+    }
+    if(strcmp(name, "both") == 0)
+    {
+        return Scalar_Float | Scalar_Double;
+    }
+    return Scalar_Float;
+}
+
+static SpatialOrderCurve readSpatialOrder(const char *buf)
+{
+    char name[16] = {};
+    sscanf(buf, "order %15s", name);
+    if(strcmp(name, "morton") == 0)
+    {
+        return SpatialOrder_Morton;
+    }
+    if(strcmp(name, "hilbert") == 0)
+    {
+        return SpatialOrder_Hilbert;
+    }
+    return SpatialOrder_None;
+}
+
+// "memory hugepages", "memory interleave" or both
+static int readMemoryPolicy(const char *buf)
+{
+    int policy = 0;
+    if(strstr(buf, "hugepages"))
+    {
+        policy |= MemoryPolicy_HugePages;
+    }
+    if(strstr(buf, "interleave"))
+    {
+        policy |= MemoryPolicy_Interleave;
+    }
+    return policy;
+}
+
 void readTestSet(const char *filename, TestSet &testSet)
 {
     FILE *f = fopen(filename, "r");
@@ -56,9 +207,11 @@ void readTestSet(const char *filename, TestSet &testSet)
     {
         testSet.count = 0;
         testSet.iterations = 0;
+        testSet.warmup = 1;
         
         char buf[64];
         int i = 0;
+        auto lineStart = ftell(f);
         while(getData(buf, sizeof(buf), f))
         {
             if(startsWith(buf, "gen"))
@@ -75,6 +228,32 @@ void readTestSet(const char *filename, TestSet &testSet)
             {
                 sscanf(buf, "iterations %d", &testSet.iterations);
             }
+            else if(startsWith(buf, "seed"))
+            {
+                sscanf(buf, "seed %llu", &testSet.seed);
+            }
+            else if(startsWith(buf, "warmup"))
+            {
+                sscanf(buf, "warmup %d", &testSet.warmup);
+            }
+            else if(startsWith(buf, "perf"))
+            {
+                int perf;
+                sscanf(buf, "perf %d", &perf);
+                testSet.perfCounters = perf != 0;
+            }
+            else if(startsWith(buf, "scalar"))
+            {
+                testSet.scalars = readScalarTypes(buf);
+            }
+            else if(startsWith(buf, "order"))
+            {
+                testSet.spatialOrder = readSpatialOrder(buf);
+            }
+            else if(startsWith(buf, "memory"))
+            {
+                testSet.memoryPolicy = readMemoryPolicy(buf);
+            }
             else if(!startsWith(buf, "#"))
             {
                 if(testSet.count == 0)
@@ -85,14 +264,13 @@ void readTestSet(const char *filename, TestSet &testSet)
                         break;
                     }
                     testSet.testSet = (int*)malloc(sizeof(int) * testSet.count);
-                    rewind(f);
-                    getData(buf, sizeof(buf), f);
-                    getData(buf, sizeof(buf), f);
+                    fseek(f, lineStart, SEEK_SET);
                     getData(buf, sizeof(buf), f);
                 }
                 
                 sscanf(buf, "%d", &testSet.testSet[i++]);
             }
+            lineStart = ftell(f);
         }
         fclose(f);
     }
@@ -156,6 +334,8 @@ void loadConfig(const char* filePath, ConfigData &configData, RenderContext &ren
 {
     FILE* f = fopen(filePath, "r");
     configData.vertices = nullptr;
+    configData.autoSelect = defaultAutoSelectConfig();
+    configData.autoSelectPath[0] = '\0';
     if(f)
     {
         char buffer[64];
@@ -169,6 +349,28 @@ void loadConfig(const char* filePath, ConfigData &configData, RenderContext &ren
             {
                 sscanf(buffer, "points %d", &configData.numberOfPoints);
             }
+            else if(startsWith(buffer, "seed"))
+            {
+                sscanf(buffer, "seed %llu", &configData.seed);
+            }
+            else if(startsWith(buffer, "perf"))
+            {
+                int perf;
+                sscanf(buffer, "perf %d", &perf);
+                configData.perfCounters = perf != 0;
+            }
+            else if(startsWith(buffer, "scalar"))
+            {
+                configData.scalars = readScalarTypes(buffer);
+            }
+            else if(startsWith(buffer, "order"))
+            {
+                configData.spatialOrder = readSpatialOrder(buffer);
+            }
+            else if(startsWith(buffer, "memory"))
+            {
+                configData.memoryPolicy = readMemoryPolicy(buffer);
+            }
             else if(startsWith(buffer, "type"))
             {
                 int genType;
@@ -179,6 +381,11 @@ void loadConfig(const char* filePath, ConfigData &configData, RenderContext &ren
                 }
                 configData.genType = (GeneratorType)genType;
             }
+            else if(startsWith(buffer, "autoselect"))
+            {
+                sscanf(buffer, "autoselect %127s", configData.autoSelectPath);
+                readAutoSelectConfig(configData.autoSelectPath, configData.autoSelect);
+            }
             else if(startsWith(buffer, "i"))
             {
                 readTestSets(buffer, 64, configData.incTestSets, f);
@@ -210,6 +417,39 @@ void loadConfig(const char* filePath, ConfigData &configData, RenderContext &ren
         }
         fclose(f);
     }
+    
+    // Without a seed in the config we fall back to the clock, but the seed is
+    // still printed and written to the CSVs so the run can be repeated.
+    if(!configData.seed)
+    {
+        configData.seed = (unsigned long long)time(NULL);
+    }
+    
+    List<TestSet> *testSetLists[] = {&configData.qhTestSets, &configData.incTestSets, &configData.dacTestSets};
+    for(auto *testSets : testSetLists)
+    {
+        for(size_t i = 0; i < testSets->size; i++)
+        {
+            auto &testSet = (*testSets)[i];
+            if(!testSet.seed)
+            {
+                testSet.seed = configData.seed + i;
+            }
+            testSet.perfCounters |= configData.perfCounters;
+            if(!testSet.scalars)
+            {
+                testSet.scalars = configData.scalars ? configData.scalars : Scalar_Float;
+            }
+            if(!testSet.spatialOrder)
+            {
+                testSet.spatialOrder = configData.spatialOrder;
+            }
+            if(!testSet.memoryPolicy)
+            {
+                testSet.memoryPolicy = configData.memoryPolicy;
+            }
+        }
+    }
 }
 
 
@@ -217,101 +457,168 @@ static void initPointGenerator(PointGenerator& pointGenerator, GeneratorType typ
 {
     pointGenerator.type = type;
     pointGenerator.numberOfPoints = numberOfPoints;
-    //std::uniform_real_distribution<coord_t> d(min, max);
     pointGenerator.min = min;
     pointGenerator.max = max;
-    //pointGenerator.d = d;
 }
 
-static GENERATOR_FUNCTION(generatePoints)
+// Points are generated from counter-based random streams: the stream of point i
+// only depends on (seed, sequence, i), so the output is the same no matter how
+// many threads split up the work.
+struct RandomStream
+{
+    unsigned long long state;
+};
+
+static inline unsigned long long splitMix64(unsigned long long &state)
+{
+    auto z = (state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+static inline RandomStream pointStream(PointGenerator &pointGenerator, unsigned long long index)
+{
+    auto key = pointGenerator.seed ^ (pointGenerator.sequence * 0xD1B54A32D192ED03ULL);
+    auto hashedIndex = index;
+    RandomStream stream;
+    stream.state = key ^ splitMix64(hashedIndex);
+    splitMix64(stream.state);
+    return stream;
+}
+
+// Uniform in [0, 1)
+static inline coord_t streamUnit(RandomStream &stream)
+{
+    return (coord_t)(splitMix64(stream.state) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+// Same mapping as randomCoord in util.h
+static inline coord_t streamCoord(RandomStream &stream, coord_t start, coord_t end)
+{
+    return streamUnit(stream) * end + start;
+}
+
+// Marsaglia (1972): rejection sample a point in the unit disk and lift it onto the
+// unit sphere. Same distribution as theta/acos(phi) sampling without any trig calls.
+static inline glm::dvec3 streamUnitVector(RandomStream &stream)
+{
+    coord_t a, b, s;
+    do
+    {
+        a = 2.0 * streamUnit(stream) - 1.0;
+        b = 2.0 * streamUnit(stream) - 1.0;
+        s = a * a + b * b;
+    } while(s >= 1.0);
+    
+    auto scale = 2.0 * sqrt(1.0 - s);
+    return glm::dvec3(a * scale, b * scale, 1.0 - 2.0 * s);
+}
+
+static inline void setGeneratedColor(Vertex &vertex)
 {
-    auto res = (Vertex*)malloc(sizeof(Vertex) * pointGenerator.numberOfPoints);
+    vertex.color = glm::vec4(0.0f, 1.0f, 1.0f, 1.0f);
+}
+
+static inline void setGeneratedColor(PrecisePoint &)
+{
+}
+
+GENERATOR_FUNCTION(generatePoints)
+{
+    auto res = (P*)malloc(sizeof(P) * pointGenerator.numberOfPoints);
+    using point_t = decltype(res->position);
     auto min = pointGenerator.min;
     auto max = pointGenerator.max;
-    for(int i = 0; i < pointGenerator.numberOfPoints; i++)
+    parallelFor(pointGenerator.numberOfPoints, pointGenerator.threadCount, [&](int begin, int end)
     {
-        coord_t x = randomCoord(pointGenerator.d, pointGenerator.gen, min, max);
-        coord_t y = randomCoord(pointGenerator.d, pointGenerator.gen, min, max);
-        coord_t z = randomCoord(pointGenerator.d, pointGenerator.gen, min, max);
-        
-        res[i].position = glm::vec3(x, y, z) - offset;
-        res[i].color = glm::vec4(0.0f, 1.0f, 1.0f, 1.0f);
-    }
+        for(int i = begin; i < end; i++)
+        {
+            auto s = pointStream(pointGenerator, (unsigned long long)i);
+            coord_t x = streamCoord(s, min, max);
+            coord_t y = streamCoord(s, min, max);
+            coord_t z = streamCoord(s, min, max);
+            
+            res[i].position = point_t(x, y, z) - point_t(offset);
+            setGeneratedColor(res[i]);
+        }
+    });
     return res;
 }
 
-
-
-static GENERATOR_FUNCTION(generatePointsOnSphere)
+GENERATOR_FUNCTION(generatePointsOnSphere)
 {
     auto max = pointGenerator.max;
-    auto radius = (coord_t)max / 2.0f;
-    auto res = (Vertex*)malloc(sizeof(Vertex) * pointGenerator.numberOfPoints);
-    for(int i = 0; i < pointGenerator.numberOfPoints; i++) 
+    auto radius = (coord_t)max / 2.0;
+    auto res = (P*)malloc(sizeof(P) * pointGenerator.numberOfPoints);
+    using point_t = decltype(res->position);
+    parallelFor(pointGenerator.numberOfPoints, pointGenerator.threadCount, [&](int begin, int end)
     {
-        coord_t theta = 2.0f * (coord_t)M_PI * randomCoord(pointGenerator.d, pointGenerator.gen, 0.0f, 1.0f);
-        coord_t phi = (coord_t)acos(1.0f - 2.0f * randomCoord(pointGenerator.d, pointGenerator.gen, 0.0f, 1.0f));
-        coord_t x = (coord_t)sin(phi) * (coord_t)cos(theta) * radius;
-        coord_t y = (coord_t)sin(phi) * (coord_t)sin(theta) * radius;
-        coord_t z = (coord_t)cos(phi) * radius;
-        
-        res[i].position = glm::vec3(x, y, z) - offset;
-        res[i].color = glm::vec4(0.0f, 1.0f, 1.0f, 1.0f);
-    }
+        for(int i = begin; i < end; i++)
+        {
+            auto s = pointStream(pointGenerator, (unsigned long long)i);
+            auto p = streamUnitVector(s) * radius;
+            
+            res[i].position = point_t(p) - point_t(offset);
+            setGeneratedColor(res[i]);
+        }
+    });
     return res;
 }
 
-static GENERATOR_FUNCTION(generatePointsInSphere)
+GENERATOR_FUNCTION(generatePointsInSphere)
 {
     auto min = pointGenerator.min;
     auto max = pointGenerator.max;
-    auto res = (Vertex*)malloc(sizeof(Vertex) * pointGenerator.numberOfPoints);
-    for(int i = 0; i < pointGenerator.numberOfPoints; i++) 
+    auto res = (P*)malloc(sizeof(P) * pointGenerator.numberOfPoints);
+    using point_t = decltype(res->position);
+    parallelFor(pointGenerator.numberOfPoints, pointGenerator.threadCount, [&](int begin, int end)
     {
-        coord_t theta = 2 * (coord_t)M_PI * randomCoord(pointGenerator.d, pointGenerator.gen, 0.0, 1.0);
-        coord_t phi = (coord_t)acos(1.0f - 2.0f * randomCoord(pointGenerator.d, pointGenerator.gen, 0.0, 1.0));
-        
-        auto r = randomCoord(pointGenerator.d, pointGenerator.gen, min, max);
-        coord_t x = r * (coord_t)sin(phi) * (coord_t)cos(theta);
-        coord_t y = r * (coord_t)sin(phi) * (coord_t)sin(theta);
-        coord_t z = r * (coord_t)cos(phi);
-        
-        res[i].position = glm::vec3(x, y, z) - offset;
-        res[i].color = glm::vec4(0.0f, 1.0f, 1.0f, 1.0f);
-    }
+        for(int i = begin; i < end; i++)
+        {
+            auto s = pointStream(pointGenerator, (unsigned long long)i);
+            auto direction = streamUnitVector(s);
+            auto r = streamCoord(s, min, max);
+            auto p = direction * r;
+            
+            res[i].position = point_t(p) - point_t(offset);
+            setGeneratedColor(res[i]);
+        }
+    });
     return res;
 }
 
 
-static GENERATOR_FUNCTION(generatePointsInClusters)
+GENERATOR_FUNCTION(generatePointsInClusters)
 {
-    auto res = (Vertex*)malloc(sizeof(Vertex) * pointGenerator.numberOfPoints);
+    auto res = (P*)malloc(sizeof(P) * pointGenerator.numberOfPoints);
     auto min = pointGenerator.min;
     auto max = pointGenerator.max;
     
     auto n_clusters = 10;
     auto pointsPerCluster = pointGenerator.numberOfPoints / n_clusters;
     
-    PointGenerator p;
-    p.numberOfPoints = pointsPerCluster;
-    p.type = pointGenerator.type;
-    p.gen = pointGenerator.gen;
-    p.d = pointGenerator.d;
-    p.gen.seed((unsigned int)time(NULL));
-    
     auto partOfMax = max / (n_clusters * 10);
     
-    for(size_t i = 0; i < n_clusters; i++)
+    for(int i = 0; i < n_clusters; i++)
     {
-        auto r1 = randomCoord(p.d, p.gen, min + partOfMax * i, partOfMax + (partOfMax * i));
-        auto r2 = randomCoord(p.d, p.gen, min + partOfMax * i, partOfMax + (partOfMax * i));
-        p.min = Min(r1, r2);
-        p.max = Max(r1, r2);
-        initPointGenerator(p, p.type, pointsPerCluster, p.min, p.max);
-        auto newOffset = glm::vec3(offset.x + ((randomInt(p.d, p.gen, 0, 1) ? -1 : 1) * randomCoord(p.d, p.gen, max / 2, max)), offset.y + ((randomInt(p.d, p.gen, 0, 1) ? -1 : 1) * randomCoord(p.d, p.gen, max / 2, max)), offset.z + ((randomInt(p.d, p.gen, 0, 1) ? -1 : 1) *randomCoord(p.d, p.gen, max / 2, max)));
-        auto cluster = generatePointsInSphere(p, newOffset);
+        // The cluster parameters get their own stream past the end of the point indices
+        auto s = pointStream(pointGenerator, (unsigned long long)pointGenerator.numberOfPoints + (unsigned long long)i);
+        
+        PointGenerator p = pointGenerator;
+        p.seed = pointGenerator.seed + (unsigned long long)(i + 1);
+        p.numberOfPoints = i == n_clusters - 1 ? pointGenerator.numberOfPoints - pointsPerCluster * i : pointsPerCluster;
+        
+        auto r1 = streamCoord(s, min + partOfMax * i, partOfMax + (partOfMax * i));
+        auto r2 = streamCoord(s, min + partOfMax * i, partOfMax + (partOfMax * i));
+        initPointGenerator(p, p.type, p.numberOfPoints, Min(r1, r2), Max(r1, r2));
+        
+        auto sign = [&s]() { return streamUnit(s) < 0.5 ? -1.0 : 1.0; };
+        auto newOffset = glm::vec3(offset.x + sign() * streamCoord(s, max / 2, max), offset.y + sign() * streamCoord(s, max / 2, max), offset.z + sign() * streamCoord(s, max / 2, max));
+        auto cluster = generatePointsInSphere<P>(p, newOffset);
         
-        memcpy(res + (pointsPerCluster * i), cluster, sizeof(Vertex) * pointsPerCluster);
+        memcpy(res + (pointsPerCluster * i), cluster, sizeof(P) * p.numberOfPoints);
+        free(cluster);
     }
     
     return res;
@@ -322,93 +629,118 @@ GENERATOR_FUNCTION(generatePointsOnNormalizedSphere)
 {
     auto min = pointGenerator.min;
     auto max = pointGenerator.max;
-    auto res = (Vertex*)malloc(sizeof(Vertex) * pointGenerator.numberOfPoints);
-    for(int i = 0; i < pointGenerator.numberOfPoints; i++)
+    auto res = (P*)malloc(sizeof(P) * pointGenerator.numberOfPoints);
+    using point_t = decltype(res->position);
+    parallelFor(pointGenerator.numberOfPoints, pointGenerator.threadCount, [&](int begin, int end)
     {
-        coord_t x = randomCoord(pointGenerator.d, pointGenerator.gen, min, max);
-        coord_t y = randomCoord(pointGenerator.d, pointGenerator.gen, min, max);
-        coord_t z = randomCoord(pointGenerator.d, pointGenerator.gen, min, max);
-        
-        auto o = glm::vec3((coord_t)offset.x, (coord_t)offset.y, (coord_t)offset.z);
-        
-        auto v = glm::normalize(glm::vec3((float)x, (float)y, (float)z)) * (float)max - offset;
-        res[i].position = glm::vec3((coord_t)v.x, (coord_t)v.y, (coord_t)v.z);
-        res[i].color = glm::vec4(0.0f, 1.0f, 1.0f, 1.0f);
-    }
+        for(int i = begin; i < end; i++)
+        {
+            auto s = pointStream(pointGenerator, (unsigned long long)i);
+            coord_t x = streamCoord(s, min, max);
+            coord_t y = streamCoord(s, min, max);
+            coord_t z = streamCoord(s, min, max);
+            
+            res[i].position = glm::normalize(point_t(x, y, z)) * (typename point_t::value_type)max - point_t(offset);
+            setGeneratedColor(res[i]);
+        }
+    });
     return res;
 }
 
+// Interior points are summed in fixed size blocks so the centroid does not
+// depend on how the blocks are spread over threads.
+#define GENERATOR_BLOCK_SIZE 16384
+
 GENERATOR_FUNCTION(generatePointsManyInternal)
 {
     auto min = pointGenerator.min;
     auto max = pointGenerator.max;
-    auto res = (Vertex*)malloc(sizeof(Vertex) * pointGenerator.numberOfPoints);
+    auto res = (P*)malloc(sizeof(P) * pointGenerator.numberOfPoints);
+    using point_t = decltype(res->position);
     
     int pointsOnOutside = 50;
+    int internalCount = pointGenerator.numberOfPoints - (Min(pointsOnOutside - 1, pointGenerator.numberOfPoints) - 1);
     
-    glm::vec3 total = glm::vec3(0.0f);
+    int blockCount = (internalCount + GENERATOR_BLOCK_SIZE - 1) / GENERATOR_BLOCK_SIZE;
+    std::vector<glm::dvec3> blockTotals((size_t)Max(blockCount, 0));
     
-    for(int i = 0; i < pointGenerator.numberOfPoints- (Min(pointsOnOutside - 1, pointGenerator.numberOfPoints) - 1); i++)
+    parallelFor(blockCount, pointGenerator.threadCount, [&](int beginBlock, int endBlock)
     {
-        coord_t x = randomCoord(pointGenerator.d, pointGenerator.gen, max / 5.0f - min, max / 5.0f);
-        coord_t y = randomCoord(pointGenerator.d, pointGenerator.gen, max / 5.0f - min, max / 5.0f);
-        coord_t z = randomCoord(pointGenerator.d, pointGenerator.gen, max / 5.0f - min, max / 5.0f);
-        
-        res[i].position = glm::vec3(x, y, z) - offset;
-        res[i].color = glm::vec4(0.0f, 1.0f, 1.0f, 1.0f);
-        total += res[i].position;
+        for(int block = beginBlock; block < endBlock; block++)
+        {
+            auto blockTotal = glm::dvec3(0.0);
+            auto end = Min((block + 1) * GENERATOR_BLOCK_SIZE, internalCount);
+            for(int i = block * GENERATOR_BLOCK_SIZE; i < end; i++)
+            {
+                auto s = pointStream(pointGenerator, (unsigned long long)i);
+                coord_t x = streamCoord(s, max / 5.0 - min, max / 5.0);
+                coord_t y = streamCoord(s, max / 5.0 - min, max / 5.0);
+                coord_t z = streamCoord(s, max / 5.0 - min, max / 5.0);
+                
+                res[i].position = point_t(x, y, z) - point_t(offset);
+                setGeneratedColor(res[i]);
+                blockTotal += glm::dvec3(res[i].position);
+            }
+            blockTotals[(size_t)block] = blockTotal;
+        }
+    });
+    
+    auto sum = glm::dvec3(0.0);
+    for(const auto &blockTotal : blockTotals)
+    {
+        sum += blockTotal;
     }
     
-    total = glm::vec3(total.x / (pointGenerator.numberOfPoints - pointsOnOutside), total.y / (pointGenerator.numberOfPoints - pointsOnOutside), total.z / (pointGenerator.numberOfPoints - pointsOnOutside));
+    auto total = point_t(sum / (coord_t)(pointGenerator.numberOfPoints - pointsOnOutside));
     
-    auto radius = max / 2.0f;
-    for(int i = pointGenerator.numberOfPoints- (Min(pointsOnOutside - 1, pointGenerator.numberOfPoints) - 1); i < pointGenerator.numberOfPoints; i++)
+    auto radius = max / 2.0;
+    for(int i = internalCount; i < pointGenerator.numberOfPoints; i++)
     {
-        coord_t theta = 2 * (coord_t)M_PI * randomCoord(pointGenerator.d, pointGenerator.gen, 0.0, 1.0);
-        coord_t phi = (coord_t)acos(1 - 2 * randomCoord(pointGenerator.d, pointGenerator.gen, 0.0, 1.0));
-        coord_t x = (coord_t)sin(phi) * (coord_t)cos(theta) * radius;
-        coord_t y = (coord_t)sin(phi) * (coord_t)sin(theta) * radius;
-        coord_t z = (coord_t)cos(phi) * radius;
+        auto s = pointStream(pointGenerator, (unsigned long long)i);
+        auto p = streamUnitVector(s) * radius;
         
-        res[i].position = glm::vec3(x, y, z) + total - offset;
-        res[i].color = glm::vec4(0.0f, 1.0f, 1.0f, 1.0f);
+        res[i].position = point_t(p) + total - point_t(offset);
+        setGeneratedColor(res[i]);
     }
     
     return res;
 }
 
-static GENERATOR_FUNCTION(generate)
+// Every call draws a fresh point set from the generator's seed
+template<typename P = Vertex>
+static P* generate(PointGenerator& pointGenerator, glm::vec3 offset)
 {
+    pointGenerator.sequence++;
     switch(pointGenerator.type)
     {
         case GeneratorType::InSphere:
         {
-            return generatePointsInSphere(pointGenerator,offset);
+            return generatePointsInSphere<P>(pointGenerator,offset);
         }
         break;
         case GeneratorType::OnSphere:
         {
-            return generatePointsOnSphere(pointGenerator, offset);
+            return generatePointsOnSphere<P>(pointGenerator, offset);
         }
         break;
         case GeneratorType::InCube:
         {
-            return generatePoints(pointGenerator, offset);
+            return generatePoints<P>(pointGenerator, offset);
         }
         break;
         case GeneratorType::NormalizedSphere:
         {
-            return generatePointsOnNormalizedSphere(pointGenerator, offset);
+            return generatePointsOnNormalizedSphere<P>(pointGenerator, offset);
         }
         break;
         case GeneratorType::ManyInternal:
         {
-            return generatePointsManyInternal(pointGenerator, offset);
+            return generatePointsManyInternal<P>(pointGenerator, offset);
         }
         break;
         case GeneratorType::Clusters:
         {
-            return generatePointsInClusters(pointGenerator, offset);
+            return generatePointsInClusters<P>(pointGenerator, offset);
         }
         break;
     }
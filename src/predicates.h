@@ -0,0 +1,362 @@
+#ifndef PREDICATES_H
+#define PREDICATES_H
+
+// Robust orientation predicates after Shewchuk, "Adaptive Precision
+// Floating-Point Arithmetic and Fast Robust Geometric Predicates".
+// The determinant is first evaluated in plain double arithmetic together with
+// a bound on its rounding error. Only if the result is too close to zero to
+// trust the sign, it is recomputed exactly with floating-point expansions.
+// Only the sign of the returned value is meaningful.
+// The error-free transformations below rely on every operation being rounded
+// on its own, so the compiler must not fuse them into FMAs. GCC only does that
+// when building for an FMA target, which the build scripts don't.
+#if defined(__clang__)
+#pragma STDC FP_CONTRACT OFF
+#elif defined(_MSC_VER)
+#pragma fp_contract(off)
+#endif
+
+// 2^-53, half an ulp of 1.0
+static const double predicateEpsilon = 1.1102230246251565e-16;
+static const double predicateSplitter = 134217729.0; // 2^27 + 1
+static const double orient2dErrorBound = (3.0 + 16.0 * predicateEpsilon) * predicateEpsilon;
+static const double orient3dErrorBound = (7.0 + 56.0 * predicateEpsilon) * predicateEpsilon;
+// The normal and offset of a PredicatePlane are off by at most 4 and 3 epsilons
+// of their permanents, doubled to cover rounding the bound itself
+static const double planeErrorBound = (8.0 + 64.0 * predicateEpsilon) * predicateEpsilon;
+
+// Number of predicate calls that needed the exact fallback, per thread so
+// hulls built on other threads don't show up in a measured run
+static thread_local unsigned long long predicateExactCount = 0;
+
+// a + b = x + y exactly
+static inline void twoSum(double a, double b, double &x, double &y)
+{
+    x = a + b;
+    auto bVirtual = x - a;
+    auto aVirtual = x - bVirtual;
+    y = (a - aVirtual) + (b - bVirtual);
+}
+
+// a - b = x + y exactly
+static inline void twoDiff(double a, double b, double &x, double &y)
+{
+    x = a - b;
+    auto bVirtual = a - x;
+    auto aVirtual = x + bVirtual;
+    y = (a - aVirtual) + (bVirtual - b);
+}
+
+static inline void splitDouble(double a, double &high, double &low)
+{
+    auto c = predicateSplitter * a;
+    auto big = c - a;
+    high = c - big;
+    low = a - high;
+}
+
+// a * b = x + y exactly
+static inline void twoProduct(double a, double b, double &x, double &y)
+{
+    x = a * b;
+    double aHigh, aLow, bHigh, bLow;
+    splitDouble(a, aHigh, aLow);
+    splitDouble(b, bHigh, bLow);
+    auto error = x - aHigh * bHigh - aLow * bHigh - aHigh * bLow;
+    y = aLow * bLow - error;
+}
+
+// Expansions are arrays of non-overlapping doubles ordered by increasing
+// magnitude whose exact sum is the represented value. Zero terms are dropped.
+
+// h = e + f, h needs room for eLength + fLength terms
+static int expansionSum(int eLength, const double *e, int fLength, const double *f, double *h)
+{
+    double q, hh;
+    int eIndex = 0;
+    int fIndex = 0;
+    int hIndex = 0;
+    
+    if(eLength == 0)
+    {
+        for(int i = 0; i < fLength; i++)
+        {
+            h[i] = f[i];
+        }
+        return fLength;
+    }
+    if(fLength == 0)
+    {
+        for(int i = 0; i < eLength; i++)
+        {
+            h[i] = e[i];
+        }
+        return eLength;
+    }
+    
+    auto eNow = e[0];
+    auto fNow = f[0];
+    if((fNow > eNow) == (fNow > -eNow))
+    {
+        q = eNow;
+        eNow = ++eIndex < eLength ? e[eIndex] : 0.0;
+    }
+    else
+    {
+        q = fNow;
+        fNow = ++fIndex < fLength ? f[fIndex] : 0.0;
+    }
+    
+    while(eIndex < eLength || fIndex < fLength)
+    {
+        double next;
+        if(fIndex >= fLength || (eIndex < eLength && (fNow > eNow) == (fNow > -eNow)))
+        {
+            next = eNow;
+            eNow = ++eIndex < eLength ? e[eIndex] : 0.0;
+        }
+        else
+        {
+            next = fNow;
+            fNow = ++fIndex < fLength ? f[fIndex] : 0.0;
+        }
+        
+        twoSum(q, next, q, hh);
+        if(hh != 0.0)
+        {
+            h[hIndex++] = hh;
+        }
+    }
+    
+    if(q != 0.0 || hIndex == 0)
+    {
+        h[hIndex++] = q;
+    }
+    return hIndex;
+}
+
+// h = e * b, h needs room for 2 * eLength terms
+static int expansionScale(int eLength, const double *e, double b, double *h)
+{
+    double q, hh, product1, product0, sum;
+    int hIndex = 0;
+    
+    twoProduct(e[0], b, q, hh);
+    if(hh != 0.0)
+    {
+        h[hIndex++] = hh;
+    }
+    
+    for(int i = 1; i < eLength; i++)
+    {
+        twoProduct(e[i], b, product1, product0);
+        twoSum(q, product0, sum, hh);
+        if(hh != 0.0)
+        {
+            h[hIndex++] = hh;
+        }
+        twoSum(product1, sum, q, hh);
+        if(hh != 0.0)
+        {
+            h[hIndex++] = hh;
+        }
+    }
+    
+    if(q != 0.0 || hIndex == 0)
+    {
+        h[hIndex++] = q;
+    }
+    return hIndex;
+}
+
+// h = e * f for a two term f, h needs room for 4 * eLength terms
+static int expansionProduct2(int eLength, const double *e, const double *f, double *h)
+{
+    double low[16];
+    double high[16];
+    assert(eLength <= 8);
+    
+    auto lowLength = expansionScale(eLength, e, f[0], low);
+    auto highLength = expansionScale(eLength, e, f[1], high);
+    return expansionSum(lowLength, low, highLength, high, h);
+}
+
+// e = (x0 * y1 - x1 * y0) for two term x and y, up to 16 terms
+static int expansionCross(const double *x0, const double *y1, const double *x1, const double *y0, double *e)
+{
+    double left[8], right[8];
+    auto leftLength = expansionProduct2(2, x0, y1, left);
+    auto rightLength = expansionProduct2(2, x1, y0, right);
+    for(int i = 0; i < rightLength; i++)
+    {
+        right[i] = -right[i];
+    }
+    return expansionSum(leftLength, left, rightLength, right, e);
+}
+
+// e = x * c for a two term x and a 16 term c, up to 64 terms
+static int expansionTimesCross(const double *x, int cLength, const double *c, double *e)
+{
+    double low[32], high[32];
+    auto lowLength = expansionScale(cLength, c, x[0], low);
+    auto highLength = expansionScale(cLength, c, x[1], high);
+    return expansionSum(lowLength, low, highLength, high, e);
+}
+
+static double orient2dExact(double ax, double ay, double bx, double by, double cx, double cy)
+{
+    double acx[2], acy[2], bcx[2], bcy[2];
+    twoDiff(ax, cx, acx[1], acx[0]);
+    twoDiff(ay, cy, acy[1], acy[0]);
+    twoDiff(bx, cx, bcx[1], bcx[0]);
+    twoDiff(by, cy, bcy[1], bcy[0]);
+    
+    double det[16];
+    auto detLength = expansionCross(acx, bcy, acy, bcx, det);
+    
+    // the most significant term carries the sign
+    return det[detLength - 1];
+}
+
+// Positive if a, b, c are in counterclockwise order, negative if clockwise, zero if colinear
+static double orient2d(double ax, double ay, double bx, double by, double cx, double cy)
+{
+    auto left = (ax - cx) * (by - cy);
+    auto right = (ay - cy) * (bx - cx);
+    auto det = left - right;
+    
+    auto permanent = fabs(left) + fabs(right);
+    if(fabs(det) > orient2dErrorBound * permanent)
+    {
+        return det;
+    }
+    
+    predicateExactCount++;
+    return orient2dExact(ax, ay, bx, by, cx, cy);
+}
+
+template<typename S>
+static double orient3dExact(const position_t<S> &a, const position_t<S> &b, const position_t<S> &c, const position_t<S> &d)
+{
+    double adx[2], ady[2], adz[2], bdx[2], bdy[2], bdz[2], cdx[2], cdy[2], cdz[2];
+    twoDiff(a.x, d.x, adx[1], adx[0]);
+    twoDiff(a.y, d.y, ady[1], ady[0]);
+    twoDiff(a.z, d.z, adz[1], adz[0]);
+    twoDiff(b.x, d.x, bdx[1], bdx[0]);
+    twoDiff(b.y, d.y, bdy[1], bdy[0]);
+    twoDiff(b.z, d.z, bdz[1], bdz[0]);
+    twoDiff(c.x, d.x, cdx[1], cdx[0]);
+    twoDiff(c.y, d.y, cdy[1], cdy[0]);
+    twoDiff(c.z, d.z, cdz[1], cdz[0]);
+    
+    double bc[16], ca[16], ab[16];
+    auto bcLength = expansionCross(bdx, cdy, cdx, bdy, bc);
+    auto caLength = expansionCross(cdx, ady, adx, cdy, ca);
+    auto abLength = expansionCross(adx, bdy, bdx, ady, ab);
+    
+    double aTerm[64], bTerm[64], cTerm[64], abSum[128], det[192];
+    auto aLength = expansionTimesCross(adz, bcLength, bc, aTerm);
+    auto bLength = expansionTimesCross(bdz, caLength, ca, bTerm);
+    auto cLength = expansionTimesCross(cdz, abLength, ab, cTerm);
+    
+    auto abSumLength = expansionSum(aLength, aTerm, bLength, bTerm, abSum);
+    auto detLength = expansionSum(abSumLength, abSum, cLength, cTerm, det);
+    
+    return det[detLength - 1];
+}
+
+// Positive if d lies below the plane through a, b, c, where below means
+// a, b, c appear counterclockwise seen from above. Zero if the four are coplanar.
+// Float coordinates convert to double exactly, so both instantiations are exact.
+template<typename S>
+static double orient3d(const position_t<S> &a, const position_t<S> &b, const position_t<S> &c, const position_t<S> &d)
+{
+    double adx = (double)a.x - d.x;
+    double bdx = (double)b.x - d.x;
+    double cdx = (double)c.x - d.x;
+    double ady = (double)a.y - d.y;
+    double bdy = (double)b.y - d.y;
+    double cdy = (double)c.y - d.y;
+    double adz = (double)a.z - d.z;
+    double bdz = (double)b.z - d.z;
+    double cdz = (double)c.z - d.z;
+    
+    auto bdxcdy = bdx * cdy;
+    auto cdxbdy = cdx * bdy;
+    auto cdxady = cdx * ady;
+    auto adxcdy = adx * cdy;
+    auto adxbdy = adx * bdy;
+    auto bdxady = bdx * ady;
+    
+    auto det = adz * (bdxcdy - cdxbdy) + bdz * (cdxady - adxcdy) + cdz * (adxbdy - bdxady);
+    
+    auto permanent = (fabs(bdxcdy) + fabs(cdxbdy)) * fabs(adz) + (fabs(cdxady) + fabs(adxcdy)) * fabs(bdz) + (fabs(adxbdy) + fabs(bdxady)) * fabs(cdz);
+    if(fabs(det) > orient3dErrorBound * permanent)
+    {
+        return det;
+    }
+    
+    predicateExactCount++;
+    return orient3dExact(a, b, c, d);
+}
+
+// orient3d against one plane for many points. The part that only depends on
+// a, b, c is done once, a point then costs two dot products and no loads of
+// a, b, c. normal is (b - a) x (c - a), unnormalized, and the value of p is
+// dot(normal, p) - offset: positive where orient3d(a, b, c, p) is negative.
+struct PredicatePlane
+{
+    double normal[3];
+    double offset;
+    
+    // the rounding error of the value is at most dot(errorScale, |p|) + errorOffset
+    double errorScale[3];
+    double errorOffset;
+};
+
+template<typename S>
+static void predicatePlaneBegin(PredicatePlane &plane, const position_t<S> &a, const position_t<S> &b, const position_t<S> &c)
+{
+    double bax = (double)b.x - a.x;
+    double bay = (double)b.y - a.y;
+    double baz = (double)b.z - a.z;
+    double cax = (double)c.x - a.x;
+    double cay = (double)c.y - a.y;
+    double caz = (double)c.z - a.z;
+    
+    auto baycaz = bay * caz;
+    auto bazcay = baz * cay;
+    auto bazcax = baz * cax;
+    auto baxcaz = bax * caz;
+    auto baxcay = bax * cay;
+    auto baycax = bay * cax;
+    
+    plane.normal[0] = baycaz - bazcay;
+    plane.normal[1] = bazcax - baxcaz;
+    plane.normal[2] = baxcay - baycax;
+    plane.offset = plane.normal[0] * a.x + plane.normal[1] * a.y + plane.normal[2] * a.z;
+    
+    // Both the normal's error, which is scaled by p - a, and the rounding of the
+    // two dot products grow with |p| + |a|
+    plane.errorScale[0] = planeErrorBound * ((fabs(baycaz) + fabs(bazcay)) + fabs(plane.normal[0]));
+    plane.errorScale[1] = planeErrorBound * ((fabs(bazcax) + fabs(baxcaz)) + fabs(plane.normal[1]));
+    plane.errorScale[2] = planeErrorBound * ((fabs(baxcay) + fabs(baycax)) + fabs(plane.normal[2]));
+    plane.errorOffset = plane.errorScale[0] * fabs((double)a.x) + plane.errorScale[1] * fabs((double)a.y) + plane.errorScale[2] * fabs((double)a.z);
+}
+
+// The value of p for plane. certain is false if it is too close to zero to
+// trust its sign, orient3d has to decide then.
+template<typename S>
+static inline double predicatePlaneValue(const PredicatePlane &plane, const position_t<S> &p, bool &certain)
+{
+    double x = p.x;
+    double y = p.y;
+    double z = p.z;
+    
+    auto value = plane.normal[0] * x + plane.normal[1] * y + plane.normal[2] * z - plane.offset;
+    auto bound = plane.errorScale[0] * fabs(x) + plane.errorScale[1] * fabs(y) + plane.errorScale[2] * fabs(z) + plane.errorOffset;
+    certain = fabs(value) > bound;
+    return value;
+}
+
+#endif
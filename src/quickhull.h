@@ -9,6 +9,52 @@ enum QHIteration
     doIter
 };
 
+enum QhPhase
+{
+    QhPhase_InitialSimplex,
+    QhPhase_OutsideSets,
+    QhPhase_Horizon,
+    QhPhase_Cone,
+    QhPhase_Reassign,
+    QhPhase_RemoveFaces,
+    QhPhase_Count
+};
+
+static const char *qhPhaseNames[QhPhase_Count] = {"initial simplex", "outside sets", "horizon", "cone", "reassign", "remove faces"};
+
+// Which face with a non empty outside set is expanded next
+enum QhScheduling
+{
+    // the newest face first, the default
+    QhScheduling_Stack,
+    // the face whose furthest point is furthest from the hull. Those points
+    // bury the most of the others, so a lot fewer faces are built only to be
+    // removed again, unless every point ends up on the hull. Then the heap and
+    // the larger horizons cost more than that saves.
+    QhScheduling_Furthest,
+    QhScheduling_Count
+};
+
+static const char *qhSchedulingNames[QhScheduling_Count] = {"stack", "furthest"};
+
+// When the points of the faces an iteration removes go to the new faces
+enum QhAssignment
+{
+    // Right away, every orphan to the first new face it is outside of
+    QhAssignment_Eager,
+    // Parked in a pending bucket shared by the new faces, and handed out when
+    // one of them is taken off faceStack. A face that is removed before that
+    // hands the bucket to the bucket's other faces, and what they leave moves
+    // on untested. Only with QhScheduling_Furthest, the stack takes the new
+    // faces right away, so there is nothing to skip. Points inside the hull
+    // stay in the buckets until they are handed out, so this only tests less
+    // than eager when nearly every point ends up on the hull.
+    QhAssignment_Deferred,
+    QhAssignment_Count
+};
+
+static const char *qhAssignmentNames[QhAssignment_Count] = {"eager", "deferred"};
+
 struct QhNeighbour
 {
     int faceHandle;
@@ -16,44 +62,103 @@ struct QhNeighbour
     int endVertex;
 };
 
+// Inline room for the faces around a typical hull vertex
+#define QH_INLINE_FACE_HANDLES 6
+
+template<typename S>
 struct QhVertex
 {
-    List<int> faceHandles;
+    List<int, QH_INLINE_FACE_HANDLES> faceHandles;
     
     bool assigned;
     int vertexIndex;
     
-    glm::vec3 position;
-    glm::vec3 normal;
-    glm::vec4 color;
+    position_t<S> position;
 };
 
 #define MAX_NEIGHBOURS 16
 
+template<typename S>
 struct QhFace
 {
-    List<int> vertices;
+    List<int, 3> vertices;
     List<int> outsideSet;
     
     int furthestPointIndex;
+    // how far furthestPointIndex is from the face, set while reassigning
+    S furthestDistance;
+    // the largest distance of the other outside points
+    S nextDistance;
+    // QhHull::pendingBuckets index while the face's points are still in one, else -1
+    int pendingBucket;
     
     QhNeighbour neighbours[MAX_NEIGHBOURS];
     size_t neighbourCount;
     
     int indexInHull;
+    // position in QhHull::faceOfSerial, never changes while the face lives
+    int serial;
     bool visited;
     bool visitedV;
     
-    glm::vec3 faceNormal;
-    glm::vec3 centerPoint;
+    // plane through the vertices, see qhComputeFacePlane
+    PredicatePlane plane;
+    double inverseNormalLength;
+    position_t<S> faceNormal;
+    position_t<S> centerPoint;
     glm::vec4 faceColor;
 };
 
+// A face waiting to be expanded. Faces move when others are removed, so it's
+// found again through its serial. distance orders the heap with QhScheduling_Furthest.
+template<typename S>
+struct QhScheduledFace
+{
+    S distance;
+    int serial;
+    // queued on its pending bucket's distance, see QhAssignment_Deferred
+    bool pending;
+};
+
+// The orphans of one iteration with QhAssignment_Deferred, waiting for the
+// faces that iteration built
+template<typename S>
+struct QhPendingBucket
+{
+    List<int> points;
+    // serials of the faces, the removed ones are skipped
+    List<int> faces;
+    // the faces are queued with this until the points are handed out: the
+    // largest distance the points had to the faces they came from
+    S distance;
+};
+
+// A heap buffer taken from an emptied list, see qhReleaseBuffer
+struct QhBuffer
+{
+    int* data;
+    size_t capacity;
+};
+
+template<typename S>
 struct QhHull
 {
-    List<QhFace> faces;
+    List<QhFace<S>> faces;
     Mesh* m;
     
+    // current handle of every face added so far by serial, -1 once removed
+    List<int> faceOfSerial;
+    QhScheduling scheduling;
+    QhAssignment assignment;
+    
+    // Buckets of QhAssignment_Deferred, slots in freePendingBuckets are unused
+    // and keep their buffers
+    List<QhPendingBucket<S>> pendingBuckets;
+    List<int> freePendingBuckets;
+    
+    // Centroid of the initial simplex, strictly inside every later hull
+    position_t<S> interiorPoint;
+    
     struct
     {
         int addedFaces;
@@ -62,65 +167,326 @@ struct QhHull
         unsigned long long sidednessQueries;
         int verticesInHull;
         unsigned long long timeSpent;
+        PhaseTimes phases;
     } processingState;
     
+    // Heap buffers of emptied outside sets and face handle lists, handed to the
+    // next list that outgrows its inline storage instead of allocating
+    List<QhBuffer> freeOutsideSets;
+    List<QhBuffer> freeFaceHandles;
+    
+    // Points still looking for an outside set, and the ones qhPartitionOutside
+    // found outside the face at hand with their distances
+    List<int> pendingPoints;
+    List<position_t<S>> pendingPositions;
+    List<int> outsidePoints;
+    List<S> outsideDistances;
+    
+    // threads for the passes over every point that start the hull, 0 or 1
+    // keeps them on the calling thread
+    int threadCount;
+    
+    // min/max x, y and z as qhFindExtremePoints writes them, found while
+    // qhCopyVertices copied the points
+    int extremePoints[6];
+    bool hasExtremePoints;
+    
     bool finished;
     bool failed;
 };
 
+// Every buffer in the context keeps its capacity between runs, so hulling point
+// sets of similar size back to back stops allocating once the buffers have grown.
+// qhFreeContext gives the memory back.
+template<typename S>
 struct QhContext
 {
     bool initialized;
     
-    QhVertex* vertices;
+    QhVertex<S>* vertices;
+    int vertexCapacity;
     int numberOfPoints;
-    std::vector<int> faceStack;
-    coord_t epsilon;
+    std::vector<QhScheduledFace<S>> faceStack;
     QHIteration iter;
-    QhFace* currentFace;
+    QhFace<S>* currentFace;
     std::vector<int> v;
     size_t previousIteration;
-    QhHull qHull;
+    QhHull<S> qHull;
     
     std::vector<Edge> horizon;
+    std::vector<int> uniqueInV;
 };
 
-static void qhCopyVertices(QhContext& q, Vertex* vertices, int numberOfPoints)
+// Empties list and puts its heap buffer, if any, into the pool
+template<size_t N>
+static void qhReleaseBuffer(List<QhBuffer>& pool, List<int, N>& list)
 {
-    q.vertices = (QhVertex*)malloc(sizeof(QhVertex) * numberOfPoints);
-    for(int i = 0; i < numberOfPoints; i++)
+    QhBuffer buffer = {};
+    buffer.data = releaseBuffer(list, buffer.capacity);
+    if(buffer.data)
     {
-        init(q.vertices[i].faceHandles);
-        q.vertices[i].vertexIndex = i;
-        q.vertices[i].position = vertices[i].position;
-        q.vertices[i].normal = vertices[i].normal;
-        q.vertices[i].color = vertices[i].color;
+        addToList(pool, buffer);
     }
 }
 
-// t=nn·v1−nn·p
-// p0=p+t·nn
-coord_t qhDistancePointToFace(QhHull &q, QhFace f, QhVertex v)
+// Call before adding to list. If the list is about to outgrow its inline
+// storage, it gets a pooled buffer instead of a new allocation.
+template<size_t N>
+static void qhTakeBuffer(List<QhBuffer>& pool, List<int, N>& list)
 {
-    q.processingState.distanceQueryCount++;
-    return glm::abs((glm::dot(f.faceNormal, v.position) - glm::dot(f.faceNormal, f.centerPoint))); 
+    if(list.heap || list.size < list.capacity || pool.size == 0)
+    {
+        return;
+    }
+    
+    auto buffer = pool[pool.size - 1];
+    pool.size--;
+    adoptBuffer(list, buffer.data, buffer.capacity);
 }
 
-static bool qhIsPointOnPositiveSide(QhHull &q, QhFace f, QhVertex v, coord_t epsilon = 0.0)
+template<typename S>
+static bool qhDefersAssignment(const QhHull<S>& qHull)
 {
-    q.processingState.sidednessQueries++;
-    auto d = glm::dot(f.faceNormal, v.position - f.centerPoint);
-    return d > epsilon;
+    return qHull.scheduling == QhScheduling_Furthest && qHull.assignment == QhAssignment_Deferred;
+}
+
+// An empty bucket, from the unused slots if there are any
+template<typename S>
+static int qhTakePendingBucket(QhHull<S>& qHull)
+{
+    if(qHull.freePendingBuckets.size > 0)
+    {
+        auto bucketIndex = qHull.freePendingBuckets[qHull.freePendingBuckets.size - 1];
+        qHull.freePendingBuckets.size--;
+        return bucketIndex;
+    }
+    QhPendingBucket<S> bucket = {};
+    addToList(qHull.pendingBuckets, bucket);
+    return (int)qHull.pendingBuckets.size - 1;
+}
+
+template<typename S>
+static void qhReleasePendingBucket(QhHull<S>& qHull, int bucketIndex)
+{
+    qHull.pendingBuckets[bucketIndex].points.size = 0;
+    qHull.pendingBuckets[bucketIndex].faces.size = 0;
+    addToList(qHull.freePendingBuckets, bucketIndex);
+}
+
+// Points a thread has to scan before it pays for starting it
+#define QH_MIN_POINTS_PER_THREAD 65536
+
+// Splits [0, count) into one chunk per thread, runs scan(begin, end, result) on
+// each and folds the results in chunk order with merge(result, chunkResult), so
+// ties go the same way as in a single scan over everything
+template<typename R, typename Scan, typename Merge>
+static R qhParallelScan(int count, int threadCount, R initial, Scan scan, Merge merge)
+{
+    auto chunkCount = Max(1, Min(threadCount, count / QH_MIN_POINTS_PER_THREAD));
+    if(chunkCount == 1)
+    {
+        scan(0, count, initial);
+        return initial;
+    }
+    
+    std::vector<R> results((size_t)chunkCount, initial);
+    parallelFor(chunkCount, chunkCount, [&](int beginChunk, int endChunk)
+    {
+        for(int chunk = beginChunk; chunk < endChunk; chunk++)
+        {
+            scan((int)((long long)count * chunk / chunkCount), (int)((long long)count * (chunk + 1) / chunkCount), results[chunk]);
+        }
+    });
+    
+    auto result = results[0];
+    for(int chunk = 1; chunk < chunkCount; chunk++)
+    {
+        merge(result, results[chunk]);
+    }
+    return result;
 }
 
-static bool qhIsPointOnPositiveSide(QhHull &q, QhFace f, glm::vec3 v, coord_t epsilon = 0.0)
+// The first points with the lowest and highest x, y and z of a range, in the
+// order min x, max x, min y, max y, min z, max z
+template<typename S>
+struct QhExtremes
+{
+    int index[6];
+    S value[6];
+};
+
+template<typename S>
+static void qhExtremesBegin(QhExtremes<S>& e, int index, const position_t<S>& p)
+{
+    for(int axis = 0; axis < 3; axis++)
+    {
+        e.index[axis * 2] = e.index[axis * 2 + 1] = index;
+        e.value[axis * 2] = e.value[axis * 2 + 1] = p[axis];
+    }
+}
+
+template<typename S>
+static void qhExtremesAdd(QhExtremes<S>& e, int index, const position_t<S>& p)
+{
+    for(int axis = 0; axis < 3; axis++)
+    {
+        if(p[axis] < e.value[axis * 2])
+        {
+            e.value[axis * 2] = p[axis];
+            e.index[axis * 2] = index;
+        }
+        if(p[axis] > e.value[axis * 2 + 1])
+        {
+            e.value[axis * 2 + 1] = p[axis];
+            e.index[axis * 2 + 1] = index;
+        }
+    }
+}
+
+template<typename S>
+static void qhMergeExtremes(QhExtremes<S>& into, const QhExtremes<S>& from)
+{
+    for(int axis = 0; axis < 3; axis++)
+    {
+        if(from.value[axis * 2] < into.value[axis * 2])
+        {
+            into.value[axis * 2] = from.value[axis * 2];
+            into.index[axis * 2] = from.index[axis * 2];
+        }
+        if(from.value[axis * 2 + 1] > into.value[axis * 2 + 1])
+        {
+            into.value[axis * 2 + 1] = from.value[axis * 2 + 1];
+            into.index[axis * 2 + 1] = from.index[axis * 2 + 1];
+        }
+    }
+}
+
+// The first point furthest along some measure, and how far
+template<typename S>
+struct QhFurthest
+{
+    int index;
+    S distance;
+};
+
+template<typename S>
+static void qhMergeFurthest(QhFurthest<S>& into, const QhFurthest<S>& from)
+{
+    if(from.distance > into.distance)
+    {
+        into = from;
+    }
+}
+
+// Takes Vertex or PrecisePoint input, anything with a position
+template<typename S, typename P>
+static void qhCopyVertices(QhContext<S>& q, P* vertices, int numberOfPoints)
+{
+    // Lists only hold data() relative pointers, so the vertices can be moved by realloc
+    if(numberOfPoints > q.vertexCapacity)
+    {
+        q.vertices = (QhVertex<S>*)memReallocLarge(q.vertices, sizeof(QhVertex<S>) * numberOfPoints);
+        for(int i = q.vertexCapacity; i < numberOfPoints; i++)
+        {
+            init(q.vertices[i].faceHandles);
+        }
+        q.vertexCapacity = numberOfPoints;
+    }
+    
+    // The extreme points of the initial simplex come out of the copy, which
+    // saves qhGenerateInitialSimplex a pass over every point
+    auto extremes = qhParallelScan(numberOfPoints, q.qHull.threadCount, QhExtremes<S>{}, [&](int begin, int end, QhExtremes<S>& e)
+    {
+        if(begin < end)
+        {
+            qhExtremesBegin(e, begin, position_t<S>(vertices[begin].position));
+        }
+        for(int i = begin; i < end; i++)
+        {
+            q.vertices[i].faceHandles.size = 0;
+            q.vertices[i].assigned = false;
+            q.vertices[i].vertexIndex = i;
+            q.vertices[i].position = position_t<S>(vertices[i].position);
+            qhExtremesAdd(e, i, q.vertices[i].position);
+        }
+    }, qhMergeExtremes<S>);
+    
+    q.qHull.hasExtremePoints = numberOfPoints > 0;
+    for(int i = 0; i < 6; i++)
+    {
+        q.qHull.extremePoints[i] = extremes.index[i];
+    }
+}
+
+// Distance of p from the plane of f, positive outside
+template<typename S>
+static S qhPlaneDistance(const QhFace<S> &f, const position_t<S> &p)
+{
+    auto& normal = f.plane.normal;
+    return (S)((normal[0] * p.x + normal[1] * p.y + normal[2] * p.z - f.plane.offset) * f.inverseNormalLength);
+}
+
+// Exact test, points on the plane of f are not on its positive side. The
+// precomputed plane decides unless p is too close to it, orient3d does then.
+// The face normal points along (v1 - v0) x (v2 - v0), which is below the plane for orient3d.
+template<typename S>
+static bool qhIsPointOnPositiveSide(QhHull<S> &q, const QhFace<S> &f, const QhVertex<S>* vertices, const position_t<S> &p)
 {
     q.processingState.sidednessQueries++;
-    auto d = glm::dot(f.faceNormal, v - f.centerPoint);
-    return d > epsilon;
+    bool certain;
+    auto value = predicatePlaneValue(f.plane, p, certain);
+    if(certain)
+    {
+        return value > 0.0;
+    }
+    return orient3d(vertices[f.vertices[0]].position, vertices[f.vertices[1]].position, vertices[f.vertices[2]].position, p) < 0.0;
+}
+
+template<typename S>
+static bool qhIsPointOnPositiveSide(QhHull<S> &q, const QhFace<S> &f, const QhVertex<S>* vertices, const QhVertex<S> &v)
+{
+    return qhIsPointOnPositiveSide(q, f, vertices, v.position);
 }
 
-static void qhFindNeighbours(int v1Handle, int v2Handle, QhHull &q, QhFace& f, QhVertex* vertices)
+// Tests the points in indices[0..count), whose positions are packed in
+// positions, against f. Each gets the exact side of qhIsPointOnPositiveSide and
+// the distance of qhPlaneDistance out of one evaluation of the plane. The ones
+// outside go to outside with their distances in distances, the others are
+// packed to the front of indices and positions, both keeping their order.
+// Only the distances of points outside are used, so only those count as
+// distance queries. Returns how many were outside.
+template<typename S>
+static int qhPartitionOutside(QhHull<S> &q, const QhFace<S> &f, const QhVertex<S>* vertices, int* indices, position_t<S>* positions, int count, int* outside, S* distances)
+{
+    int outsideCount = 0;
+    int insideCount = 0;
+    for(int i = 0; i < count; i++)
+    {
+        auto index = indices[i];
+        auto p = positions[i];
+        bool certain;
+        auto value = predicatePlaneValue(f.plane, p, certain);
+        auto isOutside = certain ? value > 0.0 : orient3d(vertices[f.vertices[0]].position, vertices[f.vertices[1]].position, vertices[f.vertices[2]].position, p) < 0.0;
+        if(isOutside)
+        {
+            outside[outsideCount] = index;
+            distances[outsideCount] = (S)(value * f.inverseNormalLength);
+            outsideCount++;
+        }
+        else
+        {
+            indices[insideCount] = index;
+            positions[insideCount] = p;
+            insideCount++;
+        }
+    }
+    q.processingState.sidednessQueries += (unsigned long long)count;
+    q.processingState.distanceQueryCount += (unsigned long long)outsideCount;
+    return outsideCount;
+}
+
+template<typename S>
+static void qhFindNeighbours(int v1Handle, int v2Handle, QhHull<S> &q, QhFace<S>& f, QhVertex<S>* vertices)
 {
     auto& v1 = vertices[v1Handle];
     auto& v2 = vertices[v2Handle];
@@ -218,28 +584,22 @@ static void qhFindNeighbours(int v1Handle, int v2Handle, QhHull &q, QhFace& f, Q
     }
 }
 
-static glm::vec3 ComputeFaceNormal(QhFace f, QhVertex* vertices)
+// Sets up the plane of f from its vertices, again whenever they're reordered.
+// For a triangle the plane's normal is the one Newell's method gives.
+template<typename S>
+static void qhComputeFacePlane(QhFace<S>& f, QhVertex<S>* vertices)
 {
-    // Newell's Method
-    // https://www.khronos.org/opengl/wiki/Calculating_a_Surface_Normal
-    glm::vec3 normal = glm::vec3(0.0);
-    
-    for(size_t i = 0; i < f.vertices.size; i++)
-    {
-        auto& current = vertices[f.vertices[i]].position;
-        auto& next = vertices[f.vertices[(i + 1) % 3]].position;
-        
-        normal.x = normal.x + (current.y - next.y) * (current.z + next.z);
-        normal.y = normal.y + (current.z - next.z) * (current.x + next.x);
-        normal.z = normal.z + (current.x - next.x) * (current.y + next.y);
-    }
+    predicatePlaneBegin(f.plane, vertices[f.vertices[0]].position, vertices[f.vertices[1]].position, vertices[f.vertices[2]].position);
     
-    return glm::normalize(normal);
+    auto normal = glm::dvec3(f.plane.normal[0], f.plane.normal[1], f.plane.normal[2]);
+    f.inverseNormalLength = 1.0 / glm::length(normal);
+    f.faceNormal = position_t<S>(normal * f.inverseNormalLength);
 }
 
-static QhFace* qhAddFace(QhHull& q, List<int> &vertexHandles, QhVertex* vertices)
+template<typename S>
+static QhFace<S>* qhAddFace(QhHull<S>& q, List<int, 3> &vertexHandles, QhVertex<S>* vertices)
 {
-    QhFace newFace = {};
+    QhFace<S> newFace = {};
     
     init(newFace.vertices, 3);
     
@@ -259,20 +619,22 @@ static QhFace* qhAddFace(QhHull& q, List<int> &vertexHandles, QhVertex* vertices
         }
     }
     
-    auto center = glm::vec3();
+    auto center = position_t<S>(0);
     
     for(size_t i = 0; i < vertexHandles.size; i++)
     {
         center += vertices[newFace.vertices[i]].position;
     }
     
-    newFace.centerPoint = glm::vec3(center.x / vertexHandles.size, center.y / vertexHandles.size, center.z / vertexHandles.size);
+    newFace.centerPoint = center / (S)vertexHandles.size;
     
     newFace.outsideSet = {};
+    newFace.pendingBucket = -1;
     q.processingState.addedFaces++;
     
     newFace.neighbourCount = 0;
     newFace.indexInHull = (int)q.faces.size;
+    newFace.serial = (int)q.faceOfSerial.size;
     
     for(size_t i = 0; i < vertexHandles.size; i++)
     {
@@ -283,6 +645,7 @@ static QhFace* qhAddFace(QhHull& q, List<int> &vertexHandles, QhVertex* vertices
             q.processingState.verticesInHull++;
         }
         
+        qhTakeBuffer(q.freeFaceHandles, v1.faceHandles);
         addToList(v1.faceHandles, newFace.indexInHull);
         
         for(size_t j = 0; j < vertexHandles.size; j++)
@@ -297,18 +660,20 @@ static QhFace* qhAddFace(QhHull& q, List<int> &vertexHandles, QhVertex* vertices
         }
     }
     
-    newFace.faceNormal = ComputeFaceNormal(newFace, vertices);
+    qhComputeFacePlane(newFace, vertices);
     
     newFace.faceColor = rgb(0, 255, 55);
     newFace.faceColor.w = 0.5f;
     
     addToList(q.faces, newFace);
+    addToList(q.faceOfSerial, newFace.indexInHull);
     
     return &q.faces[q.faces.size - 1];
 }
 
 // Returns index of moved mesh
-static int qhRemoveFace(QhHull& qHull, int faceId, QhVertex* vertices)
+template<typename S>
+static int qhRemoveFace(QhHull<S>& qHull, int faceId, QhVertex<S>* vertices)
 {
     if(qHull.faces.size == 0 || faceId < 0)
     {
@@ -339,6 +704,7 @@ static int qhRemoveFace(QhHull& qHull, int faceId, QhVertex* vertices)
     }
     
     auto indexInHull = f.indexInHull;
+    auto removedSerial = f.serial;
     
     for(size_t i = 0; i < f.vertices.size; i++)
     {
@@ -356,13 +722,13 @@ static int qhRemoveFace(QhHull& qHull, int faceId, QhVertex* vertices)
         
         if(v1.faceHandles.size == 0)
         {
-            clear(v1.faceHandles);
+            qhReleaseBuffer(qHull.freeFaceHandles, v1.faceHandles);
             qHull.processingState.verticesInHull--;
         }
     }
     
     clear(f.vertices);
-    clear(f.outsideSet);
+    qhReleaseBuffer(qHull.freeOutsideSets, f.outsideSet);
     
     // Invalidates the f pointer
     // But we only need to swap two faces to make this work
@@ -404,6 +770,8 @@ static int qhRemoveFace(QhHull& qHull, int faceId, QhVertex* vertices)
     }
     
     newFace.indexInHull = indexInHull;
+    qHull.faceOfSerial[newFace.serial] = indexInHull;
+    qHull.faceOfSerial[removedSerial] = -1;
     return indexInHull;
 }
 
@@ -413,84 +781,69 @@ coord_t qhDistanceBetweenPoints(Vertex& p1, Vertex& p2)
     return glm::distance(p1.position, p2.position);
 }
 
-coord_t qhSquareDistancePointToSegment(glm::vec3 a, glm::vec3 b, glm::vec3 c)
+template<typename S>
+S qhSquareDistancePointToSegment(position_t<S> a, position_t<S> b, position_t<S> c)
 {
-    glm::vec3 ab = b - a;
-    glm::vec3 ac = c - a;
-    glm::vec3 bc = c - b;
+    position_t<S> ab = b - a;
+    position_t<S> ac = c - a;
+    position_t<S> bc = c - b;
     
-    coord_t e = glm::dot(ac, ab);
+    S e = glm::dot(ac, ab);
     
     if(e <= 0.0) return glm::dot(ac, ac);
-    coord_t f = glm::dot(ab, ab);
+    S f = glm::dot(ab, ab);
     if( e >= f) return glm::dot(bc, bc);
     
     return glm::dot(ac, ac) - (e * e) / f;
 }
 
+template<typename S>
 struct VertexPair
 {
-    QhVertex first;
-    QhVertex second;
+    QhVertex<S> first;
+    QhVertex<S> second;
 };
 
-int* qhFindExtremePoints(QhVertex* points, int numPoints)
+// Writes the indices of the points with min/max x, y and z to res, in one pass
+// over the positions
+template<typename S>
+void qhFindExtremePoints(QhVertex<S>* points, int numPoints, int threadCount, int res[6])
 {
-    if(numPoints > 0)
-    {
-        auto minX = 0;
-        auto maxX = 0;
-        auto minY = 0;
-        auto maxY = 0;
-        auto minZ = 0;
-        auto maxZ = 0;
-        
-        for(int i = 0; i < numPoints; i++)
+    if(numPoints <= 0)
+    {
+        return;
+    }
+    
+    auto extremes = qhParallelScan(numPoints, threadCount, QhExtremes<S>{}, [&](int begin, int end, QhExtremes<S>& e)
+    {
+        qhExtremesBegin(e, begin, points[begin].position);
+        for(int i = begin + 1; i < end; i++)
         {
-            auto& p = points[i];
-            if(p.position.x > points[maxX].position.x)
-            {
-                maxX = i;
-            }
-            if(p.position.x < points[minX].position.x)
-            {
-                minX = i;
-            }
-            if(p.position.y > points[maxY].position.y)
-            {
-                maxY = i;
-            }
-            if(p.position.y < points[minY].position.y)
-            {
-                minY = i;
-            }
-            if(p.position.z > points[maxZ].position.z)
-            {
-                maxZ = i;
-            }
-            if(p.position.z < points[minZ].position.z)
-            {
-                minZ = i;
-            }
+            qhExtremesAdd(e, i, points[i].position);
         }
-        int* res = (int*)malloc(sizeof(int) * 6);
-        res[0] = minX;
-        res[1] = maxX;
-        res[2] = minY;
-        res[3] = maxY;
-        res[4] = minZ;
-        res[5] = maxZ;
-        return res;
+    }, qhMergeExtremes<S>);
+    
+    for(int i = 0; i < 6; i++)
+    {
+        res[i] = extremes.index[i];
     }
-    return nullptr;
 }
 
-coord_t qhGenerateInitialSimplex(QhVertex* vertices, int numVertices, QhHull& q)
+template<typename S>
+void qhGenerateInitialSimplex(QhVertex<S>* vertices, int numVertices, QhHull<S>& q)
 {
     // First we find all 6 extreme points in the whole point set
-    auto extremePoints = qhFindExtremePoints(vertices, numVertices);
+    int extremePoints[6] = {};
+    if(q.hasExtremePoints)
+    {
+        memcpy(extremePoints, q.extremePoints, sizeof(extremePoints));
+    }
+    else
+    {
+        qhFindExtremePoints(vertices, numVertices, q.threadCount, extremePoints);
+    }
     
-    VertexPair mostDistantPair = {};
+    VertexPair<S> mostDistantPair = {};
     auto dist = 0.0;
     auto mostDist1 = -1;
     auto mostDist2 = -1;
@@ -515,45 +868,26 @@ coord_t qhGenerateInitialSimplex(QhVertex* vertices, int numVertices, QhHull& q)
         }
     }
     
-    auto extremePointCurrentFurthest = 0.0L;
-    auto extremePointCurrentIndex = 0;
-    
     // Find the point that is furthest away from the segment 
     // spanned by the two extreme points
-    for(int i = 0; i < numVertices; i++)
+    auto segmentStart = mostDistantPair.first.position;
+    auto segmentEnd = mostDistantPair.second.position;
+    auto furthestFromSegment = qhParallelScan(numVertices, q.threadCount, QhFurthest<S>{}, [&](int begin, int end, QhFurthest<S>& furthest)
     {
-        auto distance = qhSquareDistancePointToSegment(mostDistantPair.first.position, mostDistantPair.second.position, vertices[i].position);
-        if(distance > extremePointCurrentFurthest)
+        for(int i = begin; i < end; i++)
         {
-            extremePointCurrentIndex = i;
-            extremePointCurrentFurthest = distance;
+            auto distance = qhSquareDistancePointToSegment(segmentStart, segmentEnd, vertices[i].position);
+            if(distance > furthest.distance)
+            {
+                furthest.index = i;
+                furthest.distance = distance;
+            }
         }
-    }
-    
-    coord_t maxX = 0.0;
-    coord_t maxY = 0.0;
-    coord_t maxZ = 0.0;
-    
-    for(int i = 0; i < numVertices; i++)
-    {
-        auto v = vertices[i].position;
-        auto curX = Abs(v.x);
-        auto curY = Abs(v.y);
-        auto curZ = Abs(v.z);
-        
-        if(curX > maxX)
-            maxX = curX;
-        if(curY > maxY)
-            maxY = curY;
-        if(curZ > maxZ)
-            maxZ = curZ;
-    }
+    }, qhMergeFurthest<S>);
+    auto extremePointCurrentIndex = furthestFromSegment.index;
     
-    auto epsilon = 3 * (maxX + maxY + maxZ) * FLT_EPSILON;
-    //printf("Epsilon: %f\n", epsilon);
-    //auto epsilon = 0.0f;
     
-    List<int> mostDistList = {};
+    List<int, 3> mostDistList = {};
     init(mostDistList);
     
     addToList(mostDistList, {mostDist1, mostDist2, extremePointCurrentIndex});
@@ -563,35 +897,41 @@ coord_t qhGenerateInitialSimplex(QhVertex* vertices, int numVertices, QhHull& q)
     clear(mostDistList);
     if(!f)
     {
-        return epsilon;
+        return;
     }
     
-    auto currentFurthest = 0.0L;
-    auto currentIndex = 0;
-    
-    // Now find the points furthest away from the face
-    for(int i = 0; i < numVertices; i++)
+    // Now find the points furthest away from the face, on either side
+    auto& face = *f;
+    auto furthestFromFace = qhParallelScan(numVertices, q.threadCount, QhFurthest<S>{}, [&](int begin, int end, QhFurthest<S>& furthest)
     {
-        if(i == mostDist1 || i == mostDist2 || i == extremePointCurrentIndex)
-        {
-            continue;
-        }
-        
-        auto distance = qhDistancePointToFace(q, *f, vertices[i]);
-        if(distance > currentFurthest)
+        for(int i = begin; i < end; i++)
         {
-            currentIndex = i;
-            currentFurthest = distance;
+            if(i == mostDist1 || i == mostDist2 || i == extremePointCurrentIndex)
+            {
+                continue;
+            }
+            
+            auto distance = glm::abs(qhPlaneDistance(face, vertices[i].position));
+            if(distance > furthest.distance)
+            {
+                furthest.index = i;
+                furthest.distance = distance;
+            }
         }
-    }
+    }, qhMergeFurthest<S>);
+    auto currentIndex = furthestFromFace.index;
+    auto skipped = 1 + (mostDist2 != mostDist1 ? 1 : 0) + (extremePointCurrentIndex != mostDist1 && extremePointCurrentIndex != mostDist2 ? 1 : 0);
+    q.processingState.distanceQueryCount += (unsigned long long)(numVertices - skipped);
+    
+    q.interiorPoint = (vertices[mostDist1].position + vertices[mostDist2].position + vertices[extremePointCurrentIndex].position + vertices[currentIndex].position) * (S)0.25;
     
-    if(qhIsPointOnPositiveSide(q, *f, vertices[currentIndex], epsilon))
+    if(qhIsPointOnPositiveSide(q, *f, vertices, vertices[currentIndex]))
     {
         auto t = f->vertices[0];
         f->vertices[0] = f->vertices[1];
         f->vertices[1] = t;
-        f->faceNormal = ComputeFaceNormal(*f, vertices);
-        List<int> list = {};
+        qhComputeFacePlane(*f, vertices);
+        List<int, 3> list = {};
         init(list);
         
         addToList(list, {mostDist1, currentIndex, extremePointCurrentIndex});
@@ -599,7 +939,7 @@ coord_t qhGenerateInitialSimplex(QhVertex* vertices, int numVertices, QhHull& q)
         qhAddFace(q, list, vertices);
         clear(list, 3);
         if(q.failed)
-            return epsilon;
+            return;
         
         
         addToList(list, {currentIndex, mostDist2, extremePointCurrentIndex});
@@ -608,18 +948,18 @@ coord_t qhGenerateInitialSimplex(QhVertex* vertices, int numVertices, QhHull& q)
         clear(list, 3);
         
         if(q.failed)
-            return epsilon;
+            return;
         
         addToList(list, {mostDist1, mostDist2, currentIndex});
         
         qhAddFace(q, list, vertices);
         clear(list);
         if(q.failed)
-            return epsilon;
+            return;
     }
     else
     {
-        List<int> list = {};
+        List<int, 3> list = {};
         init(list, 3);
         
         
@@ -628,7 +968,7 @@ coord_t qhGenerateInitialSimplex(QhVertex* vertices, int numVertices, QhHull& q)
         qhAddFace(q, list, vertices);
         clear(list, 3);
         if(q.failed)
-            return epsilon;
+            return;
         
         
         addToList(list, {mostDist2, currentIndex, extremePointCurrentIndex});
@@ -637,7 +977,7 @@ coord_t qhGenerateInitialSimplex(QhVertex* vertices, int numVertices, QhHull& q)
         clear(list, 3);
         
         if(q.failed)
-            return epsilon;
+            return;
         
         
         addToList(list, {mostDist2, mostDist1, currentIndex});
@@ -646,53 +986,79 @@ coord_t qhGenerateInitialSimplex(QhVertex* vertices, int numVertices, QhHull& q)
         clear(list);
         
         if(q.failed)
-            return epsilon;
+            return;
         
     }
-    free(extremePoints);
-    return epsilon;
+    return;
 }
 
-void qhAddToOutsideSet(QhFace& f, QhVertex& v)
+template<typename S>
+void qhAddToOutsideSet(QhHull<S>& q, QhFace<S>& f, QhVertex<S>& v)
 {
     //f.outsideSet.push_back(v.vertexIndex);
+    qhTakeBuffer(q.freeOutsideSets, f.outsideSet);
     addToList(f.outsideSet, v.vertexIndex);
     v.assigned = true;
 }
 
-void qhAssignToOutsideSets(QhHull& q, QhVertex* vertices, int numVertices, List<QhFace> faces, coord_t epsilon)
+// Moves the points in pending that are outside f to its outside set, the
+// others stay pending in the same order
+template<typename S>
+static void qhClaimOutsidePoints(QhHull<S>& q, QhFace<S>& f, QhVertex<S>* vertices)
 {
-    std::vector<QhVertex> unassigned(vertices, vertices + numVertices);
-    
-    for(size_t vertexIndex = 0; vertexIndex < unassigned.size(); vertexIndex++)
+    auto& pending = q.pendingPoints;
+    reserve(q.outsidePoints, pending.size);
+    reserve(q.outsideDistances, pending.size);
+    auto outsideCount = qhPartitionOutside(q, f, vertices, pending.data(), q.pendingPositions.data(), (int)pending.size, q.outsidePoints.data(), q.outsideDistances.data());
+    pending.size -= (size_t)outsideCount;
+    q.pendingPositions.size = pending.size;
+    
+    for(int i = 0; i < outsideCount; i++)
     {
-        auto& vert = vertices[unassigned[vertexIndex].vertexIndex];
+        auto& v = vertices[q.outsidePoints.data()[i]];
+        auto distance = q.outsideDistances.data()[i];
         
-        if(vert.faceHandles.size > 0)
+        // The first point always counts, the rounded distance of a point
+        // that is exactly outside can still come out as 0 or less
+        if(distance > f.furthestDistance || f.outsideSet.size == 0)
         {
-            continue;
+            f.nextDistance = f.furthestDistance;
+            f.furthestDistance = distance;
+            f.furthestPointIndex = v.vertexIndex;
         }
-        
-        for(auto &f : faces)
+        else if(distance > f.nextDistance)
         {
-            coord_t currentDist = 0.0;
-            int currentDistIndex = 0;
-            
-            if(qhIsPointOnPositiveSide(q, f, unassigned[vertexIndex], epsilon))
-            {
-                auto v = unassigned[vertexIndex];
-                auto newDist = qhDistancePointToFace(q, f, v);
-                if(newDist > currentDistIndex)
-                {
-                    currentDist = newDist;
-                    currentDistIndex = v.vertexIndex;
-                    f.furthestPointIndex = currentDistIndex;
-                }
-                
-                qhAddToOutsideSet(f, v);
-                break;
-            }
+            f.nextDistance = distance;
         }
+        qhAddToOutsideSet(q, f, v);
+    }
+}
+
+// Every point not on the hull goes to the outside set of the first face it is
+// outside of. The faces take their points one after the other out of the ones
+// still pending, which gives the same sets as trying every point on the faces
+// in turn.
+template<typename S>
+void qhAssignToOutsideSets(QhHull<S>& q, QhVertex<S>* vertices, int numVertices, List<QhFace<S>>& faces)
+{
+    q.pendingPoints.size = 0;
+    q.pendingPositions.size = 0;
+    reserve(q.pendingPoints, (size_t)numVertices);
+    reserve(q.pendingPositions, (size_t)numVertices);
+    for(int vertexIndex = 0; vertexIndex < numVertices; vertexIndex++)
+    {
+        if(vertices[vertexIndex].faceHandles.size == 0)
+        {
+            q.pendingPoints.data()[q.pendingPoints.size++] = vertexIndex;
+            q.pendingPositions.data()[q.pendingPositions.size++] = vertices[vertexIndex].position;
+        }
+    }
+    
+    for(auto &f : faces)
+    {
+        if(q.pendingPoints.size == 0)
+            break;
+        qhClaimOutsidePoints(q, f, vertices);
     }
 }
 
@@ -746,19 +1112,20 @@ bool qhHorizonValid(std::vector<Edge>& horizon)
     return true;
 }
 
-void qhFindConvexHorizon(QhVertex& viewPoint, std::vector<int>& faces, QhHull& qHull, std::vector<Edge>& list, coord_t epsilon)
+template<typename S>
+void qhFindConvexHorizon(QhVertex<S>& viewPoint, std::vector<int>& faces, QhHull<S>& qHull, QhVertex<S>* vertices, std::vector<Edge>& list)
 {
-    std::vector<int> possibleVisibleFaces(faces);
-    for(size_t faceIndex = 0; faceIndex < possibleVisibleFaces.size(); faceIndex++)
+    // faces grows while we walk it, so it is indexed rather than iterated
+    for(size_t faceIndex = 0; faceIndex < faces.size(); faceIndex++)
     {
-        auto& f = qHull.faces[possibleVisibleFaces[faceIndex]];
+        auto& f = qHull.faces[faces[faceIndex]];
         
         for(size_t neighbourIndex = 0; neighbourIndex < f.neighbourCount; neighbourIndex++)
         {
             auto& neighbour = f.neighbours[neighbourIndex];
             auto& neighbourFace = qHull.faces[neighbour.faceHandle];
             
-            if(!qhIsPointOnPositiveSide(qHull, neighbourFace, viewPoint, epsilon))
+            if(!qhIsPointOnPositiveSide(qHull, neighbourFace, vertices, viewPoint))
             {
                 Edge newEdge = {};
                 newEdge.origin = neighbour.originVertex;
@@ -770,15 +1137,26 @@ void qhFindConvexHorizon(QhVertex& viewPoint, std::vector<int>& faces, QhHull& q
             }
             else if(!neighbourFace.visited)
             {
-                possibleVisibleFaces.push_back(neighbour.faceHandle);
                 faces.push_back(neighbourFace.indexInHull);
             }
             neighbourFace.visited = true;
         }
     }
+    
+    // Only this walk reads visited, so it's cleared on the faces it touched
+    // rather than over the whole hull once the visible faces are gone
+    for(auto handle : faces)
+    {
+        auto& f = qHull.faces[handle];
+        for(size_t neighbourIndex = 0; neighbourIndex < f.neighbourCount; neighbourIndex++)
+        {
+            qHull.faces[f.neighbours[neighbourIndex].faceHandle].visited = false;
+        }
+    }
 }
 
-Mesh& qhConvertToMesh(RenderContext& renderContext, QhHull& qHull, Vertex* vertices)
+template<typename S>
+Mesh& qhConvertToMesh(RenderContext& renderContext, QhHull<S>& qHull, Vertex* vertices)
 {
     if(!qHull.m)
     {
@@ -802,87 +1180,188 @@ Mesh& qhConvertToMesh(RenderContext& renderContext, QhHull& qHull, Vertex* verti
         init(newFace.vertices, 3);
         for(size_t i = 0; i < f.vertices.size; i++)
         {
-            auto v = vertices[f.vertices.list[i]];
+            auto v = vertices[f.vertices[i]];
             addToList(newFace.vertices, v);
         }
         
-        newFace.faceNormal = f.faceNormal;
+        newFace.faceNormal = glm::vec3(f.faceNormal);
         newFace.faceColor = f.faceColor;
-        newFace.centerPoint = f.centerPoint;
+        newFace.centerPoint = glm::vec3(f.centerPoint);
         qHull.m->faces.push_back(newFace);
     }
     
-    if(qHull.finished)
+    return *qHull.m;
+}
+
+// Writes the finished hull to result, see HullResultFlags for flags
+template<typename S>
+void qhExtractResult(QhContext<S>& qhContext, HullResult<S>& result, int flags)
+{
+    auto& qHull = qhContext.qHull;
+    hullResultBegin(result, flags, qhContext.numberOfPoints, qHull.faces.size);
+    for(const auto& f : qHull.faces)
     {
-        for(auto &f : qHull.faces)
+        int inputIndex[3] = {f.vertices[0], f.vertices[1], f.vertices[2]};
+        const position_t<S>* position[3] = {};
+        for(int i = 0; i < 3; i++)
         {
-            clear(f.vertices);
-            clear(f.outsideSet);
+            position[i] = &qhContext.vertices[inputIndex[i]].position;
         }
-        clear(qHull.faces);
+        hullResultAddFace(result, inputIndex, position);
     }
-    
-    return *qHull.m;
 }
 
-QhHull qhInit(QhVertex* vertices, int numVertices, std::vector<int>& faceStack, coord_t* epsilon, QhHull *oldHull = nullptr)
+// Orders faceStack as a max heap on distance, the older face first on a tie
+template<typename S>
+static bool qhScheduledBefore(const QhScheduledFace<S>& a, const QhScheduledFace<S>& b)
 {
-    QhHull qHull = {};
-    
-    if(oldHull)
+    if(a.distance != b.distance)
+        return a.distance < b.distance;
+    return a.serial > b.serial;
+}
+
+// Queues f to be expanded, it must have a non empty outside set or a pending bucket
+template<typename S>
+static void qhScheduleFace(QhHull<S>& qHull, std::vector<QhScheduledFace<S>>& faceStack, QhFace<S>& f)
+{
+    auto pending = f.pendingBucket >= 0;
+    auto distance = pending ? qHull.pendingBuckets[f.pendingBucket].distance : f.furthestDistance;
+    faceStack.push_back({distance, f.serial, pending});
+    if(qHull.scheduling == QhScheduling_Furthest)
+    {
+        std::push_heap(faceStack.begin(), faceStack.end(), qhScheduledBefore<S>);
+    }
+}
+
+// Starts a new hull in qHull. The face list keeps its buffer, the buffers of the
+// outside sets and face handle lists go back to the pools.
+template<typename S>
+void qhInit(QhHull<S>& qHull, QhVertex<S>* vertices, int numVertices, std::vector<QhScheduledFace<S>>& faceStack)
+{
+    for(auto &f : qHull.faces)
+    {
+        qhReleaseBuffer(qHull.freeOutsideSets, f.outsideSet);
+    }
+    qHull.faces.size = 0;
+    qHull.faceOfSerial.size = 0;
+    for(int i = 0; i < numVertices; i++)
+    {
+        qhReleaseBuffer(qHull.freeFaceHandles, vertices[i].faceHandles);
+    }
+    qHull.freePendingBuckets.size = 0;
+    for(int i = 0; i < (int)qHull.pendingBuckets.size; i++)
     {
-        qHull.m = oldHull->m;
+        qhReleasePendingBucket(qHull, i);
     }
     
-    qHull.processingState.addedFaces = 0;
+    qHull.processingState = {};
     qHull.processingState.pointsProcessed = 4;
-    qHull.processingState.distanceQueryCount = 0;
-    qHull.processingState.sidednessQueries = 0;
-    qHull.processingState.verticesInHull = 0;
-    qHull.processingState.timeSpent = 0;
+    qHull.finished = false;
+    qHull.failed = false;
     
-    *epsilon = qhGenerateInitialSimplex(vertices, numVertices, qHull);
+    {
+        TIME_PHASE(qHull.processingState.phases, QhPhase_InitialSimplex);
+        qhGenerateInitialSimplex(vertices, numVertices, qHull);
+    }
     if(qHull.failed)
-        return qHull;
+        return;
     
-    qhAssignToOutsideSets(qHull, vertices, numVertices, qHull.faces, *epsilon);
+    {
+        TIME_PHASE(qHull.processingState.phases, QhPhase_OutsideSets);
+        qhAssignToOutsideSets(qHull, vertices, numVertices, qHull.faces);
+    }
     if(qHull.failed)
-        return qHull;
+        return;
     
     for(int i = 0; i < (int)qHull.faces.size; i++)
     {
         if(qHull.faces[i].outsideSet.size > 0)
         {
-            faceStack.push_back(qHull.faces[i].indexInHull);
+            qhScheduleFace(qHull, faceStack, qHull.faces[i]);
         }
     }
-    return qHull;
 }
 
-QhFace* qhFindNextIteration(QhHull& qHull, std::vector<int>& faceStack)
+// Hands the points of a pending bucket to its faces that stay on the hull, each
+// to the first one it is outside of, and queues the faces that got some on their
+// furthest point. Faces found visible from the current apex are skipped, the
+// points outside none of the others are left in pendingPoints.
+template<typename S>
+static void qhClaimPendingBucket(QhHull<S>& qHull, QhVertex<S>* vertices, std::vector<QhScheduledFace<S>>& faceStack, int bucketIndex)
 {
-    if(faceStack.size() == 0)
-        return nullptr;
-    
-    QhFace* res = nullptr;
-    
-    auto f = &qHull.faces[faceStack[faceStack.size() - 1]];
+    auto& bucket = qHull.pendingBuckets[bucketIndex];
+    qHull.pendingPoints.size = 0;
+    qHull.pendingPositions.size = 0;
+    reserve(qHull.pendingPoints, bucket.points.size);
+    reserve(qHull.pendingPositions, bucket.points.size);
+    for(auto index : bucket.points)
+    {
+        qHull.pendingPoints.data()[qHull.pendingPoints.size++] = index;
+        qHull.pendingPositions.data()[qHull.pendingPositions.size++] = vertices[index].position;
+    }
     
-    if(f && f->outsideSet.size > 0)
+    for(auto serial : bucket.faces)
     {
-        res = f;
+        auto handle = qHull.faceOfSerial[serial];
+        if(handle < 0)
+            continue;
+        
+        auto& f = qHull.faces[handle];
+        f.pendingBucket = -1;
+        if(f.visitedV || qHull.pendingPoints.size == 0)
+            continue;
+        
+        qhClaimOutsidePoints(qHull, f, vertices);
+        if(f.outsideSet.size > 0)
+        {
+            qhScheduleFace(qHull, faceStack, f);
+        }
     }
-    else
+    qhReleasePendingBucket(qHull, bucketIndex);
+}
+
+// Takes the next face to expand off faceStack, skipping the ones removed since
+// they were queued. Returns nullptr once the stack is empty.
+template<typename S>
+QhFace<S>* qhFindNextIteration(QhHull<S>& qHull, QhVertex<S>* vertices, std::vector<QhScheduledFace<S>>& faceStack)
+{
+    while(faceStack.size() > 0)
     {
-        res = nullptr;
+        if(qHull.scheduling == QhScheduling_Furthest)
+        {
+            std::pop_heap(faceStack.begin(), faceStack.end(), qhScheduledBefore<S>);
+        }
+        auto scheduled = faceStack.back();
+        auto handle = qHull.faceOfSerial[scheduled.serial];
+        faceStack.pop_back();
+        if(handle < 0)
+            continue;
+        
+        auto& f = qHull.faces[handle];
+        if(f.pendingBucket >= 0)
+        {
+            // The faces that get points are queued again on their own distance
+            qhClaimPendingBucket(qHull, vertices, faceStack, f.pendingBucket);
+            continue;
+        }
+        
+        // The entry on the distance of a bucket that was handed out since
+        if(scheduled.pending)
+            continue;
+        
+        if(f.outsideSet.size > 0)
+        {
+            return &f;
+        }
     }
-    
-    faceStack.pop_back();
-    return res;
+    return nullptr;
 }
 
-void qhHorizonStep(QhHull& qHull, QhVertex* vertices, QhFace& f, std::vector<int>& v, size_t* prevIterationFaces, coord_t epsilon, std::vector<Edge>& horizon)
+template<typename S>
+void qhHorizonStep(QhHull<S>& qHull, QhVertex<S>* vertices, QhFace<S>& f, std::vector<int>& v, size_t* prevIterationFaces, std::vector<Edge>& horizon)
 { 
+    TIME_PHASE(qHull.processingState.phases, QhPhase_Horizon);
+    
     v.push_back(f.indexInHull);
     
     auto& p = vertices[f.furthestPointIndex];
@@ -903,7 +1382,7 @@ void qhHorizonStep(QhHull& qHull, QhVertex* vertices, QhFace& f, std::vector<int
             
             if(fa.neighbours[neighbourIndex].faceHandle <= qHull.faces.size){
                 auto& newF = qHull.faces[fa.neighbours[neighbourIndex].faceHandle];
-                if(!newF.visitedV && qhIsPointOnPositiveSide(qHull, neighbour, p, epsilon))
+                if(!newF.visitedV && qhIsPointOnPositiveSide(qHull, neighbour, vertices, p))
                 {
                     newF.visitedV = true;
                     v.push_back(newF.indexInHull);
@@ -915,29 +1394,34 @@ void qhHorizonStep(QhHull& qHull, QhVertex* vertices, QhFace& f, std::vector<int
     *prevIterationFaces = qHull.faces.size;
     
     horizon.clear();
-    qhFindConvexHorizon(p, v, qHull, horizon, epsilon);
+    qhFindConvexHorizon(p, v, qHull, vertices, horizon);
 }
 
-bool qhCheckEdgeConvex(QhHull &hull, QhFace leftFace, QhFace rightFace, coord_t epsilon = 0.0)
+template<typename S>
+bool qhCheckEdgeConvex(QhHull<S> &hull, QhVertex<S>* vertices, QhFace<S> &leftFace, QhFace<S> &rightFace)
 {
-    auto leftBelow = !qhIsPointOnPositiveSide(hull, leftFace, rightFace.centerPoint, epsilon);
-    auto rightBelow = !qhIsPointOnPositiveSide(hull, rightFace, leftFace.centerPoint, epsilon);
+    auto leftBelow = !qhIsPointOnPositiveSide(hull, leftFace, vertices, rightFace.centerPoint);
+    auto rightBelow = !qhIsPointOnPositiveSide(hull, rightFace, vertices, leftFace.centerPoint);
     
     return leftBelow && rightBelow;
 }
 
-void qhIteration(QhHull& qHull, QhVertex* vertices, std::vector<int>& faceStack, int fHandle, std::vector<int>& v, size_t prevIterationFaces, coord_t epsilon, std::vector<Edge>& horizon)
+// Adds a face from every horizon edge to the furthest point of the current face
+template<typename S>
+static void qhBuildCone(QhHull<S>& qHull, QhVertex<S>* vertices, int fHandle, std::vector<Edge>& horizon)
 {
+    TIME_PHASE(qHull.processingState.phases, QhPhase_Cone);
+    
+    // qhAddFace can move the faces, so the apex is read once up front
+    auto apex = qHull.faces[fHandle].furthestPointIndex;
     for(const auto& e : horizon)
     {
-        auto f = qHull.faces[fHandle];
-        
-        List<int> list = {};
+        List<int, 3> list = {};
         init(list, 3);
         
         addToList(list, e.origin);
         addToList(list, e.end);
-        addToList(list, f.furthestPointIndex);
+        addToList(list, apex);
         
         auto* newF = qhAddFace(qHull, list, vertices);
         clear(list);
@@ -947,27 +1431,87 @@ void qhIteration(QhHull& qHull, QhVertex* vertices, std::vector<int>& faceStack,
         
         if(newF)
         {
-            auto otherFace = qHull.faces[(newF->indexInHull + 5) % qHull.faces.size];
-            
-            if(otherFace.indexInHull == newF->indexInHull)
-            {
-                otherFace = qHull.faces[(newF->indexInHull + 8) % qHull.faces.size];
-            }
-            
-            if(qhIsPointOnPositiveSide(qHull, *newF, otherFace.centerPoint, epsilon))
+            // Orient the face away from the inside. The centre of another face can be
+            // coplanar with the new one, the interior point never is.
+            if(qhIsPointOnPositiveSide(qHull, *newF, vertices, qHull.interiorPoint))
             {
                 auto t = newF->vertices[0];
                 newF->vertices[0] = newF->vertices[1];
                 newF->vertices[1] = t;
-                newF->faceNormal = ComputeFaceNormal(*newF, vertices);
+                qhComputeFacePlane(*newF, vertices);
             }
-            
-            faceStack.push_back(newF->indexInHull);
         }
     }
+}
+
+// Puts the points of the visible faces into one bucket for the new cone faces.
+// A visible face whose points are still in a bucket has that bucket handed to
+// its other faces first, and what they leave goes on. So the points skip the
+// tests against every face that is removed before it was expanded.
+template<typename S>
+static void qhDeferOutsideSets(QhHull<S>& qHull, QhVertex<S>* vertices, std::vector<QhScheduledFace<S>>& faceStack, std::vector<int>& uniqueInV, int fHandle, size_t prevIterationFaces)
+{
+    // The horizon walk adds visible faces without marking them, and the claims
+    // below have to pass over all of them
+    for(const auto& handle : uniqueInV)
+    {
+        qHull.faces[handle].visitedV = true;
+    }
     
+    auto bucketIndex = qhTakePendingBucket(qHull);
+    auto distance = (S)0;
+    
+    for(const auto& handle : uniqueInV)
+    {
+        auto& fInV = qHull.faces[handle];
+        if(fInV.pendingBucket >= 0)
+        {
+            distance = Max(distance, qHull.pendingBuckets[fInV.pendingBucket].distance);
+            qhClaimPendingBucket(qHull, vertices, faceStack, fInV.pendingBucket);
+            auto& bucket = qHull.pendingBuckets[bucketIndex];
+            for(auto index : qHull.pendingPoints)
+            {
+                addToList(bucket.points, index);
+            }
+        }
+        else if(fInV.outsideSet.size > 0)
+        {
+            // the furthest point of the face at hand is the apex
+            distance = Max(distance, handle == fHandle ? fInV.nextDistance : fInV.furthestDistance);
+            auto& bucket = qHull.pendingBuckets[bucketIndex];
+            for(auto index : fInV.outsideSet)
+            {
+                auto& vertex = vertices[index];
+                if(vertex.faceHandles.size == 0)
+                {
+                    vertex.assigned = false;
+                    addToList(bucket.points, index);
+                }
+            }
+        }
+    }
+    
+    auto& bucket = qHull.pendingBuckets[bucketIndex];
+    if(bucket.points.size == 0)
+    {
+        qhReleasePendingBucket(qHull, bucketIndex);
+        return;
+    }
+    
+    bucket.distance = distance;
+    for(size_t newFaceIndex = prevIterationFaces; newFaceIndex < qHull.faces.size; newFaceIndex++)
+    {
+        qHull.faces[newFaceIndex].pendingBucket = bucketIndex;
+        addToList(bucket.faces, qHull.faces[newFaceIndex].serial);
+    }
+}
+
+// Hands the outside sets of the visible faces in v over to the new cone faces
+template<typename S>
+static void qhReassignOutsideSets(QhHull<S>& qHull, QhVertex<S>* vertices, std::vector<QhScheduledFace<S>>& faceStack, std::vector<int>& v, std::vector<int>& uniqueInV, int fHandle, size_t prevIterationFaces)
+{
+    TIME_PHASE(qHull.processingState.phases, QhPhase_Reassign);
     
-    std::vector<int> uniqueInV;
     
     uniqueInV.reserve(v.size());
     for(size_t i = 0; i < v.size(); i++)
@@ -988,53 +1532,49 @@ void qhIteration(QhHull& qHull, QhVertex* vertices, std::vector<int>& faceStack,
         }
     }
     
-    for(const auto& handle : uniqueInV)
+    if(qhDefersAssignment(qHull))
     {
-        auto &fInV = qHull.faces[handle];
-        
-        for(size_t osIndex = 0; osIndex < fInV.outsideSet.size; osIndex++)
-        {
-            auto osHandle = fInV.outsideSet[osIndex];
-            auto &q = vertices[osHandle];
-            q.assigned = false;
-        }
+        qhDeferOutsideSets(qHull, vertices, faceStack, uniqueInV, fHandle, prevIterationFaces);
+        return;
     }
     
     // The way we understand this, is that unassigned now means any point that was
     // assigned in the first round, but is part of a face that is about to be
     // removed. Thus about to be unassigned.
-    for(size_t newFaceIndex = prevIterationFaces; newFaceIndex < qHull.faces.size; newFaceIndex++)
+    //
+    // Every orphan goes to the first new face it is outside of, the new faces
+    // take theirs in turn out of the orphans still pending.
+    qHull.pendingPoints.size = 0;
+    qHull.pendingPositions.size = 0;
+    for(const auto& handle : uniqueInV)
     {
-        if(qHull.faces[newFaceIndex].outsideSet.size > 0)
-            continue;
-        
-        coord_t currentDist = 0.0;
-        int currentDistIndex = 0;
-        auto& newFace = qHull.faces[newFaceIndex];
-        
-        for(const auto& handle : uniqueInV)
+        auto& fInV = qHull.faces[handle];
+        for(size_t osIndex = 0; osIndex < fInV.outsideSet.size; osIndex++)
         {
-            auto& fInV = qHull.faces[handle];
-            for(size_t osIndex = 0; osIndex < fInV.outsideSet.size; osIndex++)
+            auto osHandle = fInV.outsideSet[osIndex];
+            auto& q = vertices[osHandle];
+            q.assigned = false;
+            if(q.faceHandles.size == 0)
             {
-                auto osHandle = fInV.outsideSet[osIndex];
-                auto& q = vertices[osHandle];
-                if(!q.assigned && q.faceHandles.size == 0 && qhIsPointOnPositiveSide(qHull, newFace, q, epsilon))
-                {
-                    auto newDist = qhDistancePointToFace(qHull, newFace, q);
-                    if(newDist > currentDist)
-                    {
-                        currentDist = newDist;
-                        currentDistIndex = q.vertexIndex;
-                        newFace.furthestPointIndex = q.vertexIndex;
-                    }
-                    
-                    qhAddToOutsideSet(newFace, q);
-                }
+                addToList(qHull.pendingPoints, osHandle);
+                addToList(qHull.pendingPositions, q.position);
             }
         }
     }
     
+    for(size_t newFaceIndex = prevIterationFaces; newFaceIndex < qHull.faces.size; newFaceIndex++)
+    {
+        if(qHull.pendingPoints.size == 0)
+            break;
+        qhClaimOutsidePoints(qHull, qHull.faces[newFaceIndex], vertices);
+    }
+}
+
+template<typename S>
+static void qhRemoveVisibleFaces(QhHull<S>& qHull, QhVertex<S>* vertices, std::vector<int>& uniqueInV)
+{
+    TIME_PHASE(qHull.processingState.phases, QhPhase_RemoveFaces);
+    
     for(size_t vIndex = 0; vIndex < uniqueInV.size(); vIndex++)
     {
         auto movedHandle = qHull.faces.size - 1;
@@ -1043,6 +1583,8 @@ void qhIteration(QhHull& qHull, QhVertex* vertices, std::vector<int>& faceStack,
         if(newHandle == -1)
             continue;
         
+        // Queued faces find themselves through faceOfSerial, which qhRemoveFace
+        // keeps up to date, so the stack isn't searched here
         for(size_t j = 0; j < uniqueInV.size(); j++)
         {
             if(uniqueInV[j] == (int)movedHandle)
@@ -1050,43 +1592,38 @@ void qhIteration(QhHull& qHull, QhVertex* vertices, std::vector<int>& faceStack,
                 uniqueInV[j] = newHandle;
             }
         }
-        
-        auto iToRemove = -1;
-        
-        for(size_t i = 0; i < faceStack.size(); i++)
-        {
-            if(newHandle == faceStack[i])
-            {
-                iToRemove = (int)i;
-            }
-        }
-        
-        if(iToRemove != -1)
-        {
-            faceStack.erase(faceStack.begin() + iToRemove);
-        }
-        
-        for(size_t i = 0; i < faceStack.size(); i++)
-        {
-            if((int)movedHandle == faceStack[i])
-            {
-                faceStack[i] = newHandle;
-            }
-        }
     }
+}
+
+template<typename S>
+void qhIteration(QhHull<S>& qHull, QhVertex<S>* vertices, std::vector<QhScheduledFace<S>>& faceStack, int fHandle, std::vector<int>& v, size_t prevIterationFaces, std::vector<Edge>& horizon, std::vector<int>& uniqueInV)
+{
+    qhBuildCone(qHull, vertices, fHandle, horizon);
+    if(qHull.failed)
+        return;
+    
+    uniqueInV.clear();
+    qhReassignOutsideSets(qHull, vertices, faceStack, v, uniqueInV, fHandle, prevIterationFaces);
     
-    for(size_t i = 0; i < qHull.faces.size; i++)
+    // Only the new faces that got points, or a bucket, are queued, in the order
+    // they were built, and before the removal below moves them
+    for(size_t i = prevIterationFaces; i < qHull.faces.size; i++)
     {
-        qHull.faces[i].visited = false;
+        if(qHull.faces[i].outsideSet.size > 0 || qHull.faces[i].pendingBucket >= 0)
+        {
+            qhScheduleFace(qHull, faceStack, qHull.faces[i]);
+        }
     }
+    
+    qhRemoveVisibleFaces(qHull, vertices, uniqueInV);
 }
 
-void qhFullHull(QhContext& qhContext)
+template<typename S>
+void qhFullHull(QhContext<S>& qhContext)
 {
     qhContext.currentFace = nullptr;
     qhContext.faceStack.clear();
-    qhContext.epsilon = 0.0L;
-    qhContext.qHull = qhInit(qhContext.vertices, qhContext.numberOfPoints, qhContext.faceStack, &qhContext.epsilon, &qhContext.qHull);
+    qhInit(qhContext.qHull, qhContext.vertices, qhContext.numberOfPoints, qhContext.faceStack);
     if(qhContext.qHull.failed)
         return;
     
@@ -1094,18 +1631,18 @@ void qhFullHull(QhContext& qhContext)
     qhContext.previousIteration = 0;
     while(qhContext.faceStack.size() > 0)
     {
-        qhContext.currentFace = qhFindNextIteration(qhContext.qHull, qhContext.faceStack);
+        qhContext.currentFace = qhFindNextIteration(qhContext.qHull, qhContext.vertices, qhContext.faceStack);
         if(qhContext.qHull.failed)
             return;
         
         if(qhContext.currentFace)
         {
-            qhHorizonStep(qhContext.qHull, qhContext.vertices, *qhContext.currentFace, qhContext.v, &qhContext.previousIteration, qhContext.epsilon, qhContext.horizon);
+            qhHorizonStep(qhContext.qHull, qhContext.vertices, *qhContext.currentFace, qhContext.v, &qhContext.previousIteration, qhContext.horizon);
             if(qhContext.qHull.failed)
                 return;
             
             qhIteration(qhContext.qHull, qhContext.vertices, qhContext.faceStack, qhContext.currentFace->indexInHull, qhContext.v, 
-                        qhContext.previousIteration, qhContext.epsilon, qhContext.horizon);
+                        qhContext.previousIteration, qhContext.horizon, qhContext.uniqueInV);
             if(qhContext.qHull.failed)
                 return;
             
@@ -1114,34 +1651,34 @@ void qhFullHull(QhContext& qhContext)
     }
 }
 
-QhHull qhFullHull(QhVertex* vertices, int numVertices)
+template<typename S>
+QhHull<S> qhFullHull(QhVertex<S>* vertices, int numVertices)
 {
-    QhFace* currentFace = nullptr;
-    std::vector<int> faceStack;
-    coord_t epsilon;
-    
-    auto qHull = qhInit(vertices, numVertices, faceStack, &epsilon);
+    QhFace<S>* currentFace = nullptr;
+    std::vector<QhScheduledFace<S>> faceStack;
+    QhHull<S> qHull = {};
+    qhInit(qHull, vertices, numVertices, faceStack);
     if(qHull.failed)
         return qHull;
     
     std::vector<int> v;
     
     std::vector<Edge> horizon;
+    std::vector<int> uniqueInV;
     
     size_t previousIteration = 0;
     while(faceStack.size() > 0)
     {
-        currentFace = qhFindNextIteration(qHull, faceStack);
+        currentFace = qhFindNextIteration(qHull, vertices, faceStack);
         if(qHull.failed)
             return qHull;
         if(currentFace)
         {
-            qhHorizonStep(qHull, vertices, *currentFace, v, &previousIteration,
-                          epsilon, horizon);
+            qhHorizonStep(qHull, vertices, *currentFace, v, &previousIteration, horizon);
             if(qHull.failed)
                 return qHull;
             qhIteration(qHull, vertices, faceStack, currentFace->indexInHull, v,
-                        previousIteration, epsilon, horizon);
+                        previousIteration, horizon, uniqueInV);
             if(qHull.failed)
                 return qHull;
             v.clear();
@@ -1151,28 +1688,27 @@ QhHull qhFullHull(QhVertex* vertices, int numVertices)
     return qHull;
 }
 
-void qhInitializeContext(QhContext& qhContext, Vertex* vertices, int numberOfPoints)
+// Prepares the context for a new point set. Nothing is freed, the buffers of the
+// previous run are emptied and reused.
+template<typename S, typename P>
+void qhInitializeContext(QhContext<S>& qhContext, P* vertices, int numberOfPoints)
 {
-    if(qhContext.vertices)
-    {
-        free(qhContext.vertices);
-    }
-    
+    // a failed run leaves its faces with outside sets, back to the pool with them
     for(auto &f : qhContext.qHull.faces)
     {
-        clear(f.outsideSet);
-        clear(f.vertices);
+        qhReleaseBuffer(qhContext.qHull.freeOutsideSets, f.outsideSet);
     }
-    
-    clear(qhContext.qHull.faces);
+    qhContext.qHull.faces.size = 0;
+    qhContext.qHull.faceOfSerial.size = 0;
     qhContext.qHull.processingState = {};
     
     qhContext.faceStack.clear();
     qhContext.v.clear();
+    qhContext.horizon.clear();
+    qhContext.uniqueInV.clear();
     
     qhCopyVertices(qhContext, vertices, numberOfPoints);
     qhContext.numberOfPoints = numberOfPoints;
-    qhContext.epsilon = 0.0;
     qhContext.iter = QHIteration::initQH;
     qhContext.currentFace = nullptr;
     qhContext.previousIteration = 0;
@@ -1180,13 +1716,66 @@ void qhInitializeContext(QhContext& qhContext, Vertex* vertices, int numberOfPoi
     
 }
 
-void qhStep(QhContext& context)
+// Gives back everything the context holds on to
+template<typename S>
+void qhFreeContext(QhContext<S>& qhContext)
+{
+    for(int i = 0; i < qhContext.vertexCapacity; i++)
+    {
+        clear(qhContext.vertices[i].faceHandles);
+    }
+    memFreeLarge(qhContext.vertices);
+    qhContext.vertices = nullptr;
+    qhContext.vertexCapacity = 0;
+    qhContext.numberOfPoints = 0;
+    
+    auto &qHull = qhContext.qHull;
+    for(auto &f : qHull.faces)
+    {
+        clear(f.outsideSet);
+    }
+    clear(qHull.faces);
+    clear(qHull.faceOfSerial);
+    
+    for(auto &buffer : qHull.freeOutsideSets)
+    {
+        memFree(buffer.data);
+    }
+    clear(qHull.freeOutsideSets);
+    for(auto &buffer : qHull.freeFaceHandles)
+    {
+        memFree(buffer.data);
+    }
+    clear(qHull.freeFaceHandles);
+    clear(qHull.pendingPoints);
+    clear(qHull.pendingPositions);
+    clear(qHull.outsidePoints);
+    clear(qHull.outsideDistances);
+    for(auto &bucket : qHull.pendingBuckets)
+    {
+        clear(bucket.points);
+        clear(bucket.faces);
+    }
+    clear(qHull.pendingBuckets);
+    clear(qHull.freePendingBuckets);
+    
+    std::vector<QhScheduledFace<S>>().swap(qhContext.faceStack);
+    std::vector<int>().swap(qhContext.v);
+    std::vector<Edge>().swap(qhContext.horizon);
+    std::vector<int>().swap(qhContext.uniqueInV);
+    
+    qhContext.currentFace = nullptr;
+    qhContext.initialized = false;
+}
+
+template<typename S>
+void qhStep(QhContext<S>& context)
 {
     switch(context.iter)
     {
         case QHIteration::initQH:
         {
-            context.qHull = qhInit(context.vertices, context.numberOfPoints, context.faceStack, &context.epsilon, &context.qHull);
+            qhInit(context.qHull, context.vertices, context.numberOfPoints, context.faceStack);
             if(context.qHull.failed)
                 return;
             context.iter = QHIteration::findNextIter;
@@ -1196,7 +1785,7 @@ void qhStep(QhContext& context)
         {
             if(context.faceStack.size() > 0)
             {
-                context.currentFace = qhFindNextIteration(context.qHull, context.faceStack);
+                context.currentFace = qhFindNextIteration(context.qHull, context.vertices, context.faceStack);
                 if(context.qHull.failed)
                     return;
                 if(context.currentFace)
@@ -1210,7 +1799,7 @@ void qhStep(QhContext& context)
         {
             if(context.currentFace)
             {
-                qhHorizonStep(context.qHull, context.vertices, *context.currentFace, context.v, &context.previousIteration, context.epsilon, context.horizon);
+                qhHorizonStep(context.qHull, context.vertices, *context.currentFace, context.v, &context.previousIteration, context.horizon);
                 if(context.qHull.failed)
                     return;
                 context.iter = QHIteration::doIter;
@@ -1221,7 +1810,7 @@ void qhStep(QhContext& context)
         {
             if(context.currentFace)
             {
-                qhIteration(context.qHull, context.vertices, context.faceStack, context.currentFace->indexInHull, context.v, context.previousIteration, context.epsilon, context.horizon);
+                qhIteration(context.qHull, context.vertices, context.faceStack, context.currentFace->indexInHull, context.v, context.previousIteration, context.horizon, context.uniqueInV);
                 if(context.qHull.failed)
                     return;
                 context.iter = QHIteration::findNextIter;
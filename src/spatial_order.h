@@ -0,0 +1,130 @@
+#ifndef SPATIAL_ORDER_H
+#define SPATIAL_ORDER_H
+
+// Sorts the input points along a space filling curve before they go to a hull.
+// Generated and loaded points come in no particular order, so vertices that are
+// neighbours on the hull end up far apart in the engines' vertex arrays. Sorted,
+// the walks over neighbouring faces and edges stay within a few cache lines.
+// The engines number their points by position in what they are given, so a
+// result built on the sorted points goes through spatialOrderRemap to get back
+// to the input indices.
+
+enum SpatialOrderCurve
+{
+    // keep the input order
+    SpatialOrder_None,
+    SpatialOrder_Morton,
+    SpatialOrder_Hilbert,
+    SpatialOrder_Count
+};
+
+static const char *spatialOrderNames[] = {"input", "Morton", "Hilbert"};
+
+// Keep this around between runs to reuse the buffers. P is the input point type,
+// Vertex or PrecisePoint.
+template <typename P>
+struct SpatialOrder
+{
+    // the sorted points, hand these to the engine
+    List<P> points;
+    // which input point each sorted point is
+    List<int32_t> inputIndices;
+    // curve position in the high half, input index in the low half
+    List<unsigned long long> keys;
+};
+
+template <typename P>
+static void spatialOrderBuild(SpatialOrder<P> &order, const P *vertices, int count, SpatialOrderCurve curve)
+{
+    order.points.size = 0;
+    order.inputIndices.size = 0;
+    order.keys.size = 0;
+    reserve(order.points, (size_t)count);
+    reserve(order.inputIndices, (size_t)count);
+    reserve(order.keys, (size_t)count);
+    if (count <= 0)
+    {
+        return;
+    }
+
+    auto min = vertices[0].position;
+    auto max = min;
+    for (int i = 1; i < count; i++)
+    {
+        min = glm::min(min, vertices[i].position);
+        max = glm::max(max, vertices[i].position);
+    }
+
+    auto keys = order.keys.data();
+    for (int i = 0; i < count; i++)
+    {
+        unsigned long long code = 0;
+        switch (curve)
+        {
+            case SpatialOrder_Morton:
+            {
+                code = mortonCode(vertices[i].position, min, max);
+            }
+            break;
+            case SpatialOrder_Hilbert:
+            {
+                code = hilbertCode(vertices[i].position, min, max);
+            }
+            break;
+            default:
+            break;
+        }
+        keys[i] = (code << 32) | (unsigned int)i;
+    }
+    order.keys.size = (size_t)count;
+    //ties keep the input order, the index is the low half of the key
+    std::sort(keys, keys + count);
+
+    auto points = order.points.data();
+    auto inputIndices = order.inputIndices.data();
+    for (int i = 0; i < count; i++)
+    {
+        auto inputIndex = (int32_t)(keys[i] & 0xffffffffull);
+        points[i] = vertices[inputIndex];
+        inputIndices[i] = inputIndex;
+    }
+    order.points.size = (size_t)count;
+    order.inputIndices.size = (size_t)count;
+}
+
+// Turns the indices of a result built on order.points into input indices
+template <typename P, typename S>
+static void spatialOrderRemap(const SpatialOrder<P> &order, HullResult<S> &result)
+{
+    if (result.flags & HullResult_Compact)
+    {
+        //compactIndex is keyed by input index too, so its entries move along
+        for (auto inputIndex : result.inputIndices)
+        {
+            result.compactIndex[inputIndex] = -1;
+        }
+        for (size_t i = 0; i < result.inputIndices.size; i++)
+        {
+            auto &inputIndex = result.inputIndices[i];
+            inputIndex = order.inputIndices[inputIndex];
+            result.compactIndex[inputIndex] = (int32_t)i;
+        }
+    }
+    else
+    {
+        for (auto &index : result.indices)
+        {
+            index = order.inputIndices[index];
+        }
+    }
+}
+
+template <typename P>
+static void spatialOrderFree(SpatialOrder<P> &order)
+{
+    clear(order.points);
+    clear(order.inputIndices);
+    clear(order.keys);
+}
+
+#endif
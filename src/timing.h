@@ -10,6 +10,11 @@ time_long currentTimeMicro()
     return (time_long)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now().time_since_epoch()).count();
 }
 
+time_long currentTimeNano()
+{
+    return (time_long)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
 int startTimer()
 {
     if(counter >= MAX_TIMERS)
@@ -31,3 +36,35 @@ time_long endTimer(int index)
 
 #define TIME_END(index, msg) \
 log_a("%s took %lld time\n", msg, endTimer(index));
+
+// Accumulated nanoseconds per algorithm phase. Each hull engine defines its own
+// phase enum and keeps one of these in its processingState.
+#define MAX_PHASES 8
+
+struct PhaseTimes
+{
+    time_long times[MAX_PHASES];
+};
+
+struct ScopedPhase
+{
+    time_long &slot;
+    time_long start;
+    
+    ScopedPhase(time_long &s) : slot(s), start(currentTimeNano()) {}
+    ~ScopedPhase()
+    {
+        slot += currentTimeNano() - start;
+    }
+};
+
+// Times the rest of the enclosing scope into the given phase, or into any
+// time_long counter with TIME_SLOT.
+// Build with -DDISABLE_PHASE_TIMING to compile the timers out.
+#ifndef DISABLE_PHASE_TIMING
+#define TIME_PHASE(phases, phase) ScopedPhase phase##Timer((phases).times[phase])
+#define TIME_SLOT(slot, name) ScopedPhase name##Timer(slot)
+#else
+#define TIME_PHASE(phases, phase)
+#define TIME_SLOT(slot, name)
+#endif
@@ -40,6 +40,85 @@ inline bool startsWith(const char *a, const char *b)
 
 using coord_t = double;
 
+// Position type the hull engines are templated on, float or double
+template<typename S>
+using position_t = glm::vec<3, S, glm::defaultp>;
+
+// Spreads the low 10 bits of x out to every third bit
+static inline unsigned int mortonSpread(unsigned int x)
+{
+    x &= 0x3ff;
+    x = (x | (x << 16)) & 0x030000ff;
+    x = (x | (x << 8)) & 0x0300f00f;
+    x = (x | (x << 4)) & 0x030c30c3;
+    x = (x | (x << 2)) & 0x09249249;
+    return x;
+}
+
+// Cell of p in a 1024^3 grid over [min, max]
+template<typename S>
+static inline void curveCell(const position_t<S> &p, const position_t<S> &min, const position_t<S> &max, unsigned int cell[3])
+{
+    auto extent = max - min;
+    for(int i = 0; i < 3; i++)
+    {
+        auto t = extent[i] > 0 ? (p[i] - min[i]) / extent[i] : (S)0;
+        cell[i] = (unsigned int)Min(Max(t * (S)1024, (S)0), (S)1023);
+    }
+}
+
+// Position on the Z-order curve through a 1024^3 grid over [min, max]. Points
+// close in space mostly get close codes.
+template<typename S>
+static inline unsigned int mortonCode(const position_t<S> &p, const position_t<S> &min, const position_t<S> &max)
+{
+    unsigned int cell[3];
+    curveCell(p, min, max, cell);
+    return mortonSpread(cell[0]) | (mortonSpread(cell[1]) << 1) | (mortonSpread(cell[2]) << 2);
+}
+
+// Position on the Hilbert curve through the same grid. Unlike the Z-order curve
+// it never jumps, cells next to each other on the curve share a side.
+// Skilling's transform, "Programming the Hilbert curve" (2004)
+template<typename S>
+static inline unsigned int hilbertCode(const position_t<S> &p, const position_t<S> &min, const position_t<S> &max)
+{
+    unsigned int x[3];
+    curveCell(p, min, max, x);
+    for(unsigned int q = 1u << 9; q > 1; q >>= 1)
+    {
+        unsigned int mask = q - 1;
+        for(int i = 0; i < 3; i++)
+        {
+            if(x[i] & q)
+            {
+                x[0] ^= mask;
+            }
+            else
+            {
+                auto t = (x[0] ^ x[i]) & mask;
+                x[0] ^= t;
+                x[i] ^= t;
+            }
+        }
+    }
+    x[1] ^= x[0];
+    x[2] ^= x[1];
+    unsigned int t = 0;
+    for(unsigned int q = 1u << 9; q > 1; q >>= 1)
+    {
+        if(x[2] & q)
+        {
+            t ^= q - 1;
+        }
+    }
+    for(int i = 0; i < 3; i++)
+    {
+        x[i] ^= t;
+    }
+    return (mortonSpread(x[0]) << 2) | (mortonSpread(x[1]) << 1) | mortonSpread(x[2]);
+}
+
 static float randomFloat(std::uniform_real_distribution<coord_t>& d, std::mt19937_64& gen, float start, float end)
 {
     return ((float)d(gen) / (float)d.max() * end) + start;